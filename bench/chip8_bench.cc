@@ -0,0 +1,464 @@
+// Benchmarks of the emulator core. Results are written as `benchmark,metric,value` lines so that
+// two runs can be compared with `chip8_bench compare`.
+//
+// Usage:
+//   chip8_bench [--games DIR|ZIP] [--out FILE]
+// Exits with 1 when the debugger costs more than its budget, see bench_debugger.
+//   chip8_bench compare <BASELINE> <CANDIDATE> [THRESHOLD_PERCENT]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "chip_8.h"
+#include "debugger.h"
+#include "decoder.h"
+#include "deflicker.h"
+#include "frame_pacer.h"
+#include "libchip8.h"
+#include "renderer.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string benchmark;
+    std::string metric;
+    double value;
+};
+
+// How many instructions each ROM / microbenchmark runs for. Best of `repeat`.
+constexpr std::uint64_t instructions_per_run = 500000;
+constexpr int repeat = 3;
+constexpr int instructions_per_frame = 10;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Run a ROM and report instructions/s and draws/s. A key is pressed every second so that
+// games waiting for input still make progress.
+void bench_rom(const std::string& name, const std::vector<std::uint8_t>& rom, std::vector<Result>& results) {
+    double best_seconds = 0;
+    std::uint64_t draws = 0;
+    for (int run = 0; run < repeat; run++) {
+        Chip8 chip8;
+        chip8.seed(0);
+        chip8.load_from_buffer(rom);
+        chip8.set_instructions_per_frame(instructions_per_frame);
+
+        std::uint64_t run_draws = 0;
+        auto start = Clock::now();
+        for (std::uint64_t i = 0; i < instructions_per_run; i++) {
+            chip8.emulateCycle();
+            if (chip8.draw_flag()) {
+                run_draws++;
+                chip8.set_draw_flag(false);
+            }
+            if (i % instructions_per_frame == 0) {
+                auto frame = i / instructions_per_frame;
+                if (frame % 60 == 0) chip8.set_key_pressed((frame / 60) % 16);
+                if (frame % 60 == 30) chip8.set_key_released((frame / 60) % 16);
+            }
+        }
+        auto seconds = seconds_since(start);
+        if (run == 0 || seconds < best_seconds) {
+            best_seconds = seconds;
+            draws = run_draws;
+        }
+    }
+
+    results.push_back({name, "ips", instructions_per_run / best_seconds});
+    results.push_back({name, "draws_per_sec", draws / best_seconds});
+}
+
+// Synthetic ROM: `body` repeated to fill a loop, followed by a jump back to 0x200.
+std::vector<std::uint8_t> micro_rom(const std::vector<std::uint16_t>& setup, const std::vector<std::uint16_t>& body) {
+    std::vector<std::uint16_t> program(setup);
+    auto loop = static_cast<std::uint16_t>(0x200 + program.size() * 2);
+    for (int i = 0; i < 16; i++) {
+        program.insert(program.end(), body.begin(), body.end());
+    }
+    program.push_back(0x1000 | loop);
+
+    std::vector<std::uint8_t> rom;
+    for (auto opcode: program) {
+        rom.push_back(opcode >> 8);
+        rom.push_back(opcode & 0xFF);
+    }
+    return rom;
+}
+
+void bench_micro(std::vector<Result>& results) {
+    struct Micro {
+        std::string name;
+        std::vector<std::uint16_t> setup;
+        std::vector<std::uint16_t> body;
+    };
+    // Subroutine used by the call benchmark lives at 0x600.
+    std::vector<Micro> micros{
+            {"load", {}, {0x6012, 0x6134, 0x6256, 0x6378}},
+            {"add", {}, {0x7001, 0x7102, 0x7203, 0x7304}},
+            {"alu", {0x6105, 0x6203}, {0x8010, 0x8011, 0x8012, 0x8013, 0x8014, 0x8015, 0x8016, 0x8017, 0x801E}},
+            {"skip", {0x6000}, {0x3001, 0x4000, 0x5010, 0x9000}},
+            {"index", {0x6002}, {0xA300, 0xF01E, 0xF029}},
+            {"draw", {0x6000, 0x6100, 0xF029}, {0xD015}},
+            {"call", {}, {0x2600}},
+            {"memory", {0xA300, 0x60FF}, {0xF033, 0xF355, 0xF365}},
+            {"timer", {0x6010}, {0xF015, 0xF107, 0xF018}},
+            {"rand", {}, {0xC0FF, 0xC10F}},
+    };
+
+    for (auto& micro: micros) {
+        auto rom = micro_rom(micro.setup, micro.body);
+        if (micro.name == "call") {
+            rom.resize(0x400 + 2, 0);
+            rom[0x400] = 0x00;
+            rom[0x401] = 0xEE;
+        }
+        bench_rom("micro/" + micro.name, rom, results);
+    }
+}
+
+void bench_construction(std::vector<Result>& results) {
+    constexpr int count = 2000;
+    auto start = Clock::now();
+    for (int i = 0; i < count; i++) {
+        Chip8 chip8;
+        if (chip8.pc() != 0x200) std::cerr << "unexpected pc\n";
+    }
+    results.push_back({"construct", "ns_per_op", seconds_since(start) * 1e9 / count});
+}
+
+// Disassemble every ROM of the corpus into one reused buffer.
+void bench_disassembler(const std::vector<std::vector<std::uint8_t>>& roms, std::vector<Result>& results) {
+    constexpr int count = 50;
+    std::vector<Decoder> decoders(roms.size());
+    std::size_t max_length = 0;
+    for (size_t i = 0; i < roms.size(); i++) {
+        decoders[i].load_from_buffer(roms[i]);
+        max_length = std::max(max_length, roms[i].size());
+    }
+    std::vector<char> listing((max_length / 2 + 1) * Decoder::max_line_size);
+
+    std::size_t bytes = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < count; i++) {
+        for (auto& decoder: decoders) {
+            bytes += decoder.disassemble(listing.data()) - listing.data();
+        }
+    }
+    results.push_back({"disasm/corpus", "ns_per_op", seconds_since(start) * 1e9 / count});
+    if (bytes == 0) std::cerr << "empty disassembly\n";
+}
+
+void bench_snapshot(const std::vector<std::uint8_t>& rom, std::vector<Result>& results) {
+    constexpr int count = 100000;
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    for (int i = 0; i < 1000; i++) chip8.emulateCycle();
+
+    std::vector<Chip8::Snapshot> snapshots(16);
+    auto start = Clock::now();
+    for (int i = 0; i < count; i++) {
+        snapshots[i % snapshots.size()] = chip8.snapshot();
+    }
+    results.push_back({"snapshot", "ns_per_op", seconds_since(start) * 1e9 / count});
+
+    start = Clock::now();
+    for (int i = 0; i < count; i++) {
+        chip8.restore(snapshots[i % snapshots.size()]);
+    }
+    results.push_back({"restore", "ns_per_op", seconds_since(start) * 1e9 / count});
+}
+
+// A 1080p frame, as for a video export: everything drawn each time, then only the rows that changed, on the frames
+// of a real game.
+void bench_renderer(const std::vector<std::uint8_t>& rom, std::vector<Result>& results) {
+    Chip8 chip8;
+    chip8.seed(0);
+    chip8.load_from_buffer(rom);
+    std::vector<std::array<std::uint8_t, 64*32>> frames;
+    NoHooks hooks;
+    for (int frame = 0; frame < 300; frame++) {
+        chip8.run_cycles(chip8.instructions_per_frame(), hooks);
+        frames.push_back(chip8.gfx());
+    }
+
+    std::vector<std::uint32_t> pixels(1920 * 1080);
+    RgbaTarget target{pixels.data(), 1920, 1080, 1920};
+    for (auto filter: {Filter::Nearest, Filter::Scale2x}) {
+        std::string name = filter == Filter::Nearest ? "render/1080p_nearest" : "render/1080p_scale2x";
+        Renderer renderer(default_palette(), filter);
+
+        auto start = Clock::now();
+        for (auto& frame: frames) {
+            renderer.invalidate();
+            renderer.render(FramebufferView::of(frame), target);
+        }
+        results.push_back({name + "_full", "ns_per_op", seconds_since(start) * 1e9 / frames.size()});
+
+        start = Clock::now();
+        for (auto& frame: frames) {
+            renderer.render(FramebufferView::of(frame), target);
+        }
+        results.push_back({name + "_changed_rows", "ns_per_op", seconds_since(start) * 1e9 / frames.size()});
+    }
+
+    Deflicker deflicker;
+    std::uint64_t lit = 0;
+    auto start = Clock::now();
+    for (int repeat = 0; repeat < 100; repeat++) {
+        for (auto& frame: frames) {
+            lit += deflicker.process(FramebufferView::of(frame)).pixels[0];
+        }
+    }
+    results.push_back({"deflicker", "ns_per_op", seconds_since(start) * 1e9 / (100 * frames.size())});
+    if (lit == 0) std::cerr << "deflicker never lit a pixel\n";
+}
+
+// One frame at a time, straight on the core and through the shared library, keys changing once a second.
+// Best of `repeat`.
+void bench_capi(const std::vector<std::uint8_t>& rom, std::vector<Result>& results) {
+    constexpr int frames = 50000;
+    double best_direct = 0;
+    double best_capi = 0;
+    std::uint64_t executed = 0;
+    for (int run = 0; run < repeat; run++) {
+        Chip8 chip8;
+        chip8.seed(0);
+        chip8.load_from_buffer(rom);
+        chip8.set_instructions_per_frame(instructions_per_frame);
+        NoHooks hooks;
+        auto start = Clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            if (frame % 60 == 0) chip8.set_key_pressed(frame / 60 % 16);
+            executed += chip8.run_cycles(chip8.instructions_per_frame(), hooks);
+            if (frame % 60 == 30) chip8.set_key_released(frame / 60 % 16);
+        }
+        auto seconds = seconds_since(start);
+        if (run == 0 || seconds < best_direct) best_direct = seconds;
+
+        auto machine = chip8_create();
+        chip8_seed(machine, 0);
+        chip8_load(machine, rom.data(), rom.size());
+        chip8_set_instructions_per_frame(machine, instructions_per_frame);
+        start = Clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            if (frame % 60 == 0) chip8_set_key(machine, frame / 60 % 16, 1);
+            executed += chip8_run_frame(machine);
+            if (frame % 60 == 30) chip8_set_key(machine, frame / 60 % 16, 0);
+        }
+        seconds = seconds_since(start);
+        if (run == 0 || seconds < best_capi) best_capi = seconds;
+        chip8_destroy(machine);
+    }
+    results.push_back({"frame/direct", "ns_per_op", best_direct * 1e9 / frames});
+    results.push_back({"frame/capi", "ns_per_op", best_capi * 1e9 / frames});
+    if (executed == 0) std::cerr << "no instruction executed\n";
+}
+
+// Debugger::run with nothing set against the plain run_cycles<NoHooks> loop, a frame at a time like the emulator
+// thread. On the cheapest instructions, where the check weighs the most. Must stay under debugger_budget_pct.
+constexpr double debugger_budget_pct = 10;
+
+double bench_debugger(std::vector<Result>& results) {
+    auto rom = micro_rom({}, {0x7001, 0x7102, 0x7203, 0x7304});
+    double best[2] = {0, 0};
+    for (int run = 0; run < repeat; run++) {
+        // Interleaved, so that both see the same load on the machine.
+        for (int with_debugger = 0; with_debugger < 2; with_debugger++) {
+            Chip8 chip8;
+            chip8.load_from_buffer(rom);
+            Debugger debugger;
+            NoHooks hooks;
+            auto start = Clock::now();
+            for (std::uint64_t done = 0; done < instructions_per_run; done += instructions_per_frame) {
+                if (with_debugger) {
+                    debugger.run(chip8, instructions_per_frame);
+                } else {
+                    chip8.run_cycles(instructions_per_frame, hooks);
+                }
+            }
+            auto seconds = seconds_since(start);
+            if (chip8.cycles() != instructions_per_run) std::cerr << "debugger run stopped early\n";
+            if (run == 0 || seconds < best[with_debugger]) best[with_debugger] = seconds;
+        }
+    }
+    auto overhead = (best[1] - best[0]) / best[0] * 100;
+    results.push_back({"debugger/none", "ns_per_op", best[0] * 1e9 / instructions_per_run});
+    results.push_back({"debugger/run", "ns_per_op", best[1] * 1e9 / instructions_per_run});
+    results.push_back({"debugger/run", "overhead_pct", overhead});
+    return overhead;
+}
+
+// Frame time deviation from 60Hz with both ways of sleeping. Wall time: 1.5s each.
+void bench_pacer(std::vector<Result>& results) {
+    for (auto use_timerfd: {false, true}) {
+        FramePacer pacer(std::chrono::microseconds(16667), std::chrono::microseconds(300), use_timerfd);
+        if (use_timerfd && !pacer.uses_timerfd()) continue;
+        for (int frame = 0; frame < 90; frame++) pacer.wait();
+
+        auto jitter = pacer.jitter();
+        std::string name = use_timerfd ? "pacer/timerfd" : "pacer/sleep_until";
+        results.push_back({name, "p50_ms", jitter.p50});
+        results.push_back({name, "p99_ms", jitter.p99});
+    }
+}
+
+// ---------------------------------------------------------------------
+// Compare mode
+// ---------------------------------------------------------------------
+// The whole text as a finite number. Throw std::invalid_argument: std::stod alone takes "12abc".
+double parse_value(const std::string& text) {
+    std::size_t used = 0;
+    auto value = std::stod(text, &used);
+    if (used != text.size() || !std::isfinite(value)) throw std::invalid_argument(text);
+    return value;
+}
+
+// Throw std::runtime_error when the file cannot be read or a value is not a number.
+std::map<std::string, double> read_results(const std::string& path) {
+    std::map<std::string, double> results;
+    std::ifstream input(path);
+    if (!input) throw std::runtime_error("Cannot read " + path);
+    std::string line;
+    for (std::size_t number = 1; std::getline(input, line); number++) {
+        if (line.empty() || line[0] == '#') continue;
+        if (line.compare(0, 10, "benchmark,") == 0) continue;
+        auto last_comma = line.rfind(',');
+        try {
+            if (last_comma == std::string::npos) throw std::invalid_argument(line);
+            results[line.substr(0, last_comma)] = parse_value(line.substr(last_comma + 1));
+        } catch (const std::logic_error&) {
+            throw std::runtime_error(path + ":" + std::to_string(number) + ": not `benchmark,metric,value`: " + line);
+        }
+    }
+    return results;
+}
+
+// Throughput metrics regress when they go down, costs and latencies when they go up.
+bool lower_is_better(const std::string& key) {
+    auto ends_with = [&](const std::string& suffix) {
+        return key.size() >= suffix.size() && key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return ends_with("ns_per_op") || ends_with("_ms") || ends_with("_pct");
+}
+
+int compare(const std::string& baseline_path, const std::string& candidate_path, double threshold) {
+    auto baseline = read_results(baseline_path);
+    auto candidate = read_results(candidate_path);
+
+    int regressions = 0;
+    int missing = 0;
+    for (auto& entry: baseline) {
+        auto it = candidate.find(entry.first);
+        if (it == candidate.end()) {
+            // A benchmark that no longer runs, or crashed before writing its row, is not a pass.
+            missing++;
+            std::cout << "MISSING    " << entry.first << ' ' << entry.second << " -> none\n";
+            continue;
+        }
+        if (entry.second == 0) continue;
+
+        auto change = (it->second - entry.second) / entry.second * 100;
+        if (lower_is_better(entry.first)) change = 0.0 - change;
+
+        bool regressed = change < -threshold;
+        if (regressed) regressions++;
+        std::cout << (regressed ? "REGRESSION " : "ok         ") << entry.first << ' '
+                  << entry.second << " -> " << it->second << " (" << (change >= 0 ? "+" : "") << change << "%)\n";
+    }
+    std::cout << regressions << " regression(s) over " << threshold << "%, " << missing << " missing\n";
+    return regressions == 0 && missing == 0 ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (!args.empty() && args[0] == "compare") {
+        if (args.size() < 3) {
+            std::cerr << "Usage: " << argv[0] << " compare <BASELINE> <CANDIDATE> [THRESHOLD_PERCENT]\n";
+            return -1;
+        }
+        double threshold = 5.0;
+        try {
+            if (args.size() > 3) threshold = parse_value(args[3]);
+            if (threshold < 0) throw std::out_of_range(args[3]);
+        } catch (const std::logic_error&) {
+            std::cerr << "Invalid threshold " << args[3] << '\n';
+            return -1;
+        }
+        try {
+            return compare(args[1], args[2], threshold);
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << '\n';
+            return -1;
+        }
+    }
+
+    std::string games_dir = CHIP8_GAMES_DIR;
+    std::string output_path;
+    for (size_t i = 0; i + 1 < args.size(); i += 2) {
+        if (args[i] == "--games") {
+            games_dir = args[i + 1];
+        } else if (args[i] == "--out") {
+            output_path = args[i + 1];
+        }
+    }
+
+    std::vector<Result> results;
+    std::vector<std::vector<std::uint8_t>> roms;
+    // Every ROM is read once, up front: the benchmarks never touch the disk.
+    RomLibrary library;
+    try {
+        library = RomLibrary::open(games_dir);
+    } catch (const RomError& error) {
+        std::cerr << error.what() << '\n';
+    }
+    for (auto& entry: library.entries()) {
+        if (entry.rom.size == 0 || entry.rom.size > 4096 - 512) continue;
+        roms.emplace_back(entry.rom.begin(), entry.rom.end());
+        bench_rom("rom/" + entry.name, roms.back(), results);
+    }
+    bench_micro(results);
+    bench_construction(results);
+    if (!roms.empty()) {
+        bench_snapshot(roms.front(), results);
+        bench_disassembler(roms, results);
+        bench_renderer(roms.front(), results);
+        bench_capi(roms.front(), results);
+    }
+    auto debugger_overhead = bench_debugger(results);
+    bench_pacer(results);
+
+    std::ostringstream out;
+    out << "benchmark,metric,value\n";
+    for (auto& result: results) {
+        out << result.benchmark << ',' << result.metric << ',' << result.value << '\n';
+    }
+
+    if (output_path.empty()) {
+        std::cout << out.str();
+    } else {
+        std::ofstream(output_path) << out.str();
+    }
+    if (debugger_overhead > debugger_budget_pct) {
+        std::cerr << "debugger overhead " << debugger_overhead << "% over the " << debugger_budget_pct << "% budget\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+// libFuzzer target: the first byte picks the engine and the quirks, the rest is a ROM. It runs for a bounded number
+// of frames with keys pressed from the input bytes. The machine is reset in place between runs instead of being built
+// again.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip_8.h"
+
+namespace {
+
+constexpr int frames = 16;
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    using namespace snooz;
+
+    static Chip8 chip8;
+    if (size < 2 || size - 1 > 4096 - 512) return 0;
+
+    // Bit 0: engine, bits 1 to 5: quirks.
+    auto config = data[0];
+    std::vector<std::uint8_t> rom(data + 1, data + size);
+    chip8.reset();
+    chip8.seed(0);
+    chip8.load_from_buffer(rom);
+    chip8.set_engine(config & 0x01 ? Engine::FlatTable : Engine::Reference);
+    Quirks quirks;
+    quirks.shift_uses_vy = config & 0x02;
+    quirks.load_store_increments_i = config & 0x04;
+    quirks.jump_uses_vx = config & 0x08;
+    quirks.clip_sprites = config & 0x10;
+    quirks.logic_resets_vf = config & 0x20;
+    chip8.set_quirks(quirks);
+
+    NoHooks hooks;
+    for (int frame = 0; frame < frames && chip8.should_continue(); frame++) {
+        // Any byte can be a key, including invalid ones.
+        auto key = rom[frame % rom.size()];
+        if (key & 0x80) {
+            chip8.set_key_released(key & 0x1F);
+        } else {
+            chip8.set_key_pressed(key & 0x1F);
+        }
+        chip8.run_cycles(chip8.instructions_per_frame(), hooks);
+    }
+    return 0;
+}
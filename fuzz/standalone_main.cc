@@ -0,0 +1,43 @@
+// Replaces libFuzzer when the compiler does not have it: runs the fuzz target once on every file given, and on
+// every file of the directories given. Handy to replay a corpus or a crash with gcc.
+
+#include <chrono>
+#include <cstdint>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+namespace {
+
+std::vector<std::string> expand(const std::string& path) {
+    auto dir = opendir(path.c_str());
+    if (dir == nullptr) return {path};
+    std::vector<std::string> files;
+    while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') files.push_back(path + "/" + entry->d_name);
+    }
+    closedir(dir);
+    return files;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::uint64_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i < argc; i++) {
+        for (auto& file: expand(argv[i])) {
+            std::ifstream input(file, std::ios::binary);
+            std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+            runs++;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << runs << " inputs in " << elapsed.count() << "s\n";
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "audio.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace snooz {
+
+namespace {
+
+constexpr double tone_frequency = 440;
+constexpr std::int16_t amplitude = 6000;
+
+void write_le(std::ofstream& out, std::uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+}
+
+constexpr std::size_t RingSink::max_backlog;
+constexpr std::size_t RingSink::max_queued;
+
+Buzzer::Buzzer(AudioSink& sink): sink_(sink) {
+}
+
+void Buzzer::tick(bool on) {
+    if (!on) {
+        // Restart the wave at the next sound, so that every beep sounds the same.
+        phase_ = 0;
+        block_.fill(0);
+        sink_.write(block_.data(), block_.size());
+        return;
+    }
+
+    if (use_pattern_) {
+        for (auto& sample: block_) {
+            auto bit = static_cast<unsigned>(phase_) & 127;
+            sample = (pattern_[bit >> 3] & (0x80 >> (bit & 7))) ? amplitude : -amplitude;
+            phase_ += pattern_step_;
+            if (phase_ >= 128) phase_ -= 128;
+        }
+    } else {
+        constexpr double step = tone_frequency / audio_sample_rate;
+        for (auto& sample: block_) {
+            sample = phase_ < 0.5 ? amplitude : -amplitude;
+            phase_ += step;
+            if (phase_ >= 1) phase_ -= 1;
+        }
+    }
+    sink_.write(block_.data(), block_.size());
+}
+
+void Buzzer::set_pattern(const std::array<std::uint8_t, 16>& pattern, std::uint8_t pitch) {
+    pattern_ = pattern;
+    pattern_step_ = 4000 * std::pow(2.0, (pitch - 64) / 48.0) / audio_sample_rate;
+    if (!use_pattern_) phase_ = 0;
+    use_pattern_ = true;
+}
+
+void RingSink::write(const std::int16_t* samples, std::size_t count) {
+    auto queued = ring_.size();
+    auto room = queued < max_queued ? max_queued - queued : 0;
+    if (count > room) {
+        // Drop the oldest part of the block: the end is what should be heard now.
+        dropped_ += count - room;
+        samples += count - room;
+        count = room;
+    }
+    dropped_ += count - ring_.push(samples, count);
+}
+
+void read_audio(AudioRing& ring, std::int16_t* out, std::size_t count) {
+    auto read = ring.pop(out, count);
+    std::fill(out + read, out + count, 0);
+}
+
+WavWriter::WavWriter(const std::string& path): out_(path, std::ios::binary) {
+    if (!out_) throw std::runtime_error("Cannot open " + path);
+    // Placeholder header, see close().
+    out_.write(std::string(44, '\0').data(), 44);
+}
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+void WavWriter::write(const std::int16_t* samples, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        write_le(out_, static_cast<std::uint16_t>(samples[i]), 2);
+    }
+    data_size_ += count * 2;
+}
+
+void WavWriter::close() {
+    if (!out_.is_open()) return;
+    out_.seekp(0);
+    out_.write("RIFF", 4);
+    write_le(out_, 36 + data_size_, 4);
+    out_.write("WAVEfmt ", 8);
+    write_le(out_, 16, 4);
+    // PCM, mono.
+    write_le(out_, 1, 2);
+    write_le(out_, 1, 2);
+    write_le(out_, audio_sample_rate, 4);
+    write_le(out_, audio_sample_rate * 2, 4);
+    write_le(out_, 2, 2);
+    write_le(out_, 16, 2);
+    out_.write("data", 4);
+    write_le(out_, data_size_, 4);
+    out_.close();
+}
+
+}
@@ -0,0 +1,90 @@
+// Sound. The core ticks a Buzzer at 60Hz with the state of the sound timer, the Buzzer writes exactly one tick of
+// samples to a sink: a ring buffer read by the sound card callback, or a WAV file for headless runs.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "spsc_queue.h"
+
+namespace snooz {
+
+constexpr unsigned audio_sample_rate = 44100;
+// Sound starts and stops on these boundaries.
+constexpr unsigned samples_per_tick = audio_sample_rate / 60;
+// Samples the sound card callback reads at once. SFML keeps three such chunks queued in the device.
+constexpr std::size_t audio_chunk_size = 128;
+
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+    virtual void write(const std::int16_t* samples, std::size_t count) = 0;
+};
+
+// Turns timer ticks into samples.
+class Buzzer {
+public:
+    explicit Buzzer(AudioSink& sink);
+
+    // Once per 60Hz tick, before the timers are decreased. `on` is true when the sound timer is not 0.
+    void tick(bool on);
+
+    // XO-CHIP audio: the 128 bits of the pattern are played in a loop, one bit per sample at
+    // 4000 * 2^((pitch - 64) / 48) Hz. Without a pattern, the buzzer is a plain square wave.
+    void set_pattern(const std::array<std::uint8_t, 16>& pattern, std::uint8_t pitch = 64);
+    void clear_pattern() { use_pattern_ = false; }
+
+private:
+    AudioSink& sink_;
+    std::array<std::int16_t, samples_per_tick> block_;
+
+    bool use_pattern_{false};
+    std::array<std::uint8_t, 16> pattern_{};
+    // Pattern bits advanced per output sample.
+    double pattern_step_{0};
+    // Position in the wave or in the pattern. Kept between ticks so that the wave has no seam.
+    double phase_{0};
+};
+
+using AudioRing = SpscQueue<std::int16_t, 4096>;
+
+// Feeds a real time callback. Writing never blocks: when the reader falls behind, the start of the tick is dropped
+// so that it is not heard more than max_backlog samples late.
+class RingSink : public AudioSink {
+public:
+    // Samples still queued when a tick is written: how late it starts to play. It has to cover one chunk read
+    // early and the jitter of the ticks (2 ms) or the callback runs dry. With the device chunks, a tick is heard at
+    // most 320 + 3 * 128 = 704 samples (16 ms) after it is written. The rest of the ring is the tick playing.
+    static constexpr std::size_t max_backlog = 320;
+    static constexpr std::size_t max_queued = samples_per_tick + max_backlog;
+
+    explicit RingSink(AudioRing& ring): ring_(ring) {}
+    void write(const std::int16_t* samples, std::size_t count) override;
+
+    std::uint64_t dropped() const { return dropped_; }
+
+private:
+    AudioRing& ring_;
+    std::uint64_t dropped_{0};
+};
+
+// Audio callback side. Always fills `count` samples, with silence when the ring runs dry.
+void read_audio(AudioRing& ring, std::int16_t* out, std::size_t count);
+
+// 16 bits mono PCM. The sizes in the header are written when the file is closed. Throw std::runtime_error.
+class WavWriter : public AudioSink {
+public:
+    explicit WavWriter(const std::string& path);
+    ~WavWriter() override;
+
+    void write(const std::int16_t* samples, std::size_t count) override;
+    void close();
+
+private:
+    std::ofstream out_;
+    std::uint32_t data_size_{0};
+};
+
+}
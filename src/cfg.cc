@@ -0,0 +1,300 @@
+#include "cfg.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include "decoder.h"
+
+namespace snooz {
+
+namespace {
+
+// An address to explore, with the value of I when reaching it (-1 if unknown).
+struct Path {
+    std::uint16_t address;
+    int I;
+};
+
+enum class Kind {
+    Normal,
+    Return,
+    Jump,
+    Call,
+    Skip,
+    IndirectJump,
+    // 0NNN (RCA 1802 call) and unknown opcodes. The interpreter does not execute them.
+    Invalid,
+};
+
+Kind kind_of(std::uint16_t opcode) {
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        if (opcode == 0x00E0) return Kind::Normal;
+        if (opcode == 0x00EE) return Kind::Return;
+        return Kind::Invalid;
+    case 0x1000:
+        return Kind::Jump;
+    case 0x2000:
+        return Kind::Call;
+    case 0x3000:
+    case 0x4000:
+        return Kind::Skip;
+    case 0x5000:
+    case 0x9000:
+        return (opcode & 0x000F) == 0 ? Kind::Skip : Kind::Invalid;
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+            return Kind::Normal;
+        default:
+            return Kind::Invalid;
+        }
+    case 0xB000:
+        return Kind::IndirectJump;
+    case 0xE000:
+        return ((opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1) ? Kind::Skip : Kind::Invalid;
+    case 0xF000:
+        switch (opcode & 0x00FF) {
+        case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x33: case 0x55: case 0x65:
+            return Kind::Normal;
+        default:
+            return Kind::Invalid;
+        }
+    default:
+        return Kind::Normal;
+    }
+}
+
+class Builder {
+public:
+    Builder(const std::uint8_t* rom, std::size_t size, std::uint16_t origin, ControlFlowGraph& cfg):
+            rom_(rom), size_(size), origin_(origin), cfg_(cfg) {}
+
+    void explore() {
+        push(Path{origin_, -1}, ControlFlowGraph::BlockStart);
+        while (!paths_.empty()) {
+            auto path = paths_.back();
+            paths_.pop_back();
+            follow(path);
+        }
+    }
+
+    void make_blocks() {
+        for (std::uint32_t address = origin_; address < origin_ + size_; address++) {
+            if (cfg_.has(address, ControlFlowGraph::InstructionStart) && cfg_.has(address, ControlFlowGraph::BlockStart)) {
+                cfg_.blocks.push_back(make_block(address));
+            }
+        }
+    }
+
+    bool in_rom(std::uint32_t address) const {
+        return address >= origin_ && address + 1 < origin_ + size_;
+    }
+
+    std::uint16_t opcode_at(std::uint16_t address) const {
+        return (rom_[address - origin_] << 8) | rom_[address - origin_ + 1];
+    }
+
+private:
+    void push(Path path, std::uint8_t flag) {
+        cfg_.flags[path.address & 0xFFF] |= flag;
+        paths_.push_back(path);
+    }
+
+    void mark_data(int I, std::size_t count) {
+        if (I < 0) return;
+        for (std::size_t i = 0; i < count; i++) {
+            cfg_.flags[(I + i) & 0xFFF] |= ControlFlowGraph::Data;
+        }
+    }
+
+    // Decode linearly from the path until the flow stops or reaches known code.
+    void follow(Path path) {
+        std::uint16_t address = path.address;
+        int I = path.I;
+        while (in_rom(address)) {
+            if (cfg_.has(address, ControlFlowGraph::InstructionStart)) {
+                // Joining code explored from another path.
+                cfg_.flags[address] |= ControlFlowGraph::BlockStart;
+                return;
+            }
+
+            auto opcode = opcode_at(address);
+            auto kind = kind_of(opcode);
+            if (kind == Kind::Invalid) return;
+
+            cfg_.flags[address] |= ControlFlowGraph::Code | ControlFlowGraph::InstructionStart;
+            cfg_.flags[address + 1] |= ControlFlowGraph::Code;
+
+            std::uint16_t next = address + 2;
+            std::uint16_t nnn = opcode & 0x0FFF;
+            switch (kind) {
+            case Kind::Return:
+            case Kind::IndirectJump:
+                return;
+            case Kind::Jump:
+                push(Path{nnn, I}, ControlFlowGraph::BlockStart | ControlFlowGraph::JumpTarget);
+                return;
+            case Kind::Call:
+                push(Path{nnn, -1}, ControlFlowGraph::BlockStart | ControlFlowGraph::Subroutine);
+                // The subroutine can change I.
+                I = -1;
+                cfg_.flags[next & 0xFFF] |= ControlFlowGraph::BlockStart;
+                break;
+            case Kind::Skip:
+                push(Path{static_cast<std::uint16_t>(address + 4), I}, ControlFlowGraph::BlockStart);
+                cfg_.flags[next & 0xFFF] |= ControlFlowGraph::BlockStart;
+                break;
+            default:
+                switch (opcode & 0xF000) {
+                case 0xA000:
+                    I = nnn;
+                    break;
+                case 0xD000:
+                    mark_data(I, opcode & 0x000F);
+                    break;
+                case 0xF000:
+                    switch (opcode & 0x00FF) {
+                    case 0x1E:
+                    case 0x29:
+                        I = -1;
+                        break;
+                    case 0x33:
+                        mark_data(I, 3);
+                        break;
+                    case 0x55:
+                    case 0x65:
+                        mark_data(I, ((opcode & 0x0F00) >> 8) + 1);
+                        break;
+                    }
+                    break;
+                }
+                break;
+            }
+            address = next;
+        }
+    }
+
+    BasicBlock make_block(std::uint16_t start) {
+        BasicBlock block;
+        block.start = start;
+        std::uint16_t address = start;
+        while (true) {
+            auto opcode = opcode_at(address);
+            std::uint16_t next = address + 2;
+            std::uint16_t nnn = opcode & 0x0FFF;
+            block.end = next;
+
+            switch (kind_of(opcode)) {
+            case Kind::Return:
+                block.returns = true;
+                return block;
+            case Kind::IndirectJump:
+                block.indirect_jump = true;
+                return block;
+            case Kind::Jump:
+                block.successors.push_back(nnn);
+                return block;
+            case Kind::Call:
+                block.calls.push_back(nnn);
+                if (in_rom(next)) block.successors.push_back(next);
+                return block;
+            case Kind::Skip:
+                if (in_rom(next)) block.successors.push_back(next);
+                if (in_rom(next + 2)) block.successors.push_back(next + 2);
+                return block;
+            default:
+                break;
+            }
+
+            if (!in_rom(next) || !cfg_.has(next, ControlFlowGraph::InstructionStart)) {
+                // Runs into data or out of the ROM.
+                return block;
+            }
+            if (cfg_.has(next, ControlFlowGraph::BlockStart)) {
+                block.successors.push_back(next);
+                return block;
+            }
+            address = next;
+        }
+    }
+
+    const std::uint8_t* rom_;
+    std::size_t size_;
+    std::uint16_t origin_;
+    ControlFlowGraph& cfg_;
+    std::vector<Path> paths_;
+};
+
+void append(std::string& out, const char* text, int length) {
+    if (length > 0) out.append(text, length);
+}
+
+}
+
+const BasicBlock* ControlFlowGraph::block_at(std::uint16_t address) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), address, [](std::uint16_t a, const BasicBlock& block) {
+        return a < block.start;
+    });
+    if (it == blocks.begin()) return nullptr;
+    --it;
+    return address < it->end ? &*it : nullptr;
+}
+
+int ControlFlowGraph::block_index(std::uint16_t start) const {
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), start, [](const BasicBlock& block, std::uint16_t a) {
+        return block.start < a;
+    });
+    if (it == blocks.end() || it->start != start) return -1;
+    return static_cast<int>(it - blocks.begin());
+}
+
+ControlFlowGraph build_cfg(const std::uint8_t* rom, std::size_t size, std::uint16_t origin) {
+    ControlFlowGraph cfg;
+    cfg.origin = origin;
+    cfg.length = std::min<std::size_t>(size, 4096 - origin);
+
+    Builder builder(rom, cfg.length, origin, cfg);
+    builder.explore();
+    builder.make_blocks();
+    return cfg;
+}
+
+ControlFlowGraph build_cfg(const std::vector<std::uint8_t>& rom, std::uint16_t origin) {
+    return build_cfg(rom.data(), rom.size(), origin);
+}
+
+void write_listing(std::string& out, const ControlFlowGraph& cfg, const std::uint8_t* rom, const Decoder& decoder) {
+    char line[Decoder::max_line_size];
+    std::uint32_t end = cfg.origin + cfg.length;
+    std::uint32_t address = cfg.origin;
+
+    while (address < end) {
+        if (cfg.has(address, ControlFlowGraph::InstructionStart) && address + 1 < end) {
+            if (cfg.has(address, ControlFlowGraph::Subroutine)) {
+                append(out, line, std::snprintf(line, sizeof(line), "\nsub_%03x:\n", address));
+            } else if (cfg.has(address, ControlFlowGraph::JumpTarget)) {
+                append(out, line, std::snprintf(line, sizeof(line), "L_%03x:\n", address));
+            }
+            std::uint16_t opcode = (rom[address - cfg.origin] << 8) | rom[address - cfg.origin + 1];
+            out += "    ";
+            decoder.format_to(std::back_inserter(out), opcode, address);
+            out += '\n';
+            address += 2;
+            continue;
+        }
+
+        // Everything up to the next instruction is shown as bytes, 8 per line.
+        auto is_sprite = cfg.is_data(address);
+        append(out, line, std::snprintf(line, sizeof(line), "    %x\tdb", address));
+        int count = 0;
+        while (address < end && count < 8 && (count == 0 || (!cfg.has(address, ControlFlowGraph::InstructionStart)
+                                                             && cfg.is_data(address) == is_sprite))) {
+            append(out, line, std::snprintf(line, sizeof(line), count == 0 ? " 0x%02x" : ", 0x%02x", rom[address - cfg.origin]));
+            address++;
+            count++;
+        }
+        out += is_sprite ? "\t; data\n" : "\n";
+    }
+}
+
+}
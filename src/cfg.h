@@ -0,0 +1,71 @@
+// Recursive-descent disassembly. Instead of decoding every two bytes from 0x200, follow the control flow
+// from the entry point so that sprites and other data are not shown as instructions, and code starting
+// at odd addresses is found.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace snooz {
+
+class Decoder;
+
+struct BasicBlock {
+    std::uint16_t start;
+    // Address right after the last instruction of the block.
+    std::uint16_t end;
+    // Where the execution can continue after the block. A block ending with 2NNN has the return address
+    // as successor, and the subroutine in `calls`.
+    std::vector<std::uint16_t> successors;
+    std::vector<std::uint16_t> calls;
+    // Last instruction is 00EE.
+    bool returns{false};
+    // Last instruction is BNNN, its target is only known at runtime.
+    bool indirect_jump{false};
+};
+
+struct ControlFlowGraph {
+    // Flags per address of the 4K memory.
+    enum Flag : std::uint8_t {
+        // Byte belongs to a reachable instruction.
+        Code = 1 << 0,
+        // First byte of a reachable instruction.
+        InstructionStart = 1 << 1,
+        // Byte used through I: sprite drawn with DXYN, or FX33/FX55/FX65 operand.
+        Data = 1 << 2,
+        // Target of a jump or a branch.
+        JumpTarget = 1 << 3,
+        // Target of a 2NNN.
+        Subroutine = 1 << 4,
+        // Start of a basic block.
+        BlockStart = 1 << 5,
+    };
+
+    std::uint16_t origin{0x200};
+    std::size_t length{0};
+    std::array<std::uint8_t, 4096> flags{};
+    // Sorted by start address.
+    std::vector<BasicBlock> blocks;
+
+    bool has(std::uint16_t address, Flag flag) const { return (flags[address & 0xFFF] & flag) != 0; }
+    bool is_code(std::uint16_t address) const { return has(address, Code); }
+    bool is_data(std::uint16_t address) const { return has(address, Data); }
+
+    // Block containing that address, or nullptr.
+    const BasicBlock* block_at(std::uint16_t address) const;
+    // Index of the block starting at that address in `blocks`, or -1.
+    int block_index(std::uint16_t start) const;
+};
+
+// Follow 1NNN/2NNN/skips and returns from `origin`. ANNN followed by DXYN (or FX33/FX55/FX65) marks the
+// bytes at I as data.
+ControlFlowGraph build_cfg(const std::uint8_t* rom, std::size_t size, std::uint16_t origin = 0x200);
+ControlFlowGraph build_cfg(const std::vector<std::uint8_t>& rom, std::uint16_t origin = 0x200);
+
+// Labeled listing: instructions of reachable code, `db` lines for everything else.
+void write_listing(std::string& out, const ControlFlowGraph& cfg, const std::uint8_t* rom, const Decoder& decoder);
+
+}
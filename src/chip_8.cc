@@ -2,14 +2,23 @@
 // Created by benoit on 18/11/03.
 //
 
-#include <fstream>
+#include <algorithm>
 #include <vector>
 #include "chip_8.h"
-#include <cassert>
-#include <iostream>
+#include "hash.h"
 #include <sstream>
 #include <iomanip>
 
+// Record a trace event if the compile-time level allows it. Compiles to nothing otherwise.
+#if CHIP8_TRACE_LEVEL > CHIP8_TRACE_OFF
+#define CHIP8_TRACE(level, event, arg) \
+    do { \
+        if ((level) <= CHIP8_TRACE_LEVEL) trace_.record(cycles_, pc_, opcode_, (event), (arg)); \
+    } while (0)
+#else
+#define CHIP8_TRACE(level, event, arg) do {} while (0)
+#endif
+
 namespace snooz {
 
 constexpr std::uint8_t Chip8::chip8_fontset[80];
@@ -18,13 +27,7 @@ Chip8::Chip8():
         e1{r_()},
         pc_(0x200){ 
 
-    // black screen at first
-    for (auto& pixel: gfx_) pixel = 0;
-    for (auto& key: key_) key = false;
-
-    // Load fontset
-    for(int i = 0; i < 80; ++i)
-        memory_[i] = chip8_fontset[i];
+    reset();
 
     // opcode & 0xF000
     opcode_dispath_ = {
@@ -76,16 +79,137 @@ Chip8::Chip8():
     };
 }
 
+void Chip8::reset() {
+    // black screen at first
+    gfx_.fill(0);
+    key_.fill(false);
+    // Start from a known state so that runs (and their hashes) are reproducible.
+    memory_.fill(0);
+    V_.fill(0);
+    stack_.fill(0);
+
+    // Load fontset
+    for(int i = 0; i < 80; ++i)
+        memory_[i] = chip8_fontset[i];
+
+    opcode_ = 0;
+    I_ = 0;
+    pc_ = 0x200;
+    sp_ = 0;
+    delay_timer_ = 0;
+    sound_timer_ = 0;
+    timer_tick_ = 0;
+    tick_base_ = 0;
+    tick_cycle_ = 0;
+    wait_for_key_ = false;
+    key_pressed_ = false;
+    key_pressed_idx_ = 0;
+    draw_flag_ = false;
+    should_continue_ = true;
+    cycles_ = 0;
+    profile_ = default_profile();
+    rehash();
+}
+
 void Chip8::decrease_timers() {
-    if (delay_timer_ > 0) delay_timer_--;
-    if (sound_timer_ > 0) sound_timer_--;
+    tick_base_++;
+    update_timers();
+}
+
+bool Chip8::sound_active() const {
+    // Tick of the last instruction. After a frame, that is the tick before the one that ended it.
+    auto tick = cycles_ > tick_cycle_ ? tick_at(cycles_ - 1) : tick_base_;
+    return timer_at(sound_timer_, tick) > 0;
+}
+
+void Chip8::update_timers() {
+    auto tick = timer_tick();
+    delay_timer_ = timer_at(delay_timer_, tick);
+    sound_timer_ = timer_at(sound_timer_, tick);
+    timer_tick_ = tick;
+}
+
+std::uint8_t Chip8::timer_at(std::uint8_t value, std::uint64_t elapsed_from, std::uint64_t tick) {
+    // Before the last update (sound_active right after decrease_timers): the stored value is the best we know.
+    if (tick <= elapsed_from) return value;
+    auto elapsed = tick - elapsed_from;
+    return elapsed < value ? static_cast<std::uint8_t>(value - elapsed) : 0;
+}
+
+Idle Chip8::idle() const {
+    if (!should_continue_ || (wait_for_key_ && !key_pressed_)) return Idle::UntilKey;
+    auto pc = pc_ & 0xFFF;
+    if (((memory_[pc] << 8) | memory_[(pc + 1) & 0xFFF]) == (0x1000 | pc)) return Idle::UntilKey;
+    if (delay_loop() >= 0 && delay_timer() > 0) return Idle::UntilTick;
+    return Idle::No;
+}
+
+int Chip8::delay_loop() const {
+    if (!profile_.idle_skip_safe) return -1;
+    // pc can be on any of the three instructions.
+    for (int start = pc_ - 4; start <= pc_; start += 2) {
+        if (start < 0 || start + 6 > static_cast<int>(memory_.size())) continue;
+        auto x = memory_[start] & 0x0F;
+        if (memory_[start] == (0xF0 | x) && memory_[start + 1] == 0x07
+                && memory_[start + 2] == (0x30 | x) && memory_[start + 3] == 0x00
+                && ((memory_[start + 4] << 8) | memory_[start + 5]) == (0x1000 | start)) {
+            return start;
+        }
+    }
+    return -1;
+}
+
+std::uint64_t Chip8::skip_idle(std::uint64_t count) {
+    switch (idle()) {
+    case Idle::No:
+        return 0;
+    case Idle::UntilKey:
+        // Every instruction leaves the state as it is, except for the count. A stopped machine runs nothing.
+        if (!should_continue_ || count == 0) return 0;
+        next_opcode();
+        cycles_ += count;
+        return count;
+    case Idle::UntilTick:
+        break;
+    }
+
+    // Run up to the FX07 of the loop, then skip whole iterations while FX07 still reads more than 0.
+    std::uint64_t skipped = 0;
+    auto start = static_cast<std::uint16_t>(delay_loop());
+    while (pc_ != start && skipped < count) {
+        emulateCycle();
+        skipped++;
+    }
+    if (pc_ != start || delay_loop() < 0 || delay_timer() == 0) return skipped;
+
+    auto end_cycle = tick_cycle_ + (idle_until_tick() - tick_base_) * instructions_per_frame();
+    if (end_cycle <= cycles_) return skipped;
+    auto iterations = std::min((count - skipped) / 3, (end_cycle - cycles_ + 2) / 3);
+    if (iterations == 0) return skipped;
+
+    // State after the last iteration: Vx holds what its FX07 read, and the jump was the last opcode.
+    auto last_read = cycles_ + 3 * (iterations - 1);
+    write_register(memory_[start] & 0x0F, timer_at(delay_timer_, tick_at(last_read)));
+    opcode_ = (memory_[start + 4] << 8) | memory_[start + 5];
+    cycles_ += 3 * iterations;
+    return skipped + 3 * iterations;
+}
+
+void Chip8::rebase_timer_clock() {
+    tick_base_ = timer_tick();
+    tick_cycle_ = cycles_;
+}
+
+void Chip8::set_instructions_per_frame(std::uint32_t count) {
+    rebase_timer_clock();
+    profile_.instructions_per_frame = count != 0 ? count : 1;
 }
 
 void Chip8::set_key_pressed(const size_t& index) {
-    // No problem is overflow, std::array will scream.
+    if (index >= key_.size()) return;
     key_[index] = true;
 
-    std::cout << "PRESSED KEY " << index << '\n';
+    CHIP8_TRACE(CHIP8_TRACE_INPUT, TraceEvent::KeyPressed, index);
     // This is for FX0A
     if (wait_for_key_) {
        key_pressed_ = true;
@@ -94,19 +218,32 @@ void Chip8::set_key_pressed(const size_t& index) {
 }
 
 void Chip8::set_key_released(const size_t& index) {
-    // No problem is overflow, std::array will scream.
+    if (index >= key_.size()) return;
     key_[index] = false;
+
+    CHIP8_TRACE(CHIP8_TRACE_INPUT, TraceEvent::KeyReleased, index);
 }
 void Chip8::load_game(std::string source) {
+    RomLibrary library;
+    load_rom(resolve_rom(source, library));
+}
 
-    std::ifstream input(source, std::ios::binary);
-    std::vector<std::uint8_t > v((std::istreambuf_iterator<char>(input)),
-                         std::istreambuf_iterator<char>());
-    assert(v.size() < memory_.size() - 512);
-
-    for (size_t i = 0; i < v.size(); i++) {
-        memory_[i+512] = v[i];
+void Chip8::load_rom(RomSpan rom) {
+    if (rom.size > memory_.size() - 512) {
+        throw RomError("ROM of " + std::to_string(rom.size) + " bytes does not fit in memory");
     }
+    // Clear what a previous game left behind.
+    std::fill(memory_.begin() + 512, memory_.end(), 0);
+    std::copy(rom.begin(), rom.end(), memory_.begin() + 512);
+    rehash();
+
+    auto profile = find_profile(fnv1a(rom.data, rom.size));
+    apply_profile(profile != nullptr ? *profile : default_profile());
+}
+
+void Chip8::apply_profile(const RomProfile& profile) {
+    rebase_timer_clock();
+    profile_ = profile;
 }
 
 bool Chip8::should_continue() const {
@@ -115,15 +252,77 @@ bool Chip8::should_continue() const {
 
 void Chip8::emulateCycle() {
     next_opcode();
-    if (opcode_dispath_.find(opcode_& 0xF000) != opcode_dispath_.end()) {
+    CHIP8_TRACE(CHIP8_TRACE_ALL, TraceEvent::Instruction, 0);
+#ifdef CHIP8_PROFILE
+    auto opcode = opcode_;
+    auto profile_start = profiler_.enter(pc_, opcode);
+#endif
+    if (profile_.engine == Engine::FlatTable) {
+        (this->*flat_table()[flat_index(opcode_)])();
+    } else if (opcode_dispath_.find(opcode_& 0xF000) != opcode_dispath_.end()) {
         opcode_dispath_[opcode_&0xF000]();
     } else {
-        std::cerr << "Cycle - Unknown opcode " << std::hex << opcode_ << std::endl;
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::UnknownOpcode, 0);
     }
+#ifdef CHIP8_PROFILE
+    profiler_.leave(profile_start, opcode);
+#endif
+    cycles_++;
+}
+
+const std::array<Chip8::Handler, 4096>& Chip8::flat_table() {
+    static const std::array<Handler, 4096> table = [] {
+        std::array<Handler, 4096> handlers;
+        handlers.fill(&Chip8::op_unknown);
+
+        // The second and third nibbles are operands, except for the groups decoded below.
+        const Handler by_group[16] = {
+                &Chip8::op_0000, &Chip8::op_1NNN, &Chip8::op_2NNN, &Chip8::op_3XNN,
+                &Chip8::op_4XNN, &Chip8::op_5XY0, &Chip8::op_6XNN, &Chip8::op_7XNN,
+                nullptr, &Chip8::op_9XY0, &Chip8::op_ANNN, &Chip8::op_BNNN,
+                &Chip8::op_CXNN, &Chip8::op_DXYN, nullptr, nullptr,
+        };
+        for (std::uint16_t group = 0; group < 16; group++) {
+            if (by_group[group] == nullptr) continue;
+            for (std::uint16_t low = 0; low < 0x100; low++) {
+                handlers[(group << 8) | low] = by_group[group];
+            }
+        }
+
+        // 8XYN: the last nibble is the operation, Y is an operand.
+        const Handler arithmetic[16] = {
+                &Chip8::op_8xy0, &Chip8::op_8xy1, &Chip8::op_8xy2, &Chip8::op_8xy3,
+                &Chip8::op_8xy4, &Chip8::op_8xy5, &Chip8::op_8xy6, &Chip8::op_8xy7,
+                nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &Chip8::op_8xyE, nullptr,
+        };
+        for (std::uint16_t low = 0; low < 0x100; low++) {
+            if (arithmetic[low & 0xF] != nullptr) handlers[0x800 | low] = arithmetic[low & 0xF];
+        }
+
+        handlers[flat_index(0xE09E)] = &Chip8::op_EX9E;
+        handlers[flat_index(0xE0A1)] = &Chip8::op_EXA1;
+
+        handlers[flat_index(0xF007)] = &Chip8::op_FX07;
+        handlers[flat_index(0xF00A)] = &Chip8::op_FX0A;
+        handlers[flat_index(0xF015)] = &Chip8::op_FX15;
+        handlers[flat_index(0xF018)] = &Chip8::op_FX18;
+        handlers[flat_index(0xF01E)] = &Chip8::op_FX1E;
+        handlers[flat_index(0xF029)] = &Chip8::op_FX29;
+        handlers[flat_index(0xF033)] = &Chip8::op_FX33;
+        handlers[flat_index(0xF055)] = &Chip8::op_FX55;
+        handlers[flat_index(0xF065)] = &Chip8::op_FX65;
+        return handlers;
+    }();
+    return table;
+}
+
+void Chip8::op_unknown() {
+    CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::UnknownOpcode, 0);
 }
 
 void Chip8::next_opcode() {
-    opcode_ = (memory_[pc_] << 8) | memory_[pc_+1];
+    // Addresses wrap at 4K, like every other memory access.
+    opcode_ = (memory_[pc_ & 0xFFF] << 8) | memory_[(pc_ + 1) & 0xFFF];
 }
 
 void Chip8::op_0000() {
@@ -131,6 +330,7 @@ void Chip8::op_0000() {
         op_00EE();
     } else if (opcode_ == 0x00E0) {
         for (auto& pixel : gfx_) pixel = 0;
+        for (std::size_t row = 0; row < gfx_rows_.size(); row++) write_row(row, 0);
         pc_ += 2;
     }
 }
@@ -139,7 +339,11 @@ void Chip8::op_0000() {
 // 00EE     Flow    return;     Returns from a subroutine. 
 void Chip8::op_00EE() {
     // get the index from last stack and increase by 2 to jump to next instruction
-    assert(sp_ > 0);
+    if (sp_ == 0) {
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::StackUnderflow, 0);
+        should_continue_ = false;
+        return;
+    }
     pc_ = stack_[sp_-1]+2;
     sp_--;
 }
@@ -156,8 +360,13 @@ void Chip8::op_1NNN() {
 }
 
 void Chip8::op_2NNN() {
+    if (sp_ == stack_.size()) {
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::StackOverflow, 0);
+        should_continue_ = false;
+        return;
+    }
     // need to store the current pc.
-    stack_[sp_] = pc_;
+    write_stack(sp_, pc_);
     sp_++;
     pc_ = opcode_ & 0x0FFF;
 
@@ -197,12 +406,13 @@ void Chip8::op_5XY0() {
 
 // assignment :)
 void Chip8::op_6XNN() {
-    V_[(opcode_ & 0x0F00) >> 8] = opcode_ & 0xFF;
+    write_register((opcode_ & 0x0F00) >> 8, opcode_ & 0xFF);
     pc_ += 2;
 }
 
 void Chip8::op_7XNN() {
-    V_[(opcode_ & 0X0F00) >> 8] += opcode_ & 0xFF;
+    auto x = (opcode_ & 0X0F00) >> 8;
+    write_register(x, V_[x] + (opcode_ & 0xFF));
     pc_ += 2;
 }
 
@@ -210,7 +420,7 @@ void Chip8::op_8000() {
     if (arithmetic_dispath_.find(opcode_& 0x000F) != arithmetic_dispath_.end()) {
         arithmetic_dispath_[opcode_&0x000F]();
     } else {
-        std::cerr << "Unknown opcode " << std::hex << opcode_ << std::endl;
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::UnknownOpcode, 0);
     }
 }
 
@@ -219,28 +429,31 @@ void Chip8::op_8xy0() {
     auto X = (opcode_ & 0x0F00) >> 8;
     auto Y = (opcode_ & 0x00F0) >> 4;
 
-    V_[X] = V_[Y];
+    write_register(X, V_[Y]);
     pc_ += 2;
 }
 
 void Chip8::op_8xy1() {
     auto x = get_0X00(opcode_);
     auto y = get_00Y0(opcode_);
-    V_[x] = V_[x] | V_[y];
+    write_register(x, V_[x] | V_[y]);
+    if (profile_.quirks.logic_resets_vf) write_register(0xF, 0);
     pc_ += 2;
 }
 
 void Chip8::op_8xy2() {
     auto x = get_0X00(opcode_);
     auto y = get_00Y0(opcode_);
-    V_[x] = V_[x] & V_[y];
+    write_register(x, V_[x] & V_[y]);
+    if (profile_.quirks.logic_resets_vf) write_register(0xF, 0);
     pc_ += 2;
 }
 
 void Chip8::op_8xy3() {
     auto x = get_0X00(opcode_);
     auto y = get_00Y0(opcode_);
-    V_[x] = V_[x] ^ V_[y];
+    write_register(x, V_[x] ^ V_[y]);
+    if (profile_.quirks.logic_resets_vf) write_register(0xF, 0);
     pc_ += 2;
 }
 
@@ -249,13 +462,13 @@ void Chip8::op_8xy4() {
     auto Y = (opcode_ & 0x00F0) >> 4;
 
     if (V_[X] > 0xFF - V_[Y]) {
-        V_[0xF] = 1;
+        write_register(0xF, 1);
     } else {
-        V_[0xF] = 0;
+        write_register(0xF, 0);
     }
 
 
-    V_[X] += V_[Y];
+    write_register(X, V_[X] + V_[Y]);
     pc_ += 2;
 }
 
@@ -264,21 +477,22 @@ void Chip8::op_8xy5() {
     auto Y = get_00Y0(opcode_);
 
     if (V_[X] < V_[Y]) {
-        V_[0xF] = 1;
+        write_register(0xF, 1);
     } else {
-        V_[0xF] = 0;
+        write_register(0xF, 0);
     }
 
 
-    V_[X] -= V_[Y];
+    write_register(X, V_[X] - V_[Y]);
     pc_ += 2;
 
 }
 
 void Chip8::op_8xy6() {
     auto x = get_0X00(opcode_);
-    V_[0xF] = V_[x] & 0x1;
-    V_[x] = V_[x] >> 1;
+    auto value = profile_.quirks.shift_uses_vy ? V_[get_00Y0(opcode_)] : V_[x];
+    write_register(0xF, value & 0x1);
+    write_register(x, value >> 1);
     pc_ += 2;
 }
 
@@ -288,20 +502,21 @@ void Chip8::op_8xy7() {
 
     // set to 1 if there is NO borrow this time.
     if (V_[X] < V_[Y]) {
-        V_[0xF] = 1;
+        write_register(0xF, 1);
     } else {
-        V_[0xF] = 0;
+        write_register(0xF, 0);
     }
 
     // y - x
-    V_[X] = V_[Y] - V_[X];
+    write_register(X, V_[Y] - V_[X]);
     pc_ += 2;
 }
 
 void Chip8::op_8xyE() {
     auto x = get_0X00(opcode_);
-    V_[0xF] = (V_[x] >> 7)  & 0x1;
-    V_[x] = V_[x] << 1;
+    auto value = profile_.quirks.shift_uses_vy ? V_[get_00Y0(opcode_)] : V_[x];
+    write_register(0xF, (value >> 7)  & 0x1);
+    write_register(x, value << 1);
     pc_ += 2;
 
 }
@@ -317,13 +532,14 @@ void Chip8::op_9XY0() {
 }
 
 void Chip8::op_BNNN() {
-    pc_ = V_[0] + (opcode_ & 0x0FFF);
+    auto offset = profile_.quirks.jump_uses_vx ? V_[get_0X00(opcode_)] : V_[0];
+    pc_ = offset + (opcode_ & 0x0FFF);
 }
 
 void Chip8::op_CXNN() {
     // CXNN     Rand    Vx=rand()&NN    Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN. 
     auto rand = static_cast<std::uint8_t>(uniform_dist(e1) & 0xFF); 
-    V_[(opcode_ & 0x0F00) >> 8] = rand & (opcode_ & 0x0FF);
+    write_register((opcode_ & 0x0F00) >> 8, rand & (opcode_ & 0x0FF));
     pc_ += 2;
 }
 
@@ -339,7 +555,7 @@ void Chip8::op_DXYN() {
     auto y = V_[(opcode_ & 0x00F0) >> 4];
     auto height = opcode_ & 0x000F;
 
-    V_[0xF] = 0;
+    std::uint8_t collision = 0;
 
     // (64)(64)(64).... 32 times.
     // index in the array is
@@ -347,22 +563,34 @@ void Chip8::op_DXYN() {
     // 64 ......     y * 64 + x
     // 128 ......
     for (int yline = 0; yline < height; yline++) {
-        auto pixel = memory_[I_ + yline];
+        auto pixel = memory_[(I_ + yline) & 0xFFF];
 
+        if (profile_.quirks.clip_sprites && (y % 32) + yline >= 32) break;
+
+        auto row = (y + yline) % 32;
+        auto pixels = gfx_rows_[row];
         for (int xline = 0; xline < 8; xline++) {
+            if (profile_.quirks.clip_sprites && (x % 64) + xline >= 64) break;
 
             // nice little trick. Try it.
             if ((pixel & (0x80 >> xline)) > 0) {
+                // sprites going out of the screen wrap around.
+                auto column = (x + xline) % 64;
+                auto index = column + row * 64;
                 // flipped from set ot unset.
-                if (gfx_[x + xline + (y + yline) * 64] == 1) {
-                    V_[0xF] = 1;
+                if (gfx_[index] == 1) {
+                    collision = 1;
                 }
 
-                gfx_[x + xline + (y + yline) * 64] ^= 1;
+                gfx_[index] ^= 1;
+                pixels ^= 1ULL << column;
             }
 
         }
+        write_row(row, pixels);
     }
+    // VF is written last: it can also be the register of X or Y.
+    write_register(0xF, collision);
     draw_flag_ = true;
     pc_ += 2;
 }
@@ -371,15 +599,15 @@ void Chip8::op_E000() {
     if (keyboard_dispatch_.find(opcode_& 0x00FF) != keyboard_dispatch_.end()) {
         keyboard_dispatch_[opcode_&0x00FF]();
     } else {
-        std::cerr << "Unknown opcode " << std::hex << opcode_ << std::endl;
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::UnknownOpcode, 0);
     }
 }
 
 //  EX9E    KeyOp   if(key()==Vx)   Skips the next instruction if the key stored in VX is pressed. (Usually the next instruction is a jump to skip a code block)
 void Chip8::op_EX9E() {
     auto key_index = V_[(opcode_ & 0x0F00) >> 8];
-    std::cout << "Skip if key " << std::to_string(key_index) << " is pressed (addr " << std::hex << pc_ << ")\n";
-    if (key_[key_index]) {
+    CHIP8_TRACE(CHIP8_TRACE_INPUT, TraceEvent::KeyCheck, key_index);
+    if (key_[key_index & 0xF]) {
         pc_ += 4;
     } else {
         pc_ += 2;
@@ -388,9 +616,8 @@ void Chip8::op_EX9E() {
 // EXA1    KeyOp   if(key()!=Vx)   Skips the next instruction if the key stored in VX isn't pressed. (Usually the next instruction is a jump to skip a code block) 
 void Chip8::op_EXA1() {
     auto key_index = V_[(opcode_ & 0x0F00) >> 8];
-
-    std::cout << "Skip if key " << key_index << "is not pressed (addr " << std::hex << pc_ << ")\n";
-    if (!key_[key_index]) {
+    CHIP8_TRACE(CHIP8_TRACE_INPUT, TraceEvent::KeyCheck, key_index);
+    if (!key_[key_index & 0xF]) {
         pc_ += 4;
     } else {
         pc_ += 2;
@@ -402,7 +629,7 @@ void Chip8::op_F000() {
     if (input_dispatch_.find(opcode_& 0x00FF) != input_dispatch_.end()) {
         input_dispatch_[opcode_&0x00FF]();
     } else {
-        std::cerr << "Input - Unknown opcode " << std::hex << opcode_ << std::endl;
+        CHIP8_TRACE(CHIP8_TRACE_ERROR, TraceEvent::UnknownOpcode, 0);
     }
 
 }
@@ -415,7 +642,7 @@ void Chip8::op_FX0A() {
     if (wait_for_key_) {
 
         if (key_pressed_) {
-            V_[(opcode_ & 0x0F00) >> 8] = key_pressed_idx_;
+            write_register((opcode_ & 0x0F00) >> 8, key_pressed_idx_);
             pc_ += 2;
             // reset key press state.
             wait_for_key_ = false;
@@ -431,18 +658,21 @@ void Chip8::op_FX0A() {
 }
 
 void Chip8::op_FX07() {
-    V_[(opcode_ & 0x0F00) >> 8] = delay_timer_;
+    update_timers();
+    write_register((opcode_ & 0x0F00) >> 8, delay_timer_);
     pc_ += 2;
 }
 // FX15     Timer   delay_timer(Vx)     Sets the delay timer to VX.
 void Chip8::op_FX15() {
-    delay_timer_ = V_[(opcode_ & 0x0F00) >> 8]; 
+    update_timers();
+    delay_timer_ = V_[(opcode_ & 0x0F00) >> 8];
     pc_ += 2;
 }
 
 // FX18     Sound   sound_timer(Vx)     Sets the sound timer to VX.
 void Chip8::op_FX18() {
-    sound_timer_ = V_[get_0X00(opcode_)]; 
+    update_timers();
+    sound_timer_ = V_[get_0X00(opcode_)];
     pc_ += 2;
 }
 
@@ -460,9 +690,9 @@ void Chip8::op_FX29() {
 
 void Chip8::op_FX33() {
     auto x = V_[get_0X00(opcode_)];
-    memory_[I_]     = x / 100;
-    memory_[I_ + 1] = (x / 10) % 10;
-    memory_[I_ + 2] = (x % 100) % 10;
+    write_memory(I_, x / 100);
+    write_memory(I_ + 1, (x / 10) % 10);
+    write_memory(I_ + 2, (x % 100) % 10);
     pc_ += 2;
 }
 
@@ -472,9 +702,10 @@ void Chip8::op_FX55() {
     auto x = get_0X00(opcode_);
     auto mem_idx = I_;
     for (uint8_t reg_idx=0; reg_idx <= x; reg_idx++) {
-        memory_[mem_idx] = V_[reg_idx];
+        write_memory(mem_idx, V_[reg_idx]);
         mem_idx++;
     }
+    if (profile_.quirks.load_store_increments_i) I_ = mem_idx;
 
     pc_ += 2;
 }
@@ -483,16 +714,134 @@ void Chip8::op_FX65() {
     auto x = get_0X00(opcode_);
     auto mem_idx = I_;
     for (uint8_t reg_idx=0; reg_idx <= x; reg_idx++) {
-        V_[reg_idx] = memory_[mem_idx];
+        write_register(reg_idx, memory_[mem_idx & 0xFFF]);
         mem_idx++;
     }
+    if (profile_.quirks.load_store_increments_i) I_ = mem_idx;
     pc_ += 2;
 }
 
 void Chip8::load_from_buffer(const std::vector<uint8_t> &buff) {
-    for (int i = 0; i < buff.size(); i++) {
-       memory_[512+i] = buff[i];
+    load_rom(RomSpan{buff.data(), buff.size()});
+}
+
+Chip8::Snapshot Chip8::snapshot() const {
+    Snapshot snapshot;
+    snapshot.memory = memory_;
+    snapshot.V = V_;
+    snapshot.I = I_;
+    snapshot.pc = pc_;
+    snapshot.opcode = opcode_;
+    snapshot.stack = stack_;
+    snapshot.sp = sp_;
+    snapshot.gfx = gfx_;
+    snapshot.delay_timer = delay_timer();
+    snapshot.sound_timer = sound_timer();
+    snapshot.key = key_;
+    snapshot.wait_for_key = wait_for_key_;
+    snapshot.key_pressed = key_pressed_;
+    snapshot.key_pressed_idx = key_pressed_idx_;
+    snapshot.draw_flag = draw_flag_;
+    snapshot.cycles = cycles_;
+    snapshot.tick_base = tick_base_;
+    snapshot.tick_cycle = tick_cycle_;
+    return snapshot;
+}
+
+void Chip8::restore(const Snapshot& snapshot) {
+    memory_ = snapshot.memory;
+    V_ = snapshot.V;
+    I_ = snapshot.I;
+    pc_ = snapshot.pc;
+    opcode_ = snapshot.opcode;
+    stack_ = snapshot.stack;
+    sp_ = snapshot.sp;
+    gfx_ = snapshot.gfx;
+    delay_timer_ = snapshot.delay_timer;
+    sound_timer_ = snapshot.sound_timer;
+    key_ = snapshot.key;
+    wait_for_key_ = snapshot.wait_for_key;
+    key_pressed_ = snapshot.key_pressed;
+    key_pressed_idx_ = snapshot.key_pressed_idx;
+    draw_flag_ = snapshot.draw_flag;
+    cycles_ = snapshot.cycles;
+    // Same clock as when the snapshot was taken, so that the next tick comes at the same instruction. A clock that
+    // starts after `cycles` would count backwards: it starts at the current instruction instead.
+    tick_base_ = snapshot.tick_base;
+    tick_cycle_ = std::min(snapshot.tick_cycle, cycles_);
+    timer_tick_ = timer_tick();
+    rehash();
+}
+
+namespace {
+
+// Slots of the zobrist keys: one per byte of memory, register, stack entry and screen row, then the scalars.
+constexpr std::uint32_t memory_slot = 0;
+constexpr std::uint32_t register_slot = memory_slot + 4096;
+constexpr std::uint32_t stack_slot = register_slot + 16;
+constexpr std::uint32_t row_slot = stack_slot + 16;
+constexpr std::uint32_t scalar_slot = row_slot + 32;
+
+std::uint64_t packed_row(const std::array<std::uint8_t, 64*32>& gfx, std::size_t row) {
+    std::uint64_t pixels = 0;
+    for (std::size_t column = 0; column < 64; column++) {
+        if (gfx[row * 64 + column] != 0) pixels |= 1ULL << column;
     }
+    return pixels;
+}
+
+}
+
+std::uint64_t Chip8::zobrist(std::uint32_t slot, std::uint64_t value) {
+    // Computed rather than looked up in a table: values can be 64 bits wide (rows) and the table would not fit in
+    // the cache anyway.
+    return splitmix64(splitmix64(slot) ^ value);
+}
+
+void Chip8::write_register(std::size_t x, std::uint8_t value) {
+    array_hash_ ^= zobrist(register_slot + x, V_[x]) ^ zobrist(register_slot + x, value);
+    V_[x] = value;
+}
+
+void Chip8::write_memory(std::uint16_t address, std::uint8_t value) {
+    address &= 0xFFF;
+    array_hash_ ^= zobrist(memory_slot + address, memory_[address]) ^ zobrist(memory_slot + address, value);
+    memory_[address] = value;
+}
+
+void Chip8::write_stack(std::size_t index, std::uint16_t value) {
+    array_hash_ ^= zobrist(stack_slot + index, stack_[index]) ^ zobrist(stack_slot + index, value);
+    stack_[index] = value;
+}
+
+void Chip8::write_row(std::size_t row, std::uint64_t pixels) {
+    if (gfx_rows_[row] == pixels) return;
+    array_hash_ ^= zobrist(row_slot + row, gfx_rows_[row]) ^ zobrist(row_slot + row, pixels);
+    gfx_rows_[row] = pixels;
+}
+
+void Chip8::rehash() {
+    for (std::size_t row = 0; row < gfx_rows_.size(); row++) gfx_rows_[row] = packed_row(gfx_, row);
+    array_hash_ = state_hash_from_scratch() ^ scalar_hash();
+}
+
+std::uint64_t Chip8::scalar_hash() const {
+    return zobrist(scalar_slot, pc_) ^ zobrist(scalar_slot + 1, I_) ^ zobrist(scalar_slot + 2, sp_)
+           ^ zobrist(scalar_slot + 3, delay_timer()) ^ zobrist(scalar_slot + 4, sound_timer());
+}
+
+std::uint64_t Chip8::state_hash() const {
+    // The scalars change at almost every instruction: cheaper to mix them in here.
+    return array_hash_ ^ scalar_hash();
+}
+
+std::uint64_t Chip8::state_hash_from_scratch() const {
+    auto hash = scalar_hash();
+    for (std::uint32_t i = 0; i < memory_.size(); i++) hash ^= zobrist(memory_slot + i, memory_[i]);
+    for (std::uint32_t i = 0; i < V_.size(); i++) hash ^= zobrist(register_slot + i, V_[i]);
+    for (std::uint32_t i = 0; i < stack_.size(); i++) hash ^= zobrist(stack_slot + i, stack_[i]);
+    for (std::uint32_t row = 0; row < 32; row++) hash ^= zobrist(row_slot + row, packed_row(gfx_, row));
+    return hash;
 }
 
 bool Chip8::draw_flag() const {
@@ -504,7 +853,6 @@ void Chip8::set_draw_flag(bool flag) {
 }
 
 std::string Chip8::print_state() {
-    std::cout << std::hex << pc_ << ": " << decoder_.interpret(opcode_) << '\n';
     std::stringstream ss;
     ss << "I: " << I_ << '\n';
     ss << "Registers:\n";
@@ -512,7 +860,7 @@ std::string Chip8::print_state() {
         ss << i << ": " << std::to_string(V_[i]) << " - ";
 } 
 ss << '\n' << "pc: " << pc_  << " - opcode: " << std::hex << opcode_ << '\t' << decoder_.interpret(opcode_);
-ss << '\n' << "delay timer: " << std::to_string(delay_timer_);
+ss << '\n' << "delay timer: " << std::to_string(delay_timer());
     return ss.str();
 }
 
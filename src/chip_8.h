@@ -11,34 +11,151 @@
 #include <vector>
 #include <random>
 #include "decoder.h"
+#include "rom_library.h"
+#include "rom_profile.h"
+#include "trace.h"
+#ifdef CHIP8_PROFILE
+#include "profiler.h"
+#endif
 
 namespace snooz {
 
+// Hook policy of Chip8::run_cycles that never interrupts. Compiles down to the plain loop.
+struct NoHooks {
+    template <typename Chip>
+    bool before(const Chip&) { return true; }
+};
+
+// What the machine waits for when it spins without doing anything, see Chip8::idle.
+enum class Idle {
+    // Doing actual work.
+    No,
+    // Nothing changes until a key is pressed: FX0A, a jump to itself, or a stopped machine.
+    UntilKey,
+    // Polling the delay timer until it reaches 0, see Chip8::idle_until_tick. Only for ROMs of which the profile
+    // says idle_skip_safe.
+    UntilTick,
+};
+
 /// https://en.wikipedia.org/wiki/CHIP-8#Virtual_machine_description
 class Chip8 {
 public:
+    // Everything needed to put the machine back in a previous state. Plain data, can be copied around freely.
+    struct Snapshot {
+        std::array<std::uint8_t, 4096> memory;
+        std::array<std::uint8_t, 16> V;
+        std::uint16_t I;
+        std::uint16_t pc;
+        std::uint16_t opcode;
+        std::array<std::uint16_t, 16> stack;
+        std::uint16_t sp;
+        std::array<std::uint8_t, 64*32> gfx;
+        std::uint8_t delay_timer;
+        std::uint8_t sound_timer;
+        std::array<bool, 16> key;
+        bool wait_for_key;
+        bool key_pressed;
+        std::uint8_t key_pressed_idx;
+        bool draw_flag;
+        std::uint64_t cycles;
+        // Phase of the 60Hz timer clock, see tick_at: the timers above are at the tick of instruction `cycles`.
+        std::uint64_t tick_base;
+        std::uint64_t tick_cycle;
+    };
+
     Chip8();
 
+    // Back to the state of a new Chip8, without building it again: same random engine, same dispatch maps.
+    // The ROM has to be loaded again.
+    void reset();
+
+    // Throw RomError if the ROM cannot be read or does not fit. See resolve_rom for the source format.
     void load_game(std::string source);
     void load_from_buffer(const std::vector<uint8_t>& buff);
+    // Copy the ROM at 0x200. The rest of the program memory is cleared.
+    // The profile of the ROM (see rom_profile.h) is applied, or the default one if the ROM is unknown.
+    void load_rom(RomSpan rom);
+
+    // Quirks, speed and engine. Can be overridden after loading a ROM.
+    void apply_profile(const RomProfile& profile);
+    const RomProfile& profile() const { return profile_; }
+    void set_quirks(const Quirks& quirks) { profile_.quirks = quirks; }
+    void set_engine(Engine engine) { profile_.engine = engine; }
+    std::uint32_t instructions_per_frame() const { return profile_.instructions_per_frame; }
+    // Also the speed of the timers: they tick once every that many instructions.
+    void set_instructions_per_frame(std::uint32_t count);
 
     void emulateCycle();
 
+    // Run up to count instructions. hooks.before(*this) is called before each one and stops the run by returning
+    // false (see Debugger). Return the number of instructions executed.
+    template <typename Hooks>
+    std::uint64_t run_cycles(std::uint64_t count, Hooks& hooks) {
+        std::uint64_t executed = 0;
+        while (executed < count && should_continue_ && hooks.before(*this)) {
+            emulateCycle();
+            executed++;
+        }
+        return executed;
+    }
+
     bool should_continue() const;
 
-    const std::array<std::uint8_t, 64*32> gfx() const { return gfx_;}
+    const std::array<std::uint8_t, 64*32>& gfx() const { return gfx_;}
+    const std::array<std::uint8_t, 4096>& memory() const { return memory_; }
+
+    Snapshot snapshot() const;
+    void restore(const Snapshot& snapshot);
+
+    // Hash of memory, registers, stack, timers and screen, kept up to date by the instructions as they write, so
+    // it costs a few XOR per instruction instead of hashing 6K of state. Keys and the FX0A wait are not part of it.
+    std::uint64_t state_hash() const;
+    // Same value, computed from the whole state. For tests.
+    std::uint64_t state_hash_from_scratch() const;
+
+    // Make CXNN deterministic, for reproducible runs.
+    void seed(std::uint32_t value) { e1.seed(value); }
 
     bool draw_flag() const;
     void set_draw_flag(bool draw_flag);
 
     std::string print_state();
     std::uint8_t register_value(size_t index) const;
+    std::uint16_t pc() const { return pc_; }
+    std::uint16_t opcode() const { return opcode_; }
+    std::uint16_t index() const { return I_; }
+    // Number of instructions executed so far.
+    std::uint64_t cycles() const { return cycles_; }
 
     // Keyboard control. Either press or release. Press will put to 1, release to 0.
     void set_key_pressed(const size_t& key_index);
     void set_key_released(const size_t& key_index);
-    // timers are decreased in the main loop
+    // The timers tick at 60Hz of emulated time: once every instructions_per_frame() instructions. Frontends do not
+    // need to do anything. This is one more tick on top of those, for tests and frontends that keep their own time.
     void decrease_timers();
+    std::uint8_t delay_timer() const { return timer_at(delay_timer_, timer_tick()); }
+    std::uint8_t sound_timer() const { return timer_at(sound_timer_, timer_tick()); }
+    // The buzzer sounds as long as the sound timer is not 0. This is its state during the last instruction, so that
+    // a frontend checking it after a frame hears a sound timer set to 1 in that frame.
+    bool sound_active() const;
+    // Timer ticks so far, in emulated time.
+    std::uint64_t timer_tick() const { return tick_at(cycles_); }
+
+    // Lets a frontend sleep instead of running instructions that do nothing.
+    Idle idle() const;
+    // When idle() is UntilTick, the tick at which the delay timer reaches 0 and the loop ends.
+    std::uint64_t idle_until_tick() const { return timer_tick_ + delay_timer_; }
+    // Same state as running up to count instructions of the idle loop one by one, without running them.
+    // Stop at the end of the wait. Return the number of instructions skipped, 0 when not idle.
+    std::uint64_t skip_idle(std::uint64_t count);
+
+#if CHIP8_TRACE_LEVEL > CHIP8_TRACE_OFF
+    const Trace& trace() const { return trace_; }
+#endif
+
+#ifdef CHIP8_PROFILE
+    Profiler& profiler() { return profiler_; }
+#endif
 
 protected:
 
@@ -64,6 +181,11 @@ protected:
     void next_opcode();
     bool should_continue_{true};
 
+    using Handler = void (Chip8::*)();
+    // Handlers for Engine::FlatTable. See flat_index.
+    static const std::array<Handler, 4096>& flat_table();
+    static std::uint16_t flat_index(std::uint16_t opcode) { return ((opcode & 0xF000) >> 4) | (opcode & 0x00FF); }
+
     // Look at the first byte of the opcode and dispatch the correct function.
     std::unordered_map<uint16_t, std::function<void ()>> opcode_dispath_;
 
@@ -195,6 +317,33 @@ protected:
     // FX65     MEM     reg_load(Vx,&I)     Fills V0 to VX (including VX) with values from memory starting at address I. The offset from I is increased by 1 for each value written, but I itself is left unmodified.
     void op_FX65();
 
+    // Opcodes that are not part of the instruction set.
+    void op_unknown();
+
+    // The timers are stored as their value at timer_tick_ and only brought up to date when an instruction reads
+    // or writes them, so that they cost nothing to the other instructions.
+    void update_timers();
+    static std::uint8_t timer_at(std::uint8_t value, std::uint64_t elapsed_from, std::uint64_t tick);
+    std::uint8_t timer_at(std::uint8_t value, std::uint64_t tick) const { return timer_at(value, timer_tick_, tick); }
+    // Start counting ticks again from the current instruction, keeping the current tick.
+    void rebase_timer_clock();
+    std::uint64_t tick_at(std::uint64_t cycle) const {
+        return tick_base_ + (cycle - tick_cycle_) / instructions_per_frame();
+    }
+    // Address of the `FX07; 3X00; 1NNN` loop polling the delay timer that pc is in, or -1.
+    int delay_loop() const;
+
+    // Every write to memory, V, the stack and the screen goes through these so that array_hash_ stays right.
+    void write_register(std::size_t x, std::uint8_t value);
+    void write_memory(std::uint16_t address, std::uint8_t value);
+    void write_stack(std::size_t index, std::uint16_t value);
+    void write_row(std::size_t row, std::uint64_t pixels);
+    // Rebuild gfx_rows_ and array_hash_ after the state was replaced wholesale.
+    void rehash();
+    // Zobrist key of a value at a given slot of the state. See state_hash.
+    static std::uint64_t zobrist(std::uint32_t slot, std::uint64_t value);
+    std::uint64_t scalar_hash() const;
+
     // helper to do bitwise op.
     std::uint8_t get_0X00(std::uint16_t opcode) const;
     std::uint8_t get_00Y0(std::uint16_t opcode) const;
@@ -211,7 +360,7 @@ protected:
     std::uniform_int_distribution<int> uniform_dist{0, 0xFF};
 
     // 2bytes opcode
-    std::uint16_t opcode_;
+    std::uint16_t opcode_{0};
 
     // 4096 bytes memory
     // Layout is the following: 0x000 -> 0x200 interpreter. 0x200 -> 0xfff the program
@@ -228,18 +377,39 @@ protected:
     std::array<std::uint8_t, 64*32> gfx_;
 
     // Interupts and hardware registers. The Chip 8 has none, but there are two timer registers that count at 60 Hz. When set above zero they will count down to zero.
+    // Values at timer_tick_, see update_timers.
     std::uint8_t delay_timer_{0};
     std::uint8_t sound_timer_{0};
+    std::uint64_t timer_tick_{0};
+    // The clock of the timers: tick_base_ ticks at instruction tick_cycle_, then one every instructions_per_frame().
+    std::uint64_t tick_base_{0};
+    std::uint64_t tick_cycle_{0};
 
     // when calling subroutines.
     std::array<std::uint16_t, 16> stack_;
     std::uint16_t sp_{0};
 
     // Hex-based keypad.
-    std::array<bool, 0xF> key_;
+    std::array<bool, 16> key_;
 
     bool draw_flag_{false};
-    
+
+    std::uint64_t cycles_{0};
+
+    // Screen rows as 64 bits masks, pixel x at bit x, and the XOR of the zobrist keys of memory, V, stack and rows.
+    std::array<std::uint64_t, 32> gfx_rows_;
+    std::uint64_t array_hash_{0};
+
+    RomProfile profile_{default_profile()};
+
+#if CHIP8_TRACE_LEVEL > CHIP8_TRACE_OFF
+    Trace trace_;
+#endif
+
+#ifdef CHIP8_PROFILE
+    Profiler profiler_;
+#endif
+
     Decoder decoder_;
 };
 }
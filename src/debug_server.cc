@@ -0,0 +1,375 @@
+#include "debug_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace snooz {
+
+namespace {
+
+const char hex_digits[] = "0123456789abcdef";
+
+void append_hex(std::string& out, std::uint8_t byte) {
+    out += hex_digits[byte >> 4];
+    out += hex_digits[byte & 0xF];
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Read a hex number at pos and move past it. -1 if there is none.
+long parse_number(const std::string& text, std::size_t& pos) {
+    long value = 0;
+    auto start = pos;
+    while (pos < text.size() && hex_value(text[pos]) >= 0 && pos - start < 8) {
+        value = value * 16 + hex_value(text[pos]);
+        pos++;
+    }
+    return pos == start ? -1 : value;
+}
+
+bool parse_bytes(const std::string& text, std::size_t pos, std::uint8_t* out, std::size_t count) {
+    if (text.size() - pos != count * 2) return false;
+    for (std::size_t i = 0; i < count; i++) {
+        auto high = hex_value(text[pos + 2 * i]);
+        auto low = hex_value(text[pos + 2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        out[i] = static_cast<std::uint8_t>(high * 16 + low);
+    }
+    return true;
+}
+
+void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+constexpr std::size_t register_bytes = 23;
+
+// Received bytes kept while waiting for packets to end: a few times the longest useful packet, M over the whole
+// memory (about 8K). A client sending more is dropped.
+constexpr std::size_t max_pending_input = 32 * 1024;
+// Answers kept while the client does not read them: a few reads of the whole memory. A client that stops reading
+// and keeps asking is dropped.
+constexpr std::size_t max_pending_output = 64 * 1024;
+
+const std::string error = "E01";
+
+// m<addr>,<len>[;<addr>,<len>...]
+std::string read_memory(const std::string& packet, const Chip8& chip8) {
+    auto& memory = chip8.memory();
+    std::string answer;
+    std::size_t pos = 1;
+    while (true) {
+        auto address = parse_number(packet, pos);
+        if (address < 0 || pos >= packet.size() || packet[pos] != ',') return error;
+        pos++;
+        auto length = parse_number(packet, pos);
+        if (length < 0 || address + length > static_cast<long>(memory.size())) return error;
+        for (long i = 0; i < length; i++) append_hex(answer, memory[address + i]);
+        if (pos >= packet.size()) return answer;
+        if (packet[pos] != ';') return error;
+        answer += ';';
+        pos++;
+    }
+}
+
+// M<addr>,<len>:<hex>
+std::string write_memory(const std::string& packet, Chip8& chip8) {
+    std::size_t pos = 1;
+    auto address = parse_number(packet, pos);
+    if (address < 0 || pos >= packet.size() || packet[pos] != ',') return error;
+    pos++;
+    auto length = parse_number(packet, pos);
+    if (length < 0 || pos >= packet.size() || packet[pos] != ':' || address + length > 4096) return error;
+
+    auto snapshot = chip8.snapshot();
+    if (!parse_bytes(packet, pos + 1, snapshot.memory.data() + address, length)) return error;
+    chip8.restore(snapshot);
+    return "OK";
+}
+
+// Z<type>,<addr>[,<len>] and z<type>,<addr>[,<len>]
+std::string change_point(const std::string& packet, Debugger& debugger) {
+    std::size_t pos = 1;
+    auto type = parse_number(packet, pos);
+    if (pos >= packet.size() || packet[pos] != ',') return error;
+    pos++;
+    auto address = parse_number(packet, pos);
+    long length = 1;
+    if (pos < packet.size() && packet[pos] == ',') {
+        pos++;
+        length = parse_number(packet, pos);
+    }
+    if (address < 0 || length < 0) return error;
+
+    auto insert = packet[0] == 'Z';
+    if (type == 0 || type == 1) {
+        if (insert) {
+            debugger.add_breakpoint(address);
+        } else {
+            debugger.remove_breakpoint(address);
+        }
+        return "OK";
+    }
+    if (type >= 2 && type <= 4) {
+        auto access = type == 2 ? WatchWrite : type == 3 ? WatchRead : WatchReadWrite;
+        if (insert) {
+            debugger.add_watchpoint(address, length, access);
+        } else {
+            debugger.remove_watchpoint(address, length, access);
+        }
+        return "OK";
+    }
+    // Not supported.
+    return "";
+}
+
+}
+
+DebugServer::DebugServer(const std::string& path): path_(path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+    std::strcpy(address.sun_path, path.c_str());
+
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0) throw std::runtime_error(std::string("Cannot create socket: ") + std::strerror(errno));
+    unlink(path.c_str());
+    if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener_, 1) != 0) {
+        auto message = std::string("Cannot listen on ") + path + ": " + std::strerror(errno);
+        close(listener_);
+        throw std::runtime_error(message);
+    }
+    set_nonblocking(listener_);
+}
+
+DebugServer::DebugServer(int client): client_(client), attached_(true) {
+    set_nonblocking(client_);
+}
+
+DebugServer::~DebugServer() {
+    disconnect();
+    if (listener_ >= 0) {
+        close(listener_);
+        unlink(path_.c_str());
+    }
+}
+
+bool DebugServer::poll(Chip8& chip8, Debugger& debugger, bool paused) {
+    if (client_ < 0) {
+        if (listener_ < 0) return paused;
+        client_ = accept(listener_, nullptr, nullptr);
+        if (client_ < 0) return paused;
+        set_nonblocking(client_);
+        attached_ = true;
+    }
+    if (attached_) {
+        // A debugger attaching finds the core stopped.
+        attached_ = false;
+        paused = true;
+        running_ = false;
+    }
+
+    char buffer[4096];
+    while (true) {
+        auto received = recv(client_, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            in_.append(buffer, received);
+            if (in_.size() <= max_pending_input) continue;
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        // Gone, or flooding without ending a packet. Do not leave the core stuck on a breakpoint nobody sees.
+        disconnect();
+        debugger.clear();
+        return false;
+    }
+
+    std::size_t pos = 0;
+    while (pos < in_.size()) {
+        if (in_[pos] == 0x03) {
+            paused = true;
+            if (running_) {
+                running_ = false;
+                send_packet("S05");
+            }
+            pos++;
+            continue;
+        }
+        if (in_[pos] != '$') {
+            // Acks from the client, or noise.
+            pos++;
+            continue;
+        }
+        auto end = in_.find('#', pos);
+        if (end == std::string::npos || end + 2 >= in_.size()) break;
+
+        auto payload = in_.substr(pos + 1, end - pos - 1);
+        std::uint8_t checksum = 0;
+        for (auto c: payload) checksum += static_cast<std::uint8_t>(c);
+        auto expected = hex_value(in_[end + 1]) * 16 + hex_value(in_[end + 2]);
+        pos = end + 3;
+
+        if (expected != checksum) {
+            out_ += '-';
+            continue;
+        }
+        out_ += '+';
+        if (!handle(payload, chip8, debugger, paused)) {
+            flush();
+            disconnect();
+            return false;
+        }
+        if (out_.size() > max_pending_output) {
+            flush();
+            if (out_.size() > max_pending_output) {
+                disconnect();
+                debugger.clear();
+                return false;
+            }
+        }
+    }
+    in_.erase(0, pos);
+
+    flush();
+    return paused;
+}
+
+void DebugServer::stopped(StopReason reason) {
+    if (!running_) return;
+    running_ = false;
+    send_packet(reason == StopReason::Halted ? "W00" : "S05");
+    flush();
+}
+
+bool DebugServer::handle(const std::string& packet, Chip8& chip8, Debugger& debugger, bool& paused) {
+    if (packet.empty()) {
+        send_packet("");
+        return true;
+    }
+
+    std::string answer;
+    switch (packet[0]) {
+    case '?':
+        answer = chip8.should_continue() ? "S05" : "W00";
+        break;
+    case 'g': {
+        answer.reserve(register_bytes * 2);
+        for (std::size_t i = 0; i < 16; i++) append_hex(answer, chip8.register_value(i));
+        auto snapshot = chip8.snapshot();
+        append_hex(answer, snapshot.I >> 8);
+        append_hex(answer, snapshot.I & 0xFF);
+        append_hex(answer, snapshot.pc >> 8);
+        append_hex(answer, snapshot.pc & 0xFF);
+        append_hex(answer, static_cast<std::uint8_t>(snapshot.sp));
+        append_hex(answer, snapshot.delay_timer);
+        append_hex(answer, snapshot.sound_timer);
+        break;
+    }
+    case 'G': {
+        std::uint8_t bytes[register_bytes];
+        // sp goes up to 16, with the stack full.
+        if (!parse_bytes(packet, 1, bytes, register_bytes) || bytes[20] > 16) {
+            answer = error;
+            break;
+        }
+        auto snapshot = chip8.snapshot();
+        std::copy(bytes, bytes + 16, snapshot.V.begin());
+        snapshot.I = (bytes[16] << 8) | bytes[17];
+        snapshot.pc = ((bytes[18] << 8) | bytes[19]) & 0xFFF;
+        snapshot.sp = bytes[20];
+        snapshot.delay_timer = bytes[21];
+        snapshot.sound_timer = bytes[22];
+        chip8.restore(snapshot);
+        answer = "OK";
+        break;
+    }
+    case 'm':
+        answer = read_memory(packet, chip8);
+        break;
+    case 'M':
+        answer = write_memory(packet, chip8);
+        break;
+    case 'Z':
+    case 'z':
+        answer = change_point(packet, debugger);
+        break;
+    case 's':
+        debugger.step(chip8);
+        paused = true;
+        answer = chip8.should_continue() ? "S05" : "W00";
+        break;
+    case 'c':
+        // Answered by stopped() or an interrupt.
+        debugger.resume();
+        paused = false;
+        running_ = true;
+        return true;
+    case 'F': {
+        auto& gfx = chip8.gfx();
+        answer.reserve(gfx.size() / 4);
+        for (std::size_t i = 0; i < gfx.size(); i += 8) {
+            std::uint8_t byte = 0;
+            for (std::size_t bit = 0; bit < 8; bit++) {
+                if (gfx[i + bit]) byte |= 0x80 >> bit;
+            }
+            append_hex(answer, byte);
+        }
+        break;
+    }
+    case 'D':
+        debugger.clear();
+        paused = false;
+        send_packet("OK");
+        return false;
+    default:
+        break;
+    }
+    send_packet(answer);
+    return true;
+}
+
+void DebugServer::send_packet(const std::string& payload) {
+    std::uint8_t checksum = 0;
+    for (auto c: payload) checksum += static_cast<std::uint8_t>(c);
+    out_.reserve(out_.size() + payload.size() + 4);
+    out_ += '$';
+    out_ += payload;
+    out_ += '#';
+    append_hex(out_, checksum);
+}
+
+void DebugServer::flush() {
+    if (client_ < 0) {
+        out_.clear();
+        return;
+    }
+    while (!out_.empty()) {
+        auto sent = send(client_, out_.data(), out_.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) break;
+        out_.erase(0, sent);
+    }
+}
+
+void DebugServer::disconnect() {
+    if (client_ >= 0) close(client_);
+    client_ = -1;
+    running_ = false;
+    in_.clear();
+    out_.clear();
+}
+
+}
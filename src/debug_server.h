@@ -0,0 +1,63 @@
+// Remote debugging over a Unix domain socket, with packets in the GDB remote serial protocol framing:
+// `$<payload>#<checksum>`. Each packet is acknowledged with `+` (or `-` on a bad checksum) and answered with
+// one packet. The emulator thread polls the server once per frame and it never blocks.
+//
+// Commands:
+//   ?                       why the core is stopped: S05, or W00 once the chip halted
+//   g                       registers, hex: V0..VF, I (2 bytes), PC (2 bytes), SP, DT, ST. 23 bytes.
+//   G<hex>                  write the registers, same layout
+//   m<addr>,<len>[;...]     read memory. Several ranges in one packet, answers separated by ';'
+//   M<addr>,<len>:<hex>     write memory
+//   Z0,<addr> / z0,<addr>   set / remove a breakpoint
+//   Z2|Z3|Z4,<addr>,<len>   set a write / read / access watchpoint, z2|z3|z4 to remove
+//   s                       step one instruction, answered with S05
+//   c                       continue. S05 is sent when the debugger breaks
+//   F                       framebuffer, 256 bytes: one bit per pixel, rows of 64 pixels, MSB first
+//   0x03 (outside a packet) interrupt. Answered with S05
+//   D                       detach. Breakpoints are removed and the core resumes
+// Numbers are in hex. Unknown commands get an empty answer, errors `E01`.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "chip_8.h"
+#include "debugger.h"
+
+namespace snooz {
+
+class DebugServer {
+public:
+    // Listen on `path`, removing a stale socket file. Throw std::runtime_error.
+    explicit DebugServer(const std::string& path);
+    // Serve a socket already connected, e.g. one end of a socketpair, instead of listening. Takes ownership of it.
+    explicit DebugServer(int client);
+    ~DebugServer();
+    DebugServer(const DebugServer&) = delete;
+    DebugServer& operator=(const DebugServer&) = delete;
+
+    // Core thread. Accept a client, run the commands received so far and send the answers that fit in the
+    // socket. Return whether the core should be paused from now on.
+    bool poll(Chip8& chip8, Debugger& debugger, bool paused);
+
+    // Core thread. The debugger stopped the core by itself.
+    void stopped(StopReason reason);
+
+private:
+    bool handle(const std::string& packet, Chip8& chip8, Debugger& debugger, bool& paused);
+    void send_packet(const std::string& payload);
+    void flush();
+    void disconnect();
+
+    std::string path_;
+    int listener_{-1};
+    int client_{-1};
+    // The client connected since the last poll: it finds the core stopped.
+    bool attached_{false};
+    std::string in_;
+    std::string out_;
+    // The client sent `c` and waits for the stop reply.
+    bool running_{false};
+};
+
+}
@@ -0,0 +1,143 @@
+#include "debugger.h"
+
+namespace snooz {
+
+bool Condition::holds(const Chip8& chip8) const {
+    auto v = chip8.register_value(reg & 0xF);
+    switch (compare) {
+    case Equal:
+        return v == value;
+    case NotEqual:
+        return v != value;
+    case Less:
+        return v < value;
+    case Greater:
+        return v > value;
+    }
+    return false;
+}
+
+void Debugger::add_breakpoint(std::uint16_t pc) {
+    breakpoints_.set(pc & 0xFFF);
+    update_armed();
+}
+
+void Debugger::remove_breakpoint(std::uint16_t pc) {
+    breakpoints_.reset(pc & 0xFFF);
+    update_armed();
+}
+
+void Debugger::add_watchpoint(std::uint16_t address, std::uint16_t length, WatchAccess access) {
+    for (std::uint32_t i = 0; i < length; i++) {
+        if (access & WatchRead) watch_read_.set((address + i) & 0xFFF);
+        if (access & WatchWrite) watch_write_.set((address + i) & 0xFFF);
+    }
+    update_armed();
+}
+
+void Debugger::remove_watchpoint(std::uint16_t address, std::uint16_t length, WatchAccess access) {
+    for (std::uint32_t i = 0; i < length; i++) {
+        if (access & WatchRead) watch_read_.reset((address + i) & 0xFFF);
+        if (access & WatchWrite) watch_write_.reset((address + i) & 0xFFF);
+    }
+    update_armed();
+}
+
+void Debugger::add_condition(const Condition& condition) {
+    conditions_.push_back(condition);
+    condition_state_.push_back(false);
+    update_armed();
+}
+
+void Debugger::clear_conditions() {
+    conditions_.clear();
+    condition_state_.clear();
+    update_armed();
+}
+
+void Debugger::clear() {
+    breakpoints_.reset();
+    watch_read_.reset();
+    watch_write_.reset();
+    clear_conditions();
+}
+
+StopReason Debugger::run(Chip8& chip8, std::uint64_t max_cycles) {
+    // Resuming from a break: the instruction it stopped on has to run.
+    skip_next_ = resuming_ || (stop_reason_ != StopReason::None && chip8.pc() == stop_pc_);
+    resuming_ = false;
+    stop_reason_ = StopReason::None;
+    chip8.run_cycles(max_cycles, *this);
+    skip_next_ = false;
+    if (stop_reason_ == StopReason::None && !chip8.should_continue()) {
+        stop(chip8, StopReason::Halted);
+    }
+    return stop_reason_;
+}
+
+StopReason Debugger::step(Chip8& chip8) {
+    chip8.emulateCycle();
+    // A condition that became true on this step is not reported by the next run.
+    update_conditions(chip8);
+    stop(chip8, chip8.should_continue() ? StopReason::Step : StopReason::Halted);
+    return stop_reason_;
+}
+
+bool Debugger::update_conditions(const Chip8& chip8) {
+    bool edge = false;
+    for (std::size_t i = 0; i < conditions_.size(); i++) {
+        auto holds = conditions_[i].holds(chip8);
+        edge |= holds && !condition_state_[i];
+        condition_state_[i] = holds;
+    }
+    return edge;
+}
+
+bool Debugger::check(const Chip8& chip8) {
+    // Every condition sees every instruction, even when something else stops on it: a condition that became true
+    // at a breakpoint does not stop the next run again.
+    auto condition_edge = update_conditions(chip8);
+
+    auto pc = chip8.pc() & 0xFFF;
+    if (breakpoints_.test(pc)) return stop(chip8, StopReason::Breakpoint);
+
+    if (watch_read_.any() || watch_write_.any()) {
+        // The addresses an instruction touches are known from its opcode and I.
+        auto& memory = chip8.memory();
+        std::uint16_t opcode = (memory[pc] << 8) | memory[(pc + 1) & 0xFFF];
+        std::uint16_t x = (opcode & 0x0F00) >> 8;
+        const std::bitset<4096>* watched = nullptr;
+        std::uint16_t length = 0;
+        if ((opcode & 0xF000) == 0xD000) {
+            watched = &watch_read_;
+            length = opcode & 0x000F;
+        } else if ((opcode & 0xF0FF) == 0xF065) {
+            watched = &watch_read_;
+            length = x + 1;
+        } else if ((opcode & 0xF0FF) == 0xF055) {
+            watched = &watch_write_;
+            length = x + 1;
+        } else if ((opcode & 0xF0FF) == 0xF033) {
+            watched = &watch_write_;
+            length = 3;
+        }
+        for (std::uint16_t i = 0; i < length; i++) {
+            if (watched->test((chip8.index() + i) & 0xFFF)) return stop(chip8, StopReason::Watchpoint);
+        }
+    }
+
+    if (condition_edge) return stop(chip8, StopReason::Condition);
+    return true;
+}
+
+bool Debugger::stop(const Chip8& chip8, StopReason reason) {
+    stop_reason_ = reason;
+    stop_pc_ = chip8.pc();
+    return false;
+}
+
+void Debugger::update_armed() {
+    armed_ = breakpoints_.any() || watch_read_.any() || watch_write_.any() || !conditions_.empty();
+}
+
+}
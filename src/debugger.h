@@ -0,0 +1,102 @@
+// Breakpoints, watchpoints and conditional breaks. The Debugger is a hook policy for Chip8::run_cycles: it looks
+// at the next instruction before it runs, so the opcode handlers and emulateCycle know nothing about it.
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "chip_8.h"
+
+namespace snooz {
+
+enum class StopReason {
+    // Ran the number of instructions asked.
+    None,
+    Breakpoint,
+    Watchpoint,
+    Condition,
+    Step,
+    // The chip stopped by itself.
+    Halted,
+};
+
+enum WatchAccess : std::uint8_t {
+    WatchRead = 1,
+    WatchWrite = 2,
+    WatchReadWrite = WatchRead | WatchWrite,
+};
+
+// Break when V[reg] <compare> value becomes true.
+struct Condition {
+    enum Compare : std::uint8_t { Equal, NotEqual, Less, Greater };
+
+    std::uint8_t reg;
+    Compare compare;
+    std::uint8_t value;
+
+    bool holds(const Chip8& chip8) const;
+};
+
+class Debugger {
+public:
+    void add_breakpoint(std::uint16_t pc);
+    void remove_breakpoint(std::uint16_t pc);
+    bool has_breakpoint(std::uint16_t pc) const { return breakpoints_.test(pc & 0xFFF); }
+
+    // Every address in [address, address + length) is watched.
+    void add_watchpoint(std::uint16_t address, std::uint16_t length, WatchAccess access);
+    void remove_watchpoint(std::uint16_t address, std::uint16_t length, WatchAccess access);
+
+    void add_condition(const Condition& condition);
+    void clear_conditions();
+
+    void clear();
+
+    // Run until something breaks or max_cycles instructions ran. Whatever stopped the previous run does not
+    // stop this one again on the first instruction.
+    StopReason run(Chip8& chip8, std::uint64_t max_cycles);
+    // The next run executes the instruction at pc even if it has a breakpoint, like after a break.
+    void resume() { resuming_ = true; }
+    // Exactly one instruction, breakpoints ignored.
+    StopReason step(Chip8& chip8);
+
+    // Anything to check at all. When not, runs can skip over idle loops.
+    bool armed() const { return armed_; }
+
+    StopReason stop_reason() const { return stop_reason_; }
+    // Address of the instruction that would run next when the debugger stopped.
+    std::uint16_t stop_pc() const { return stop_pc_; }
+
+    // Hook policy, see Chip8::run_cycles. False to stop before the instruction at pc.
+    bool before(const Chip8& chip8) {
+        if (!armed_ || skip_next_) {
+            skip_next_ = false;
+            return true;
+        }
+        return check(chip8);
+    }
+
+private:
+    bool check(const Chip8& chip8);
+    // Update condition_state_. Return whether a condition became true.
+    bool update_conditions(const Chip8& chip8);
+    bool stop(const Chip8& chip8, StopReason reason);
+    void update_armed();
+
+    std::bitset<4096> breakpoints_;
+    std::bitset<4096> watch_read_;
+    std::bitset<4096> watch_write_;
+    std::vector<Condition> conditions_;
+    // Value of each condition at the previous instruction, to break on the edge only.
+    std::vector<bool> condition_state_;
+
+    // Anything set at all. When false, before() is a single test.
+    bool armed_{false};
+    bool skip_next_{false};
+    bool resuming_{false};
+    StopReason stop_reason_{StopReason::None};
+    std::uint16_t stop_pc_{0};
+};
+
+}
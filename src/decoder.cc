@@ -4,314 +4,164 @@
 
 #include <iostream>
 #include "decoder.h"
-#include <fstream>
-#include <cassert>
-#include <sstream>
+#include <cstdio>
+#include <iterator>
 
 namespace snooz {
-std::string Decoder::unknown(std::uint16_t opcode) const {
-    //std::hex
-    std::stringstream ss;
-    ss << "Unknown Opcode 0x" << std::hex << opcode;
-    return ss.str();
-}
+
+constexpr std::size_t Decoder::max_line_size;
 
 Decoder::Decoder() {
     memory_.fill(0);
-
-    opcode_dispath_ = {
-            {0x0000, [this](std::uint16_t opcode) { return op_0000(opcode); }},
-            {0x1000, [this](std::uint16_t opcode) { return op_1NNN(opcode); }},
-            {0x2000, [this](std::uint16_t opcode) { return op_2NNN(opcode); }},
-            {0x3000, [this](std::uint16_t opcode) { return op_3XNN(opcode); }},
-            {0x4000, [this](std::uint16_t opcode) { return op_4XNN(opcode); }},
-            {0x5000, [this](std::uint16_t opcode) { return op_5XY0(opcode); }},
-            {0x6000, [this](std::uint16_t opcode) { return op_6XNN(opcode); }},
-            {0x7000, [this](std::uint16_t opcode) { return op_7XNN(opcode); }},
-            {0x8000, [this](std::uint16_t opcode) { return op_8000(opcode); }},
-            {0x9000, [this](std::uint16_t opcode) { return op_9XY0(opcode); }},
-            {0xA000, [this](std::uint16_t opcode) { return op_ANNN(opcode); }},
-            {0xB000, [this](std::uint16_t opcode) { return op_BNNN(opcode); }},
-            {0xC000, [this](std::uint16_t opcode) { return op_CXNN(opcode); }},
-            {0xD000, [this](std::uint16_t opcode) { return op_DXYN(opcode); }},
-            {0xE000, [this](std::uint16_t opcode) { return op_E000(opcode); }},
-            {0xF000, [this](std::uint16_t opcode) { return op_F000(opcode); }},
-
-    };
-
-    arithmetic_dispath_ = {
-            {0x0000, [this](std::uint16_t opcode) {return op_8XY0(opcode);}},
-            {0x0001, [this](std::uint16_t opcode) {return op_8XY1(opcode);}},
-            {0x0002, [this](std::uint16_t opcode) {return op_8XY2(opcode);}},
-            {0x0003, [this](std::uint16_t opcode) {return op_8XY3(opcode);}},
-            {0x0004, [this](std::uint16_t opcode) {return op_8XY4(opcode);}},
-            {0x0005, [this](std::uint16_t opcode) {return op_8XY5(opcode);}},
-            {0x0006, [this](std::uint16_t opcode) {return op_8XY6(opcode);}},
-            {0x0007, [this](std::uint16_t opcode) {return op_8XY7(opcode);}},
-            {0x000E, [this](std::uint16_t opcode) {return op_8XYE(opcode);}},
-    };
 }
 
 void Decoder::load_game(std::string source) {
-    std::ifstream input(source, std::ios::binary);
-    assert(input.is_open());
-    std::vector<std::uint8_t> v((std::istreambuf_iterator<char>(input)),
-                                std::istreambuf_iterator<char>());
-    assert(v.size() < memory_.size() - 512);
-
-    for (size_t i = 0; i < v.size(); i++) {
-        memory_[i + 512] = v[i];
-    }
-
-    length_ = v.size();
+    RomLibrary library;
+    load_rom(resolve_rom(source, library));
 }
 
-void Decoder::decode() {
-    while (pc_ - 0x200 < length_) {
-        next_opcode();
-        std::cout << interpret(opcode_) << std::endl;
-        pc_ += 2;
-    }
+void Decoder::load_from_buffer(const std::vector<std::uint8_t>& buff) {
+    load_rom(RomSpan{buff.data(), buff.size()});
 }
 
-std::string Decoder::interpret(std::uint16_t opcode) {
-        if (opcode_dispath_.find(opcode & 0xF000) != opcode_dispath_.end()) {
-            return opcode_dispath_[opcode & 0xF000](opcode);
-        } else {
-            return unknown(opcode);
-        }
-}
-
-void Decoder::next_opcode() {
-    opcode_ = (memory_[pc_] << 8) | memory_[pc_ + 1];
-}
-
-std::string Decoder::op_0000(std::uint16_t opcode) const {
-
-    if ((opcode & 0x000F) == 0) {
-        return op_00E0(opcode);
-    } else {
-        return op_00EE(opcode);
+void Decoder::load_rom(RomSpan rom) {
+    if (rom.size > memory_.size() - 512) {
+        throw RomError("ROM of " + std::to_string(rom.size) + " bytes does not fit in memory");
     }
-
+    std::fill(memory_.begin() + 512, memory_.end(), 0);
+    std::copy(rom.begin(), rom.end(), memory_.begin() + 512);
+    length_ = rom.size;
 }
 
-
-std::string Decoder::op_00E0(std::uint16_t opcode) const {
-    return print_with_desc(opcode, "Clears the screen");
-}
-
-std::string Decoder::op_00EE(std::uint16_t opcode) const {
-    return print_with_desc(opcode, "Return from subroutine");
-}
-
-std::string Decoder::op_1NNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Jump to address 0x" << std::hex << (opcode & 0x0FFF);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_2NNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Call subroutine at 0x" << std::hex << (opcode & 0x0FFF);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_3XNN(std::uint16_t opcode) const {
-    // Skips the next instruction if VX equals NN
-    std::stringstream ss;
-    ss << "Skips next instruction if V" << ((opcode & 0x0F00) >> 8) << " equals " << (opcode & 0x00FF);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_4XNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Skips next instruction if V" << ((opcode & 0x0F00) >> 8) << " not equal to " << (opcode & 0x00FF);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_5XY0(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Skips next instruction if V" << ((opcode & 0x0F00) >> 8) << " equals V" << ((opcode & 0x00F0) >> 4);
-    return print_with_desc(opcode, ss.str());
+void Decoder::decode() {
+    // Build the whole listing first, then a single write.
+    std::string listing;
+    listing.reserve((length_ / 2 + 1) * max_line_size);
+    disassemble(std::back_inserter(listing));
+    std::cout.write(listing.data(), listing.size());
+    std::cout.flush();
 }
 
-std::string Decoder::print_with_desc(std::uint16_t opcode, const std::string &msg) const {
-    std::stringstream ss;
-    ss << std::hex << pc_ << "\t[0x" << opcode << "]"<< "\t" << msg; 
-    return ss.str();
+std::string Decoder::interpret(std::uint16_t opcode) const {
+    return interpret(opcode, pc_);
 }
 
-std::string Decoder::op_6XNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Set V" << ((opcode & 0x0F00) >> 8) << " to" << (opcode & 0x00FF);
-    return print_with_desc(opcode, ss.str());
+std::string Decoder::interpret(std::uint16_t opcode, std::uint16_t pc) const {
+    char line[max_line_size];
+    auto length = format(opcode, pc, line, sizeof(line));
+    return std::string(line, length);
 }
 
-std::string Decoder::op_7XNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Add " <<  (opcode & 0x00FF) << " to V" << ((opcode & 0x0F00) >> 8);
-    return print_with_desc(opcode, ss.str());
-}
+std::size_t Decoder::format(std::uint16_t opcode, std::uint16_t pc, char* buffer, std::size_t size) const {
+    if (size == 0) return 0;
 
-std::string Decoder::op_8000(std::uint16_t opcode){
-    if (arithmetic_dispath_.find(opcode & 0x000F) != arithmetic_dispath_.end()) {
-        return arithmetic_dispath_[opcode & 0x000F](opcode);
-    } else {
-        return unknown(opcode);
+    int written = std::snprintf(buffer, size, "%x\t[0x%x]\t", pc, opcode);
+    if (written < 0) {
+        buffer[0] = '\0';
+        return 0;
     }
-}
-
-std::string Decoder::op_8XY0(std::uint16_t opcode) const {
-    //Vx=Vy
-    std::stringstream ss;
-    ss << "Assign: V" << ((opcode & 0x0F00) >> 8) << " = V" << ((opcode & 0x00F0) >> 4);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY1(std::uint16_t opcode) const {
-    // Sets VX to VX or VY. (Bitwise OR operation)
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Sets V" << x << " to V" << x << " or V" << y << ". (Bitwise OR operation)";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY2(std::uint16_t opcode) const {
-    // Sets VX to VX and VY. (Bitwise AND operation)
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Sets V" << x << " to V" << x << " and V" << y << ". (Bitwise AND operation)";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY3(std::uint16_t opcode) const {
-    // Sets VX to VX xor VY.
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Sets V" << x << " to V" << x << " xor V" << y << ". (Bitwise XOR operation)";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY4(std::uint16_t opcode) const {
-    // Adds VY to VX. VF is set to 1 when there's a carry, and to 0 when there isn't.
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Adds V" << y << " to V" << x;
-    return print_with_desc(opcode, ss.str());
-}
+    std::size_t prefix = std::min(static_cast<std::size_t>(written), size - 1);
 
-std::string Decoder::op_8XY5(std::uint16_t opcode) const {
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "V" << y << " is substracted from V" << x;
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY6(std::uint16_t opcode) const {
-    // Stores the least significant bit of VX in VF and then shifts VX to the right by 1.[2]
-    auto x = (opcode & 0x0F00) >> 8;
-    std::stringstream ss;
-    ss << "Store the least significant bit of V" << x << " in VF and then shifts VX to the right by 1.";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XY7(std::uint16_t opcode) const {
-    // Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't.
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Sets V" << x << " to V" << y << " minus V" << x;
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_8XYE(std::uint16_t opcode) const {
-    // Stores the most significant bit of VX in VF and then shifts VX to the left by 1.[3]
-    auto x = (opcode & 0x0F00) >> 8;
-    std::stringstream ss;
-    ss << "Store the most significant bit of V" << x << " in VF and then shifts VX to the left by 1.";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_9XY0(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Skips next instruction if V" << ((opcode & 0x0F00) >> 8) << " not equal to V" << ((opcode & 0x00F0) >> 4);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_ANNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Set I to " << (opcode & 0x0FFF);
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_BNNN(std::uint16_t opcode) const {
-    std::stringstream ss;
-    ss << "Jump to the address " << (opcode & 0x0FFF) << " + V0";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_CXNN(std::uint16_t opcode) const {
-    // Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
-    auto x = (opcode & 0x0F00) >> 8;
-    auto N = (opcode & 0x00FF);
-    std::stringstream ss;
-    ss << "Sets V" << x << " to the result of a bitwise and operation on a random number and " << N;
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_DXYN(std::uint16_t opcode) const {
-    // Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels
-    auto x = (opcode & 0x0F00) >> 8;
-    auto y = (opcode & 0x00F0) >> 4;
-    std::stringstream ss;
-    ss << "Draw a sprite at coordinate (V" << x << ", V" << y << ")";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_E000(std::uint16_t opcode) const {
-    if ((opcode & 0x00FF) == 0x0009) {
-        return op_EX09(opcode);
-    } else if ((opcode & 0x00FF) == 0x00A1) {
-        return op_EXA1(opcode);
-    } else {
-        return unknown(opcode);
+    int description = describe(opcode, buffer + prefix, size - prefix);
+    if (description == 0) {
+        // Unknown opcodes are written without address.
+        written = std::snprintf(buffer, size, "Unknown Opcode 0x%x", opcode);
+        return written < 0 ? 0 : std::min(static_cast<std::size_t>(written), size - 1);
     }
+    return std::min(prefix + static_cast<std::size_t>(description), size - 1);
 }
 
-std::string Decoder::op_EX09(std::uint16_t opcode) const {
-    auto x = (opcode & 0x0F00) >> 8;
-    std::stringstream ss;
-    ss << "Skips the next instruction if the key stored in V" << x << " is pressed.";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_EXA1(std::uint16_t opcode) const {
+// Return the number of characters written (as snprintf), or 0 if the opcode is unknown.
+int Decoder::describe(std::uint16_t opcode, char* buffer, std::size_t size) const {
     auto x = (opcode & 0x0F00) >> 8;
-    std::stringstream ss;
-    ss << "Skips the next instruction if the key stored in V" << x << " is not pressed.";
-    return print_with_desc(opcode, ss.str());
-}
-
-std::string Decoder::op_F000(std::uint16_t opcode) const {
-    if ((opcode & 0x00FF) == 0x000A) {
-        return op_FX0A(opcode);
-    } else {
-        return unknown(opcode);
+    auto y = (opcode & 0x00F0) >> 4;
+    auto nn = opcode & 0x00FF;
+    auto nnn = opcode & 0x0FFF;
+
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        if ((opcode & 0x000F) == 0) return std::snprintf(buffer, size, "Clears the screen");
+        return std::snprintf(buffer, size, "Return from subroutine");
+    case 0x1000:
+        return std::snprintf(buffer, size, "Jump to address 0x%x", nnn);
+    case 0x2000:
+        return std::snprintf(buffer, size, "Call subroutine at 0x%x", nnn);
+    case 0x3000:
+        return std::snprintf(buffer, size, "Skips next instruction if V%d equals %d", x, nn);
+    case 0x4000:
+        return std::snprintf(buffer, size, "Skips next instruction if V%d not equal to %d", x, nn);
+    case 0x5000:
+        return std::snprintf(buffer, size, "Skips next instruction if V%d equals V%d", x, y);
+    case 0x6000:
+        return std::snprintf(buffer, size, "Set V%d to %d", x, nn);
+    case 0x7000:
+        return std::snprintf(buffer, size, "Add %d to V%d", nn, x);
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0:
+            return std::snprintf(buffer, size, "Assign: V%d = V%d", x, y);
+        case 0x1:
+            return std::snprintf(buffer, size, "Sets V%d to V%d or V%d. (Bitwise OR operation)", x, x, y);
+        case 0x2:
+            return std::snprintf(buffer, size, "Sets V%d to V%d and V%d. (Bitwise AND operation)", x, x, y);
+        case 0x3:
+            return std::snprintf(buffer, size, "Sets V%d to V%d xor V%d. (Bitwise XOR operation)", x, x, y);
+        case 0x4:
+            return std::snprintf(buffer, size, "Adds V%d to V%d", y, x);
+        case 0x5:
+            return std::snprintf(buffer, size, "V%d is substracted from V%d", y, x);
+        case 0x6:
+            return std::snprintf(buffer, size,
+                                 "Store the least significant bit of V%d in VF and then shifts VX to the right by 1.", x);
+        case 0x7:
+            return std::snprintf(buffer, size, "Sets V%d to V%d minus V%d", x, y, x);
+        case 0xE:
+            return std::snprintf(buffer, size,
+                                 "Store the most significant bit of V%d in VF and then shifts VX to the left by 1.", x);
+        default:
+            return 0;
+        }
+    case 0x9000:
+        return std::snprintf(buffer, size, "Skips next instruction if V%d not equal to V%d", x, y);
+    case 0xA000:
+        return std::snprintf(buffer, size, "Set I to %d", nnn);
+    case 0xB000:
+        return std::snprintf(buffer, size, "Jump to the address %d + V0", nnn);
+    case 0xC000:
+        return std::snprintf(buffer, size,
+                             "Sets V%d to the result of a bitwise and operation on a random number and %d", x, nn);
+    case 0xD000:
+        return std::snprintf(buffer, size, "Draw a sprite at coordinate (V%d, V%d)", x, y);
+    case 0xE000:
+        if (nn == 0x9E) return std::snprintf(buffer, size, "Skips the next instruction if the key stored in V%d is pressed.", x);
+        if (nn == 0xA1) return std::snprintf(buffer, size, "Skips the next instruction if the key stored in V%d is not pressed.", x);
+        return 0;
+    case 0xF000:
+        switch (nn) {
+        case 0x07:
+            return std::snprintf(buffer, size, "Set V%d to the delay timer", x);
+        case 0x0A:
+            return std::snprintf(buffer, size, "Wait for key and will store in V%d", x);
+        case 0x15:
+            return std::snprintf(buffer, size, "Set the delay timer to V%d", x);
+        case 0x18:
+            return std::snprintf(buffer, size, "Set the sound timer to V%d", x);
+        case 0x1E:
+            return std::snprintf(buffer, size, "Add V%d to I", x);
+        case 0x29:
+            return std::snprintf(buffer, size, "Set I to the sprite of the character in V%d", x);
+        case 0x33:
+            return std::snprintf(buffer, size, "Store the BCD of V%d at I, I+1 and I+2", x);
+        case 0x55:
+            return std::snprintf(buffer, size, "Store V0 to V%d in memory starting at I", x);
+        case 0x65:
+            return std::snprintf(buffer, size, "Load V0 to V%d from memory starting at I", x);
+        default:
+            return 0;
+        }
+    default:
+        return 0;
     }
-
-}
-
-std::string Decoder::op_FX0A(std::uint16_t opcode) const {
-    auto x = (opcode & 0x0F00) >> 8;
-    std::stringstream ss;
-    ss << "Wait for key and will store in V" << x;
-    return print_with_desc(opcode, ss.str());
 }
 
 }
@@ -4,38 +4,66 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <functional>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
 #include <vector>
+#include "rom_library.h"
 
 namespace snooz {
 class Decoder {
 public:
+    // Longest line format() can produce, including the final '\0'.
+    static constexpr std::size_t max_line_size = 128;
 
     Decoder();
 
+    // Throw RomError, like Chip8.
     void load_game(std::string source);
+    void load_from_buffer(const std::vector<std::uint8_t>& buff);
+    void load_rom(RomSpan rom);
 
+    // Print the whole program on stdout, in one write.
     void decode();
 
-    std::string interpret(std::uint16_t opcode);
-private:
-
-    void next_opcode();
-
-    // Look at the first byte of the opcode and dispatch the correct function.
-    std::unordered_map<uint16_t, std::function<std::string(std::uint16_t) >> opcode_dispath_;
-
-    // for opcode such as 0x8...
-    std::unordered_map<uint16_t, std::function<std::string(std::uint16_t) >> arithmetic_dispath_;
-
-    std::string unknown(uint16_t opcode) const;
-    std::string print_with_desc(std::uint16_t opcode, const std::string& msg) const;
-
+    // Human readable description of an opcode, prefixed by its address.
+    // Without address, the address of the current decoded instruction is used.
+    std::string interpret(std::uint16_t opcode) const;
+    std::string interpret(std::uint16_t opcode, std::uint16_t pc) const;
+
+    // Same as interpret, but write into the given buffer and never allocate. The result is always
+    // null terminated and truncated if the buffer is too small. Return the length of the line.
+    std::size_t format(std::uint16_t opcode, std::uint16_t pc, char* buffer, std::size_t size) const;
+
+    // Write the line to an output iterator, without the terminating '\0'.
+    template <typename OutputIt>
+    OutputIt format_to(OutputIt out, std::uint16_t opcode, std::uint16_t pc) const {
+        char line[max_line_size];
+        auto length = format(opcode, pc, line, sizeof(line));
+        return std::copy(line, line + length, out);
+    }
+
+    // Disassemble the loaded program, one line per instruction.
+    template <typename OutputIt>
+    OutputIt disassemble(OutputIt out) const {
+        for (std::size_t offset = 0; offset < length_; offset += 2) {
+            auto pc = static_cast<std::uint16_t>(0x200 + offset);
+            out = format_to(out, opcode_at(pc), pc);
+            *out++ = '\n';
+        }
+        return out;
+    }
+
+    std::size_t length() const { return length_; }
 
+private:
+    std::uint16_t opcode_at(std::uint16_t pc) const {
+        return (memory_[pc & 0xFFF] << 8) | memory_[(pc + 1) & 0xFFF];
+    }
 
-        // 2bytes opcode
-    std::uint16_t opcode_;
+    // Write only the description of the opcode (without address).
+    int describe(std::uint16_t opcode, char* buffer, std::size_t size) const;
 
     // 4096 bytes memory
     // Layout is the following: 0x000 -> 0x200 interpreter. 0x200 -> 0xfff the program
@@ -52,25 +80,9 @@ private:
 3XNN 	Cond 	if(Vx==NN) 	Skips the next instruction if VX equals NN. (Usually the next instruction is a jump to skip a code block)
 4XNN 	Cond 	if(Vx!=NN) 	Skips the next instruction if VX doesn't equal NN. (Usually the next instruction is a jump to skip a code block)
 5XY0 	Cond 	if(Vx==Vy) 	Skips the next instruction if VX equals VY. (Usually the next instruction is a jump to skip a code block)
-     */
-    std::string op_0000(std::uint16_t opcode) const;
-    std::string op_00E0(std::uint16_t opcode) const;
-    std::string op_00EE(std::uint16_t opcode) const;
-    std::string op_1NNN(std::uint16_t opcode) const;
-    std::string op_2NNN(std::uint16_t opcode) const;
-    std::string op_3XNN(std::uint16_t opcode) const;
-    std::string op_4XNN(std::uint16_t opcode) const;
-    std::string op_5XY0(std::uint16_t opcode) const;
-
-    /*
-     * 6XNN 	Const 	Vx = NN 	Sets VX to NN.
-       7XNN 	Const 	Vx += NN 	Adds NN to VX. (Carry flag is not changed)
-     */
-    std::string op_6XNN(std::uint16_t opcode) const;
-    std::string op_7XNN(std::uint16_t opcode) const;
-
-    /*
-     * 8XY0 	Assign 	Vx=Vy 	Sets VX to the value of VY.
+6XNN 	Const 	Vx = NN 	Sets VX to NN.
+7XNN 	Const 	Vx += NN 	Adds NN to VX. (Carry flag is not changed)
+8XY0 	Assign 	Vx=Vy 	Sets VX to the value of VY.
 8XY1 	BitOp 	Vx=Vx|Vy 	Sets VX to VX or VY. (Bitwise OR operation)
 8XY2 	BitOp 	Vx=Vx&Vy 	Sets VX to VX and VY. (Bitwise AND operation)
 8XY3 	BitOp 	Vx=Vx^Vy 	Sets VX to VX xor VY.
@@ -79,42 +91,23 @@ private:
 8XY6 	BitOp 	Vx>>=1 	Stores the least significant bit of VX in VF and then shifts VX to the right by 1.[2]
 8XY7 	Math 	Vx=Vy-Vx 	Sets VX to VY minus VX. VF is set to 0 when there's a borrow, and 1 when there isn't.
 8XYE 	BitOp 	Vx<<=1 	Stores the most significant bit of VX in VF and then shifts VX to the left by 1.[3]
-     */
-    std::string op_8000(std::uint16_t opcode);
-    std::string op_8XY0(std::uint16_t opcode) const;
-    std::string op_8XY1(std::uint16_t opcode) const;
-    std::string op_8XY2(std::uint16_t opcode) const;
-    std::string op_8XY3(std::uint16_t opcode) const;
-    std::string op_8XY4(std::uint16_t opcode) const;
-    std::string op_8XY5(std::uint16_t opcode) const;
-    std::string op_8XY6(std::uint16_t opcode) const;
-    std::string op_8XY7(std::uint16_t opcode) const;
-    std::string op_8XYE(std::uint16_t opcode) const;
-
-    /*
-     * 9XY0 	Cond 	if(Vx!=Vy) 	Skips the next instruction if VX doesn't equal VY.
-     *  (Usually the next instruction is a jump to skip a code block)
+9XY0 	Cond 	if(Vx!=Vy) 	Skips the next instruction if VX doesn't equal VY.
 ANNN 	MEM 	I = NNN 	Sets I to the address NNN.
 BNNN 	Flow 	PC=V0+NNN 	Jumps to the address NNN plus V0.
 CXNN 	Rand 	Vx=rand()&NN 	Sets VX to the result of a bitwise and operation on a random number (Typically: 0 to 255) and NN.
 DXYN 	Disp 	draw(Vx,Vy,N) 	Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.
-            Each row of 8 pixels is read as bit-coded starting from memory location I; I value doesn’t change after the execution
-            of this instruction. As described above, VF is set to 1 if any screen pixels are flipped from set to unset when the
-            sprite is drawn, and to 0 if that doesn’t happen
+EX9E 	KeyOp 	if(key()==Vx) 	Skips the next instruction if the key stored in VX is pressed.
+EXA1 	KeyOp 	if(key()!=Vx) 	Skips the next instruction if the key stored in VX isn't pressed.
+FX07 	Timer 	Vx = get_delay() 	Sets VX to the value of the delay timer.
+FX0A 	KeyOp 	Vx = get_key() 	A key press is awaited, and then stored in VX.
+FX15 	Timer 	delay_timer(Vx) 	Sets the delay timer to VX.
+FX18 	Sound 	sound_timer(Vx) 	Sets the sound timer to VX.
+FX1E 	MEM 	I +=Vx 	Adds VX to I.
+FX29 	MEM 	I=sprite_addr[Vx] 	Sets I to the location of the sprite for the character in VX.
+FX33 	BCD 	set_BCD(Vx) 	Stores the binary-coded decimal representation of VX at I, I+1 and I+2.
+FX55 	MEM 	reg_dump(Vx,&I) 	Stores V0 to VX (including VX) in memory starting at address I.
+FX65 	MEM 	reg_load(Vx,&I) 	Fills V0 to VX (including VX) with values from memory starting at address I.
      */
-    std::string op_9XY0(std::uint16_t opcode) const;
-    std::string op_ANNN(std::uint16_t opcode) const;
-    std::string op_BNNN(std::uint16_t opcode) const;
-    std::string op_CXNN(std::uint16_t opcode) const;
-    std::string op_DXYN(std::uint16_t opcode) const;
-
-    // key pressing
-    std::string op_E000(std::uint16_t opcode) const;
-    std::string op_EX09(std::uint16_t opcode) const;
-    std::string op_EXA1(std::uint16_t opcode) const;
-    std::string op_F000(std::uint16_t opcode) const;
-    std::string op_FX0A(std::uint16_t opcode) const;
 };
 
 }
-
@@ -0,0 +1,53 @@
+#include "deflicker.h"
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace snooz {
+
+Deflicker::Deflicker(std::uint8_t decay):
+        decay_(decay) {
+}
+
+void Deflicker::reset() {
+    std::fill(intensity_.begin(), intensity_.end(), 0);
+}
+
+FramebufferView Deflicker::process(const FramebufferView& frame) {
+    if (frame.width != width_ || frame.height != height_) {
+        width_ = frame.width;
+        height_ = frame.height;
+        intensity_.assign(width_ * height_, 0);
+    }
+
+    for (std::size_t row = 0; row < height_; row++) {
+        auto source = frame.pixels + row * frame.stride;
+        auto intensity = intensity_.data() + row * width_;
+        std::size_t column = 0;
+#ifdef __SSE2__
+        // 16 pixels at a time: widen to 16 bits, multiply by the decay, keep the high byte.
+        auto zero = _mm_setzero_si128();
+        auto decay = _mm_set1_epi16(decay_);
+        for (; column + 16 <= width_; column += 16) {
+            auto previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(intensity + column));
+            auto low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(previous, zero), decay), 8);
+            auto high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(previous, zero), decay), 8);
+            auto decayed = _mm_packus_epi16(low, high);
+
+            auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + column));
+            // 0xFF where the pixel is lit, on any plane.
+            auto lit = _mm_xor_si128(_mm_cmpeq_epi8(pixels, zero), _mm_set1_epi8(-1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(intensity + column), _mm_max_epu8(decayed, lit));
+        }
+#endif
+        for (; column < width_; column++) {
+            auto decayed = static_cast<std::uint8_t>((intensity[column] * decay_) >> 8);
+            intensity[column] = source[column] != 0 ? 255 : decayed;
+        }
+    }
+    return {intensity_.data(), width_, height_, width_, PixelFormat::Intensity};
+}
+
+}
@@ -0,0 +1,35 @@
+// Phosphor persistence: a pixel that goes off fades out over a few frames instead of disappearing. CHIP-8 games
+// erase and redraw their sprites with XOR, which flickers badly on a modern screen without it.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "renderer.h"
+
+namespace snooz {
+
+class Deflicker {
+public:
+    // decay: how much of its intensity a pixel keeps from one frame to the next, out of 256. 0 turns the blending
+    // off: lit pixels are 255, the others 0.
+    explicit Deflicker(std::uint8_t decay = 176);
+
+    void set_decay(std::uint8_t decay) { decay_ = decay; }
+    std::uint8_t decay() const { return decay_; }
+
+    // Blend one more frame in: every pixel is the brightest of the new frame (lit pixels at 255) and of its previous
+    // intensity decayed. Call once per displayed frame, even when the frame did not change, for the fade to go on.
+    // The result is valid until the next call, in PixelFormat::Intensity.
+    FramebufferView process(const FramebufferView& frame);
+    // Forget the history, e.g. when a new game starts.
+    void reset();
+
+private:
+    std::uint8_t decay_;
+    std::size_t width_{0};
+    std::size_t height_{0};
+    std::vector<std::uint8_t> intensity_;
+};
+
+}
@@ -0,0 +1,166 @@
+#include "emulator_thread.h"
+
+namespace snooz {
+
+constexpr auto frame_delta_time = std::chrono::microseconds(16667); // 60Hz
+
+EmulatorThread::EmulatorThread(Chip8& chip8):
+        chip8_(chip8) {
+}
+
+EmulatorThread::~EmulatorThread() {
+    stop();
+}
+
+void EmulatorThread::start() {
+    if (running_.exchange(true)) return;
+    publish_frame();
+    pacer_.reset(new FramePacer(frame_delta_time, std::chrono::microseconds(300), use_timerfd_));
+    thread_ = std::thread([this] { loop(); });
+}
+
+void EmulatorThread::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        running_.store(false);
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool EmulatorThread::push_key(std::uint8_t key, bool pressed) {
+    if (!keys_.push(KeyEvent{std::chrono::steady_clock::now(), key, pressed})) return false;
+    // Under the lock, or the core could check the queue, miss the key and then sleep.
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_.notify_one();
+    return true;
+}
+
+void EmulatorThread::loop() {
+    bool was_paused = false;
+    while (running_.load(std::memory_order_relaxed)) {
+        drain_keys();
+
+        if (server_ != nullptr && debugger_ != nullptr) {
+            auto cycles = chip8_.cycles();
+            auto server_paused = server_->poll(chip8_, *debugger_, paused_.load(std::memory_order_relaxed));
+            paused_.store(server_paused, std::memory_order_relaxed);
+            // Stepped from the remote debugger.
+            if (server_paused && chip8_.cycles() != cycles) publish_frame();
+        }
+
+        auto paused = paused_.load(std::memory_order_relaxed);
+        if (paused && !was_paused) {
+            // Give the debug view an up to date copy of the registers.
+            publish_frame();
+        }
+        was_paused = paused;
+
+        if (paused && step_requested_.exchange(false) && debugger_ != nullptr) {
+            debugger_->step(chip8_);
+            publish_frame();
+        }
+
+        if (!paused) {
+            // As many instructions per frame as the ROM profile says. The timers tick on their own with them.
+            if (debugger_ == nullptr) {
+                NoHooks no_hooks;
+                chip8_.run_cycles(chip8_.instructions_per_frame(), no_hooks);
+            } else {
+                auto reason = debugger_->run(chip8_, chip8_.instructions_per_frame());
+                if (reason != StopReason::None) {
+                    // Stay on the instruction that broke. The next loop publishes the frame.
+                    paused_.store(true, std::memory_order_relaxed);
+                    if (server_ != nullptr) server_->stopped(reason);
+                }
+            }
+            if (buzzer_ != nullptr) buzzer_->tick(chip8_.sound_active());
+
+            // Only hand over a frame when the screen actually changed.
+            if (chip8_.draw_flag()) {
+                publish_frame();
+                chip8_.set_draw_flag(false);
+            }
+        }
+
+        wait_next_frame();
+    }
+}
+
+std::uint64_t EmulatorThread::idle_frames() const {
+    // The debugger and the debug server look at every instruction or every frame, the buzzer needs its ticks.
+    if (paused() || server_ != nullptr || (debugger_ != nullptr && debugger_->armed())) return 1;
+    if (buzzer_ != nullptr && chip8_.sound_active()) return 1;
+
+    switch (chip8_.idle()) {
+    case Idle::UntilKey:
+        return 0;
+    case Idle::UntilTick: {
+        auto ticks = chip8_.idle_until_tick() - chip8_.timer_tick();
+        return ticks > 1 ? ticks : 1;
+    }
+    case Idle::No:
+        break;
+    }
+    return 1;
+}
+
+void EmulatorThread::wait_next_frame() {
+    auto frames = idle_frames();
+    if (frames == 1) {
+        pacer_->wait();
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        auto woken = [this] { return !keys_.empty() || !running_.load(std::memory_order_relaxed); };
+        if (frames == 0) {
+            wake_.wait(lock, woken);
+        } else {
+            wake_.wait_until(lock, pacer_->deadline() + frame_delta_time * (frames - 1), woken);
+        }
+    }
+    pacer_->restart();
+
+    // The frame that follows runs normally: skip the ones before it.
+    auto slept = static_cast<std::uint64_t>((std::chrono::steady_clock::now() - start) / frame_delta_time);
+    if (slept > 1) {
+        auto count = (slept - 1) * chip8_.instructions_per_frame();
+        auto skipped = chip8_.skip_idle(count);
+        // Past the end of a timer wait: the rest really runs, at most a frame or so.
+        NoHooks no_hooks;
+        chip8_.run_cycles(count - skipped, no_hooks);
+    }
+}
+
+void EmulatorThread::drain_keys() {
+    KeyEvent event;
+    while (keys_.pop(event)) {
+        if (event.pressed) {
+            chip8_.set_key_pressed(event.key);
+        } else {
+            chip8_.set_key_released(event.key);
+        }
+    }
+}
+
+void EmulatorThread::publish_frame() {
+    auto& frame = frames_.write_buffer();
+    frame.gfx = chip8_.gfx();
+    for (size_t i = 0; i < frame.registers.size(); i++) {
+        frame.registers[i] = chip8_.register_value(i);
+    }
+    frame.pc = chip8_.pc();
+    frame.opcode = chip8_.opcode();
+    frame.I = chip8_.index();
+    frame.sequence = ++sequence_;
+    frames_.publish();
+}
+
+}
@@ -0,0 +1,108 @@
+// Runs the Chip8 core on its own thread so that slow draws in the frontend never stall emulation.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "audio.h"
+#include "chip_8.h"
+#include "debug_server.h"
+#include "debugger.h"
+#include "frame_pacer.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+namespace snooz {
+
+// Key event sent from the window thread to the core.
+struct KeyEvent {
+    std::chrono::steady_clock::time_point timestamp;
+    std::uint8_t key;
+    bool pressed;
+};
+
+// Completed frame published by the core.
+struct Frame {
+    std::array<std::uint8_t, 64*32> gfx;
+    std::array<std::uint8_t, 16> registers;
+    std::uint16_t pc;
+    std::uint16_t opcode;
+    std::uint16_t I;
+    // Incremented for every published frame.
+    std::uint64_t sequence;
+};
+
+class EmulatorThread {
+public:
+    explicit EmulatorThread(Chip8& chip8);
+    ~EmulatorThread();
+
+    // Optional. Set before start(), ticked once per frame on the core thread.
+    void set_buzzer(Buzzer* buzzer) { buzzer_ = buzzer; }
+
+    // Optional. Set before start(). The core pauses when the debugger breaks.
+    void set_debugger(Debugger* debugger) { debugger_ = debugger; }
+    // Optional, needs a debugger. Set before start(). Polled once per frame.
+    void set_debug_server(DebugServer* server) { server_ = server; }
+
+    // Optional. Set before start(). Sleep on a Linux timerfd between frames, see FramePacer.
+    void set_use_timerfd(bool use_timerfd) { use_timerfd_ = use_timerfd; }
+
+    void start();
+    void stop();
+
+    // After stop(): how evenly the frames were paced.
+    FrameJitter frame_jitter() const { return pacer_ != nullptr ? pacer_->jitter() : FrameJitter{}; }
+
+    // Window thread. Return false if the queue is full and the event was dropped.
+    // Wakes the core up if it sleeps until a key.
+    bool push_key(std::uint8_t key, bool pressed);
+
+    // Window thread. Return true if a new frame is available in frame().
+    bool update_frame() { return frames_.update(); }
+    const Frame& frame() const { return frames_.read_buffer(); }
+
+    // When paused the core stops executing instructions but keeps draining input.
+    void set_paused(bool paused) { paused_.store(paused, std::memory_order_relaxed); }
+    bool paused() const { return paused_.load(std::memory_order_relaxed); }
+    // Window thread. Run one instruction while paused. Needs a debugger.
+    void step() { step_requested_.store(true, std::memory_order_relaxed); }
+
+private:
+    void loop();
+    void drain_keys();
+    void publish_frame();
+    // Frames the core can sleep through: 1 when busy, more when the ROM waits for the delay timer, 0 when it can
+    // only wait for a key.
+    std::uint64_t idle_frames() const;
+    // Wait for the deadline of the next frame, or sleep longer when idle. After a long sleep, the instructions the ROM would have
+    // spun through are skipped so that emulated time catches up.
+    void wait_next_frame();
+
+    Chip8& chip8_;
+    Buzzer* buzzer_{nullptr};
+    Debugger* debugger_{nullptr};
+    DebugServer* server_{nullptr};
+    bool use_timerfd_{false};
+    std::unique_ptr<FramePacer> pacer_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> paused_{false};
+    std::atomic<bool> step_requested_{false};
+
+    // Signaled by push_key and stop, to end an idle sleep.
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+
+    SpscQueue<KeyEvent, 64> keys_;
+    TripleBuffer<Frame> frames_;
+    std::uint64_t sequence_{0};
+};
+
+}
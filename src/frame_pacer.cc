@@ -0,0 +1,101 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#endif
+
+namespace snooz {
+
+constexpr std::size_t FramePacer::history;
+
+FramePacer::FramePacer(Clock::duration period, Clock::duration spin, bool use_timerfd):
+        period_(period),
+        spin_(spin) {
+#ifdef __linux__
+    // steady_clock is CLOCK_MONOTONIC with libstdc++ and libc++, so deadlines can be handed over as they are.
+    if (use_timerfd) timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+#else
+    (void) use_timerfd;
+#endif
+    restart();
+}
+
+FramePacer::~FramePacer() {
+#ifdef __linux__
+    if (timer_fd_ >= 0) close(timer_fd_);
+#endif
+}
+
+void FramePacer::restart() {
+    deadline_ = Clock::now() + period_;
+    has_last_ = false;
+}
+
+void FramePacer::wait() {
+    auto now = Clock::now();
+    if (now - deadline_ > period_) {
+        // Too late to catch up: skip the schedule forward.
+        deadline_ = now;
+    } else {
+        sleep_until(deadline_ - spin_);
+        while (Clock::now() < deadline_) {
+            // Spin tail.
+        }
+        now = Clock::now();
+    }
+
+    if (has_last_) {
+        std::chrono::duration<float, std::milli> deviation = (now - last_) - period_;
+        deviations_[measured_ % history] = std::fabs(deviation.count());
+        measured_++;
+    }
+    last_ = now;
+    has_last_ = true;
+    deadline_ += period_;
+}
+
+void FramePacer::sleep_until(Clock::time_point time) {
+#ifdef __linux__
+    if (timer_fd_ >= 0) {
+        auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        if (since_epoch <= 0) return;
+        itimerspec spec{};
+        spec.it_value.tv_sec = since_epoch / 1000000000;
+        spec.it_value.tv_nsec = since_epoch % 1000000000;
+        if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+            std::uint64_t expirations;
+            while (read(timer_fd_, &expirations, sizeof(expirations)) < 0 && errno == EINTR) {
+            }
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_until(time);
+}
+
+FrameJitter summarize_jitter(std::vector<float> deviations) {
+    FrameJitter jitter;
+    jitter.frames = deviations.size();
+    if (deviations.empty()) return jitter;
+
+    std::sort(deviations.begin(), deviations.end());
+    auto percentile = [&](double p) { return deviations[static_cast<std::size_t>(p * (deviations.size() - 1))]; };
+    jitter.p50 = percentile(0.50);
+    jitter.p90 = percentile(0.90);
+    jitter.p99 = percentile(0.99);
+    jitter.max = deviations.back();
+    return jitter;
+}
+
+FrameJitter FramePacer::jitter() const {
+    return summarize_jitter({deviations_.begin(), deviations_.begin() + std::min(measured_, history)});
+}
+
+}
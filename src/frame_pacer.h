@@ -0,0 +1,70 @@
+// Paces a loop at a fixed rate on absolute deadlines: a late frame does not push back the following ones.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace snooz {
+
+// Deviation of the frame durations from the period, in milliseconds.
+struct FrameJitter {
+    std::size_t frames{0};
+    double p50{0};
+    double p90{0};
+    double p99{0};
+    double max{0};
+};
+
+// Percentiles of frame deviations, in milliseconds, in any order. Each is one of the values: p90 of 100 deviations is
+// the 90th smallest.
+FrameJitter summarize_jitter(std::vector<float> deviations);
+
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // The thread sleeps until spin before each deadline, then spins: sleeps overshoot by scheduler slack, spinning
+    // does not. With use_timerfd, the sleep is a Linux timerfd on the same clock, which wakes up closer to the time
+    // asked than sleep_until. Falls back to sleep_until when timerfd is not available.
+    explicit FramePacer(Clock::duration period = std::chrono::microseconds(16667),
+                        Clock::duration spin = std::chrono::microseconds(300),
+                        bool use_timerfd = false);
+    ~FramePacer();
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // Return at the deadline of the next frame. When more than a frame late, the schedule starts again from now
+    // instead of running the missed frames back to back.
+    void wait();
+    // Start again from now, after the loop did not wait for a while (an idle sleep, a pause).
+    void restart();
+
+    Clock::time_point deadline() const { return deadline_; }
+    Clock::duration period() const { return period_; }
+    bool uses_timerfd() const { return timer_fd_ >= 0; }
+
+    // Over the last frames measured, restarts excluded.
+    FrameJitter jitter() const;
+
+private:
+    void sleep_until(Clock::time_point time);
+
+    Clock::duration period_;
+    Clock::duration spin_;
+    int timer_fd_{-1};
+
+    Clock::time_point deadline_;
+    // Time wait() last returned, to measure the frame durations. Cleared by a restart.
+    Clock::time_point last_;
+    bool has_last_{false};
+
+    static constexpr std::size_t history = 1024;
+    std::array<float, history> deviations_{};
+    std::size_t measured_{0};
+};
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace snooz {
+
+// 64 bits FNV-1a. Good enough to compare framebuffers and memory between runs.
+constexpr std::uint64_t fnv1a_offset = 0xcbf29ce484222325ULL;
+
+inline std::uint64_t fnv1a(const std::uint8_t* data, std::size_t size, std::uint64_t hash = fnv1a_offset) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Finalizer of SplitMix64: a cheap bijective mix, every input bit flips about half of the output bits.
+inline std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+}
@@ -0,0 +1,82 @@
+#include "headless.h"
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "hash.h"
+
+namespace snooz {
+
+std::vector<ScriptedKey> parse_input_script(std::istream& in) {
+    std::vector<ScriptedKey> events;
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); number++) {
+        if (line.empty() || line[0] == '#') continue;
+        auto fail = [&](const std::string& reason) {
+            throw std::invalid_argument("line " + std::to_string(number) + ": " + reason + ": " + line);
+        };
+
+        std::istringstream ss(line);
+        std::uint64_t frame;
+        unsigned key;
+        std::string action, rest;
+        if (!(ss >> frame >> std::hex >> key >> action) || ss >> rest) fail("expected <frame> <key> down|up");
+        if (key >= 0x10) fail("no such key");
+        if (action != "down" && action != "up") fail("unknown action");
+        // run_headless walks the events once, in order.
+        if (!events.empty() && frame < events.back().frame) fail("frame before the previous event");
+        events.push_back(ScriptedKey{frame, static_cast<std::uint8_t>(key), action == "down"});
+    }
+    return events;
+}
+
+HeadlessResult run_headless(Chip8& chip8, const HeadlessOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    auto first_cycle = chip8.cycles();
+    auto next_event = options.input.begin();
+    if (options.instructions_per_frame != 0) chip8.set_instructions_per_frame(options.instructions_per_frame);
+    auto instructions_per_frame = chip8.instructions_per_frame();
+
+    auto instructions_left = [&] {
+        return options.instructions == 0 || chip8.cycles() - first_cycle < options.instructions;
+    };
+
+    NoHooks hooks;
+    HeadlessResult result;
+    std::uint64_t frame = 0;
+    while (instructions_left() && chip8.should_continue() && (options.frames == 0 || frame < options.frames)) {
+        for (; next_event != options.input.end() && next_event->frame <= frame; ++next_event) {
+            if (next_event->pressed) {
+                chip8.set_key_pressed(next_event->key);
+            } else {
+                chip8.set_key_released(next_event->key);
+            }
+        }
+
+        // Stops early when the machine halts, so that only instructions that ran are counted.
+        std::uint64_t count = instructions_per_frame;
+        if (options.instructions != 0) {
+            count = std::min(count, options.instructions - (chip8.cycles() - first_cycle));
+        }
+        chip8.run_cycles(count, hooks);
+        if (options.buzzer != nullptr) options.buzzer->tick(chip8.sound_active());
+        if (options.video != nullptr) options.video->push(FramebufferView::of(chip8.gfx()));
+        frame++;
+        if (options.checkpoint_interval != 0 && frame % options.checkpoint_interval == 0) {
+            result.checkpoints.push_back(fnv1a(chip8.gfx().data(), chip8.gfx().size()));
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.instructions = chip8.cycles() - first_cycle;
+    result.frames = frame;
+    result.seconds = elapsed.count();
+    result.framebuffer_hash = fnv1a(chip8.gfx().data(), chip8.gfx().size());
+    result.memory_hash = fnv1a(chip8.memory().data(), chip8.memory().size());
+    return result;
+}
+
+}
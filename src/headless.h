@@ -0,0 +1,57 @@
+// Run a ROM without any window, for benchmarks and regression tests on servers.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include "audio.h"
+#include "chip_8.h"
+#include "video_export.h"
+
+namespace snooz {
+
+// Press or release a key at the start of a frame.
+struct ScriptedKey {
+    std::uint64_t frame;
+    std::uint8_t key;
+    bool pressed;
+};
+
+// One event per line: `<frame> <key in hex> down|up`. Lines starting with # are comments.
+// Events must be sorted by frame. Throw std::invalid_argument on any other line, naming it.
+std::vector<ScriptedKey> parse_input_script(std::istream& in);
+
+struct HeadlessOptions {
+    // Stop after that many frames. 0 means no limit.
+    std::uint64_t frames{0};
+    // Stop after that many instructions. 0 means no limit.
+    std::uint64_t instructions{0};
+    // Instructions executed per 60Hz frame, set on the chip: the timers tick once per frame.
+    // 0 means the speed of the ROM profile.
+    std::uint32_t instructions_per_frame{0};
+    std::vector<ScriptedKey> input;
+    // Optional, ticked once per frame.
+    Buzzer* buzzer{nullptr};
+    // Optional, gets the framebuffer at the end of every frame.
+    VideoExporter* video{nullptr};
+    // Hash the framebuffer at the end of every that many frames. 0 means no checkpoints.
+    std::uint64_t checkpoint_interval{0};
+};
+
+struct HeadlessResult {
+    std::uint64_t instructions;
+    std::uint64_t frames;
+    double seconds;
+    std::uint64_t framebuffer_hash;
+    std::uint64_t memory_hash;
+    // Framebuffer hash at each checkpoint, see HeadlessOptions::checkpoint_interval.
+    std::vector<std::uint64_t> checkpoints;
+
+    double mips() const { return seconds > 0 ? instructions / seconds / 1e6 : 0; }
+};
+
+// Run until one of the limits in options is reached, or until the chip stops.
+HeadlessResult run_headless(Chip8& chip8, const HeadlessOptions& options);
+
+}
@@ -0,0 +1,324 @@
+#include "libchip8.h"
+#include <array>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include "chip_8.h"
+#include "hash.h"
+
+using snooz::Chip8;
+
+struct chip8_machine {
+    Chip8 chip8;
+    std::string error;
+    // Keys as last set, to only send the changes to the core: FX0A waits for a press.
+    std::uint16_t keys{0};
+    // FNV-1a of the ROM loaded, saved with the states.
+    std::uint64_t rom_hash{0};
+};
+
+namespace {
+
+// Saved states: this magic, the ABI version, then every field in a fixed order, little endian, so that the layout does
+// not depend on the compiler. Bools are bytes.
+constexpr char state_magic[4] = {'C', '8', 'S', 'T'};
+constexpr std::size_t state_size = 4 + 4
+        + 4096 + 16 + 2 + 2 + 2 + 16 * 2 + 1 + 64 * 32 + 1 + 1 + 16 + 1 + 1 + 1 + 1 + 8 + 8 + 8
+        // ROM hash, quirks, instructions per frame, engine.
+        + 8 + 5 + 4 + 1;
+
+class StateWriter {
+public:
+    explicit StateWriter(std::uint8_t* out): out_(out) {}
+
+    template <typename T>
+    void put(T value) {
+        for (std::size_t i = 0; i < sizeof(T); i++) *out_++ = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+    void put(bool value) { put<std::uint8_t>(value); }
+    template <typename T, std::size_t N>
+    void put(const std::array<T, N>& values) {
+        for (auto value: values) put(value);
+    }
+
+private:
+    std::uint8_t* out_;
+};
+
+// Stops at the first invalid value: ok() is false from there.
+class StateReader {
+public:
+    explicit StateReader(const std::uint8_t* in): in_(in) {}
+
+    template <typename T>
+    void get(T& value, T max = std::numeric_limits<T>::max()) {
+        T read = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++) read |= static_cast<T>(static_cast<T>(*in_++) << (8 * i));
+        if (read > max) ok_ = false;
+        value = read;
+    }
+    void get(bool& value) {
+        std::uint8_t byte;
+        get(byte, std::uint8_t{1});
+        value = byte != 0;
+    }
+    template <typename T, std::size_t N>
+    void get(std::array<T, N>& values) {
+        for (auto& value: values) get(value);
+    }
+    bool ok() const { return ok_; }
+
+private:
+    const std::uint8_t* in_;
+    bool ok_{true};
+};
+
+chip8_status fail(chip8_machine* machine, chip8_status status, const char* message) {
+    machine->error = message;
+    return status;
+}
+
+// Every entry point that can throw goes through this: no exception crosses the C interface.
+template <typename Function>
+chip8_status guarded(chip8_machine* machine, Function function) {
+    try {
+        machine->error.clear();
+        return function();
+    } catch (const snooz::RomError& error) {
+        return fail(machine, CHIP8_ERROR_ROM, error.what());
+    } catch (const std::bad_alloc&) {
+        return fail(machine, CHIP8_ERROR_INTERNAL, "out of memory");
+    } catch (const std::exception& error) {
+        return fail(machine, CHIP8_ERROR_INTERNAL, error.what());
+    } catch (...) {
+        return fail(machine, CHIP8_ERROR_INTERNAL, "unknown error");
+    }
+}
+
+void apply_keys(chip8_machine* machine, std::uint16_t keys) {
+    auto changed = machine->keys ^ keys;
+    for (std::size_t key = 0; changed != 0; key++, changed >>= 1) {
+        if ((changed & 1) == 0) continue;
+        if (keys & (1 << key)) {
+            machine->chip8.set_key_pressed(key);
+        } else {
+            machine->chip8.set_key_released(key);
+        }
+    }
+    machine->keys = keys;
+}
+
+}
+
+extern "C" {
+
+uint32_t chip8_abi_version(void) {
+    return CHIP8_ABI_VERSION;
+}
+
+chip8_machine* chip8_create(void) {
+    try {
+        return new chip8_machine;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void chip8_destroy(chip8_machine* machine) {
+    delete machine;
+}
+
+const char* chip8_last_error(const chip8_machine* machine) {
+    return machine != nullptr ? machine->error.c_str() : "null machine";
+}
+
+chip8_status chip8_load(chip8_machine* machine, const uint8_t* rom, size_t size) {
+    if (machine == nullptr) return CHIP8_ERROR_ARGUMENT;
+    if (rom == nullptr && size != 0) return fail(machine, CHIP8_ERROR_ARGUMENT, "null ROM");
+    return guarded(machine, [&] {
+        machine->chip8.reset();
+        machine->keys = 0;
+        machine->rom_hash = 0;
+        machine->chip8.load_rom(snooz::RomSpan{rom, size});
+        machine->rom_hash = snooz::fnv1a(rom, size);
+        return CHIP8_OK;
+    });
+}
+
+void chip8_seed(chip8_machine* machine, uint32_t seed) {
+    if (machine != nullptr) machine->chip8.seed(seed);
+}
+
+uint32_t chip8_instructions_per_frame(const chip8_machine* machine) {
+    return machine != nullptr ? machine->chip8.instructions_per_frame() : 0;
+}
+
+chip8_status chip8_set_instructions_per_frame(chip8_machine* machine, uint32_t count) {
+    if (machine == nullptr) return CHIP8_ERROR_ARGUMENT;
+    if (count == 0) return fail(machine, CHIP8_ERROR_ARGUMENT, "0 instructions per frame");
+    machine->chip8.set_instructions_per_frame(count);
+    return CHIP8_OK;
+}
+
+uint64_t chip8_run_frame(chip8_machine* machine) {
+    if (machine == nullptr) return 0;
+    snooz::NoHooks hooks;
+    return machine->chip8.run_cycles(machine->chip8.instructions_per_frame(), hooks);
+}
+
+uint64_t chip8_run_frames(chip8_machine* machine, uint32_t frames, const uint16_t* keys) {
+    if (machine == nullptr) return 0;
+    snooz::NoHooks hooks;
+    std::uint64_t executed = 0;
+    for (std::uint32_t frame = 0; frame < frames && machine->chip8.should_continue(); frame++) {
+        if (keys != nullptr) apply_keys(machine, keys[frame]);
+        executed += machine->chip8.run_cycles(machine->chip8.instructions_per_frame(), hooks);
+    }
+    return executed;
+}
+
+uint64_t chip8_step(chip8_machine* machine, uint64_t count) {
+    if (machine == nullptr) return 0;
+    snooz::NoHooks hooks;
+    return machine->chip8.run_cycles(count, hooks);
+}
+
+int chip8_running(const chip8_machine* machine) {
+    return machine != nullptr && machine->chip8.should_continue();
+}
+
+uint64_t chip8_cycles(const chip8_machine* machine) {
+    return machine != nullptr ? machine->chip8.cycles() : 0;
+}
+
+chip8_status chip8_set_key(chip8_machine* machine, uint32_t key, int pressed) {
+    if (machine == nullptr) return CHIP8_ERROR_ARGUMENT;
+    if (key >= 16) return fail(machine, CHIP8_ERROR_ARGUMENT, "key out of range");
+    auto bit = static_cast<std::uint16_t>(1 << key);
+    apply_keys(machine, pressed ? machine->keys | bit : machine->keys & ~bit);
+    return CHIP8_OK;
+}
+
+void chip8_set_keys(chip8_machine* machine, uint16_t keys) {
+    if (machine != nullptr) apply_keys(machine, keys);
+}
+
+uint16_t chip8_keys(const chip8_machine* machine) {
+    return machine != nullptr ? machine->keys : 0;
+}
+
+const uint8_t* chip8_framebuffer(const chip8_machine* machine) {
+    return machine != nullptr ? machine->chip8.gfx().data() : nullptr;
+}
+
+int chip8_sound_active(const chip8_machine* machine) {
+    return machine != nullptr && machine->chip8.sound_active();
+}
+
+size_t chip8_state_size(void) {
+    return state_size;
+}
+
+chip8_status chip8_save_state(const chip8_machine* machine, void* buffer, size_t size) {
+    if (machine == nullptr || buffer == nullptr || size < state_size) return CHIP8_ERROR_ARGUMENT;
+    auto snapshot = machine->chip8.snapshot();
+    auto& profile = machine->chip8.profile();
+    auto bytes = static_cast<std::uint8_t*>(buffer);
+    std::memcpy(bytes, state_magic, sizeof(state_magic));
+
+    StateWriter out(bytes + sizeof(state_magic));
+    out.put<std::uint32_t>(CHIP8_ABI_VERSION);
+    out.put(snapshot.memory);
+    out.put(snapshot.V);
+    out.put(snapshot.I);
+    out.put(snapshot.pc);
+    out.put(snapshot.opcode);
+    out.put(snapshot.stack);
+    out.put(static_cast<std::uint8_t>(snapshot.sp));
+    out.put(snapshot.gfx);
+    out.put(snapshot.delay_timer);
+    out.put(snapshot.sound_timer);
+    out.put(snapshot.key);
+    out.put(snapshot.wait_for_key);
+    out.put(snapshot.key_pressed);
+    out.put(snapshot.key_pressed_idx);
+    out.put(snapshot.draw_flag);
+    out.put(snapshot.cycles);
+    out.put(snapshot.tick_base);
+    out.put(snapshot.tick_cycle);
+    out.put(machine->rom_hash);
+    out.put(profile.quirks.shift_uses_vy);
+    out.put(profile.quirks.load_store_increments_i);
+    out.put(profile.quirks.jump_uses_vx);
+    out.put(profile.quirks.clip_sprites);
+    out.put(profile.quirks.logic_resets_vf);
+    out.put(profile.instructions_per_frame);
+    out.put(static_cast<std::uint8_t>(profile.engine));
+    return CHIP8_OK;
+}
+
+chip8_status chip8_load_state(chip8_machine* machine, const void* buffer, size_t size) {
+    if (machine == nullptr) return CHIP8_ERROR_ARGUMENT;
+    if (buffer == nullptr || size < state_size) return fail(machine, CHIP8_ERROR_ARGUMENT, "state too small");
+    auto bytes = static_cast<const std::uint8_t*>(buffer);
+    if (std::memcmp(bytes, state_magic, sizeof(state_magic)) != 0) {
+        return fail(machine, CHIP8_ERROR_STATE, "not a saved state");
+    }
+
+    StateReader in(bytes + sizeof(state_magic));
+    std::uint32_t version;
+    in.get(version);
+    if (version != CHIP8_ABI_VERSION) return fail(machine, CHIP8_ERROR_STATE, "state of another version");
+
+    Chip8::Snapshot snapshot;
+    in.get(snapshot.memory);
+    in.get(snapshot.V);
+    in.get(snapshot.I);
+    in.get(snapshot.pc);
+    in.get(snapshot.opcode);
+    in.get(snapshot.stack);
+    std::uint8_t sp;
+    in.get(sp, std::uint8_t{16});
+    snapshot.sp = sp;
+    // Pixels are 0 or 1, see DXYN.
+    for (auto& pixel: snapshot.gfx) in.get(pixel, std::uint8_t{1});
+    in.get(snapshot.delay_timer);
+    in.get(snapshot.sound_timer);
+    in.get(snapshot.key);
+    in.get(snapshot.wait_for_key);
+    in.get(snapshot.key_pressed);
+    in.get(snapshot.key_pressed_idx, std::uint8_t{15});
+    in.get(snapshot.draw_flag);
+    in.get(snapshot.cycles);
+    in.get(snapshot.tick_base);
+    in.get(snapshot.tick_cycle);
+
+    std::uint64_t rom_hash;
+    in.get(rom_hash);
+    auto profile = machine->chip8.profile();
+    in.get(profile.quirks.shift_uses_vy);
+    in.get(profile.quirks.load_store_increments_i);
+    in.get(profile.quirks.jump_uses_vx);
+    in.get(profile.quirks.clip_sprites);
+    in.get(profile.quirks.logic_resets_vf);
+    in.get(profile.instructions_per_frame);
+    std::uint8_t engine;
+    in.get(engine, static_cast<std::uint8_t>(snooz::Engine::FlatTable));
+    profile.engine = static_cast<snooz::Engine>(engine);
+
+    if (!in.ok() || profile.instructions_per_frame == 0) return fail(machine, CHIP8_ERROR_STATE, "corrupted state");
+    if (rom_hash != machine->rom_hash) return fail(machine, CHIP8_ERROR_STATE, "state of another ROM");
+
+    // The speed first: restore puts the timer clock back on top of it.
+    machine->chip8.apply_profile(profile);
+    machine->chip8.restore(snapshot);
+    machine->keys = 0;
+    for (std::size_t key = 0; key < snapshot.key.size(); key++) {
+        if (snapshot.key[key]) machine->keys |= 1 << key;
+    }
+    machine->error.clear();
+    return CHIP8_OK;
+}
+
+}
@@ -0,0 +1,91 @@
+// C interface of the core, for other languages and runtimes: built as the shared library libchip8. Machines are
+// opaque handles, nothing throws across this interface, and errors are status codes with a message kept in the
+// machine. A machine is used from one thread at a time.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CHIP8_BUILDING_LIBRARY)
+#define CHIP8_API __attribute__((visibility("default")))
+#else
+#define CHIP8_API
+#endif
+
+// Changes when a function, a type or the save state layout changes in an incompatible way.
+#define CHIP8_ABI_VERSION 1
+
+#define CHIP8_SCREEN_WIDTH 64
+#define CHIP8_SCREEN_HEIGHT 32
+
+typedef struct chip8_machine chip8_machine;
+
+typedef enum chip8_status {
+    CHIP8_OK = 0,
+    // Null handle or buffer, key out of range, buffer too small.
+    CHIP8_ERROR_ARGUMENT = 1,
+    // The ROM does not fit in memory.
+    CHIP8_ERROR_ROM = 2,
+    // Not a state saved by this version of the library.
+    CHIP8_ERROR_STATE = 3,
+    // Out of memory, or anything unexpected.
+    CHIP8_ERROR_INTERNAL = 4
+} chip8_status;
+
+// CHIP8_ABI_VERSION of the library loaded, to compare with the one of the header.
+CHIP8_API uint32_t chip8_abi_version(void);
+
+// NULL if out of memory.
+CHIP8_API chip8_machine* chip8_create(void);
+// Accepts NULL.
+CHIP8_API void chip8_destroy(chip8_machine* machine);
+// Message of the last error on that machine, "" if none. Valid until the next call on the machine.
+CHIP8_API const char* chip8_last_error(const chip8_machine* machine);
+
+// Copy the ROM at 0x200 and apply its profile: quirks and speed of known games, defaults otherwise. The rest of the
+// machine is reset.
+CHIP8_API chip8_status chip8_load(chip8_machine* machine, const uint8_t* rom, size_t size);
+// Make CXNN deterministic, for reproducible runs.
+CHIP8_API void chip8_seed(chip8_machine* machine, uint32_t seed);
+// Instructions in a 60Hz frame, also the period of the timers. Set by chip8_load from the profile.
+CHIP8_API uint32_t chip8_instructions_per_frame(const chip8_machine* machine);
+CHIP8_API chip8_status chip8_set_instructions_per_frame(chip8_machine* machine, uint32_t count);
+
+// Run one frame. Return the number of instructions executed: less than a frame when the machine stops.
+CHIP8_API uint64_t chip8_run_frame(chip8_machine* machine);
+// Run up to frames frames in one call. keys is NULL, or one mask per frame set with chip8_set_keys before the frame
+// runs. Return the number of instructions executed.
+CHIP8_API uint64_t chip8_run_frames(chip8_machine* machine, uint32_t frames, const uint16_t* keys);
+// Run up to count instructions, frames or not. Return the number executed.
+CHIP8_API uint64_t chip8_step(chip8_machine* machine, uint64_t count);
+// 0 once the machine stopped, e.g. on an invalid instruction.
+CHIP8_API int chip8_running(const chip8_machine* machine);
+// Instructions executed since the ROM was loaded.
+CHIP8_API uint64_t chip8_cycles(const chip8_machine* machine);
+
+CHIP8_API chip8_status chip8_set_key(chip8_machine* machine, uint32_t key, int pressed);
+// All 16 keys at once: key N is pressed when bit N is set.
+CHIP8_API void chip8_set_keys(chip8_machine* machine, uint16_t keys);
+CHIP8_API uint16_t chip8_keys(const chip8_machine* machine);
+
+// CHIP8_SCREEN_WIDTH x CHIP8_SCREEN_HEIGHT bytes, row after row, 0 for off. Points into the machine: it is up to date
+// after every run and valid until chip8_destroy.
+CHIP8_API const uint8_t* chip8_framebuffer(const chip8_machine* machine);
+// The buzzer sounds during the last instruction executed.
+CHIP8_API int chip8_sound_active(const chip8_machine* machine);
+
+// Size of a saved state, the same for every machine.
+CHIP8_API size_t chip8_state_size(void);
+// Memory, registers, timers and their phase, screen, keys, and the quirks and speed in use. The layout is fixed, the
+// same on every host. Loading checks every field and refuses a state saved with another ROM loaded.
+CHIP8_API chip8_status chip8_save_state(const chip8_machine* machine, void* buffer, size_t size);
+CHIP8_API chip8_status chip8_load_state(chip8_machine* machine, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,164 @@
+#include "lockstep.h"
+#include <cstdio>
+#include <deque>
+#include <ostream>
+#include <random>
+#include "decoder.h"
+
+namespace snooz {
+
+namespace {
+
+std::string indexed(const char* name, std::size_t index) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%s[0x%zx]", name, index);
+    return text;
+}
+
+template <typename Array>
+std::string first_difference(const char* name, const Array& a, const Array& b) {
+    for (std::size_t i = 0; i < a.size(); i++) {
+        if (a[i] != b[i]) return indexed(name, i);
+    }
+    return "";
+}
+
+// Empty when both states are the same.
+std::string first_difference(const Chip8::Snapshot& a, const Chip8::Snapshot& b) {
+    if (a.pc != b.pc) return "pc";
+    if (a.V != b.V) return first_difference("V", a.V, b.V);
+    if (a.I != b.I) return "I";
+    if (a.sp != b.sp) return "sp";
+    if (a.stack != b.stack) return first_difference("stack", a.stack, b.stack);
+    if (a.delay_timer != b.delay_timer) return "delay_timer";
+    if (a.sound_timer != b.sound_timer) return "sound_timer";
+    if (a.wait_for_key != b.wait_for_key || a.key_pressed != b.key_pressed || a.key_pressed_idx != b.key_pressed_idx) {
+        return "FX0A state";
+    }
+    if (a.draw_flag != b.draw_flag) return "draw_flag";
+    if (a.memory != b.memory) return first_difference("memory", a.memory, b.memory);
+    if (a.gfx != b.gfx) return first_difference("gfx", a.gfx, b.gfx);
+    return "";
+}
+
+}
+
+LockstepResult run_lockstep(RomSpan rom, const LockstepOptions& options) {
+    Chip8 reference;
+    Chip8 candidate;
+    for (auto chip8: {&reference, &candidate}) {
+        chip8->seed(options.seed);
+        chip8->load_rom(rom);
+        chip8->set_instructions_per_frame(options.instructions_per_frame);
+    }
+    reference.set_engine(options.reference);
+    candidate.set_engine(options.candidate);
+    if (options.candidate_quirks != nullptr) candidate.set_quirks(*options.candidate_quirks);
+
+    std::minstd_rand input(options.seed + 1);
+    Decoder decoder;
+    char line[Decoder::max_line_size];
+    std::deque<std::pair<std::uint16_t, std::uint16_t>> history;
+
+    LockstepResult result;
+    while (result.instructions < options.instructions && reference.should_continue()) {
+        if (result.instructions > 0 && result.instructions % options.instructions_per_frame == 0) {
+            std::size_t key = input() % 16;
+            auto pressed = input() % 2 == 0;
+            for (auto chip8: {&reference, &candidate}) {
+                if (pressed) {
+                    chip8->set_key_pressed(key);
+                } else {
+                    chip8->set_key_released(key);
+                }
+            }
+        }
+
+        auto pc = reference.pc();
+        auto& memory = reference.memory();
+        history.emplace_back(pc, (memory[pc & 0xFFF] << 8) | memory[(pc + 1) & 0xFFF]);
+        if (history.size() > options.history) history.pop_front();
+
+        reference.emulateCycle();
+        candidate.emulateCycle();
+        result.instructions++;
+
+        // The state hashes are cheap and catch nearly everything. The whole state, which also has the keys and
+        // the FX0A wait, is compared once per frame or when the hashes differ.
+        std::string difference;
+        if (reference.state_hash() != candidate.state_hash()
+                || result.instructions % options.instructions_per_frame == 0) {
+            difference = first_difference(reference.snapshot(), candidate.snapshot());
+        }
+        if (difference.empty() && reference.should_continue() != candidate.should_continue()) {
+            difference = "should_continue";
+        }
+        if (!difference.empty()) {
+            result.diverged = true;
+            result.difference = difference;
+            for (auto& instruction: history) {
+                decoder.format(instruction.second, instruction.first, line, sizeof(line));
+                result.trace.emplace_back(line);
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint8_t> random_program(std::uint32_t seed, std::size_t instructions) {
+    std::minstd_rand random(seed);
+    std::vector<std::uint8_t> program;
+    program.reserve(instructions * 2);
+
+    // Somewhere in the program, on an instruction.
+    auto target = [&] { return static_cast<std::uint16_t>(0x200 + 2 * (random() % instructions)); };
+
+    for (std::size_t i = 0; i < instructions; i++) {
+        std::uint16_t opcode = random() & 0xFFFF;
+        switch (opcode & 0xF000) {
+        case 0x0000:
+            opcode = random() % 2 ? 0x00E0 : 0x00EE;
+            break;
+        case 0x1000:
+        case 0x2000:
+            opcode = (opcode & 0xF000) | target();
+            break;
+        case 0xB000:
+            // V0 is added: keep some margin.
+            opcode = 0xB000 | (target() & 0x0FF0);
+            break;
+        case 0x8000: {
+            static const std::uint8_t operations[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+            opcode = (opcode & 0xFFF0) | operations[random() % 9];
+            break;
+        }
+        case 0xE000:
+            opcode = (opcode & 0xFF00) | (random() % 2 ? 0x9E : 0xA1);
+            break;
+        case 0xF000: {
+            static const std::uint8_t operations[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65};
+            opcode = (opcode & 0xFF00) | operations[random() % 9];
+            break;
+        }
+        default:
+            break;
+        }
+        program.push_back(opcode >> 8);
+        program.push_back(opcode & 0xFF);
+    }
+    return program;
+}
+
+void write_report(std::ostream& out, const std::string& name, const LockstepResult& result) {
+    if (!result.diverged) {
+        out << name << ": same state after " << result.instructions << " instructions\n";
+        return;
+    }
+    out << name << ": " << result.difference << " differs after instruction " << result.instructions << '\n';
+    for (auto& line: result.trace) {
+        out << "    " << line << '\n';
+    }
+}
+
+}
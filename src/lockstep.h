@@ -0,0 +1,44 @@
+// Differential testing of the execution engines: two Chip8 run the same ROM with the same inputs, one instruction
+// at a time, and their state hashes are compared after every instruction.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "chip_8.h"
+
+namespace snooz {
+
+struct LockstepOptions {
+    Engine reference{Engine::Reference};
+    Engine candidate{Engine::FlatTable};
+    std::uint64_t instructions{20000};
+    std::uint32_t seed{0};
+    // Instructions between two timer ticks. A random key changes state on each tick.
+    std::uint32_t instructions_per_frame{10};
+    // Instructions kept for the report.
+    std::size_t history{16};
+    // Optional, quirks of the candidate instead of the ROM profile's: the differences they make show up as
+    // divergences.
+    const Quirks* candidate_quirks{nullptr};
+};
+
+struct LockstepResult {
+    std::uint64_t instructions{0};
+    bool diverged{false};
+    // First part of the state that differs, like "V3" or "memory[0x2f0]".
+    std::string difference;
+    // Last instructions before the divergence, formatted by the Decoder. The last one caused it.
+    std::vector<std::string> trace;
+};
+
+LockstepResult run_lockstep(RomSpan rom, const LockstepOptions& options);
+
+// Random but mostly valid instructions, with jumps and calls kept inside the program.
+std::vector<std::uint8_t> random_program(std::uint32_t seed, std::size_t instructions);
+
+void write_report(std::ostream& out, const std::string& name, const LockstepResult& result);
+
+}
@@ -1,11 +1,28 @@
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <thread>
 #include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include "cfg.h"
 #include "chip_8.h"
+#include <sstream>
 #include <unordered_map>
+#include "emulator_thread.h"
+#include "deflicker.h"
+#include "headless.h"
+#include "renderer.h"
+#include "rom_analysis.h"
+#include "rom_library.h"
+#include "terminal.h"
+#include "video_export.h"
 using namespace snooz;
 
+#include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 #define DEBUG 1
 
@@ -31,39 +48,83 @@ std::unordered_map<int, size_t> keyboard_mapping = {
     {sf::Keyboard::V, 0xF},
 };
 
-void update_pixels(Chip8& chip, std::vector<sf::RectangleShape>& rectangles) {
+// The screen is drawn by the software renderer into a texture: one upload per frame instead of a shape per pixel.
+// Called on every window frame, new emulator frame or not, so that the deflicker fades go on.
+void update_pixels(const Frame& frame, Deflicker* deflicker, Renderer& renderer, std::vector<std::uint32_t>& pixels,
+                   sf::Texture& texture) {
+    auto view = FramebufferView::of(frame.gfx);
+    if (deflicker != nullptr) view = deflicker->process(view);
+    renderer.render(view, RgbaTarget{pixels.data(), 64 * zoom, 32 * zoom, 64 * zoom});
+    texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+}
 
-    auto gfx = chip.gfx();
+std::string frame_state(const Frame& frame) {
+    std::stringstream ss;
+    ss << "I: " << frame.I << '\n';
+    ss << "Registers:\n";
+    for (size_t i=0; i < frame.registers.size(); i++) {
+        ss << i << ": " << std::to_string(frame.registers[i]) << " - ";
+    }
+    ss << '\n' << "pc: " << std::hex << frame.pc  << " - opcode: " << frame.opcode;
+    return ss.str();
+}
 
-    std::array<std::array<bool, 64>, 32> pixel_state;
-    for (int i = 0; i < pixel_state.size(); i++) {
-        for (int col = 0; col < pixel_state[i].size(); col++) {
-                pixel_state[i][col] = gfx[col + i*64];
-        }
+// Plays what the core thread writes in the ring. Small chunks keep the latency low: SFML queues three of them.
+class BuzzerStream : public sf::SoundStream {
+public:
+    explicit BuzzerStream(AudioRing& ring): ring_(ring) {
+        initialize(1, audio_sample_rate);
     }
 
-    rectangles.clear();
-    for (int row = 0; row < pixel_state.size(); row++) {
-        for (int col = 0; col < pixel_state[row].size(); col++) {
-            if (pixel_state[row][col]) {
-                rectangles.emplace_back(sf::Vector2f(zoom, zoom));
-                rectangles.back().setFillColor(sf::Color::White);
-                rectangles.back().move(col * zoom, row * zoom);
-            }
-        }
+private:
+    bool onGetData(Chunk& data) override {
+        read_audio(ring_, samples_.data(), samples_.size());
+        data.samples = samples_.data();
+        data.sampleCount = samples_.size();
+        return true;
     }
 
-}
+    void onSeek(sf::Time) override {}
+
+    AudioRing& ring_;
+    std::array<sf::Int16, audio_chunk_size> samples_;
+};
 
 sf::Font FONT;
 
 void setup_graphics();
 void print_text(std::string text_str, sf::RenderWindow& window);
+int run_headless(const std::string& game, int argc, char** argv);
+int run_terminal(const std::string& game, int argc, char** argv);
+int analyze(int argc, char** argv);
+std::uint64_t parse_number(const std::string& value, std::uint64_t max);
+
+int run(int argc, char** argv);
 
 int main(int argc, char** argv)
 {
-    if (argc != 3) {
-            std::cerr << "Usage: " << argv[0] << "(run|print) <SOURCE>\n";
+    try {
+        return run(argc, argv);
+    } catch (const RomError& error) {
+        std::cerr << error.what() << '\n';
+        return -1;
+    }
+}
+
+void print_usage(const char* program)
+{
+    std::cerr << "Usage: " << program << "(run|print|trace) <SOURCE>\n";
+    std::cerr << "       " << program << " run <SOURCE> [--debug-server SOCKET] [--timerfd] [--pacer-stats] [--deflicker DECAY]\n";
+    std::cerr << "       " << program << " term <SOURCE> [--braille] [--deflicker DECAY]\n";
+    std::cerr << "       " << program << " analyze [--dot] <SOURCE|DIRECTORY|ARCHIVE>...\n";
+    std::cerr << "       " << program << " headless <SOURCE> [--frames N] [--instructions N] [--input FILE] [--seed N] [--profile FILE] [--wav FILE]\n";
+    std::cerr << "           [--video FILE.y4m|FILE.gif|FILE.rgba] [--video-scale N] [--deflicker DECAY]\n";
+}
+
+int run(int argc, char** argv)
+{
+    if (argc < 3) {
+            print_usage(argv[0]);
             return -1;
     }
 
@@ -71,9 +132,33 @@ int main(int argc, char** argv)
     std::string game(argv[2]);
 
     if (mode == "print") {
+        // Follow the control flow so that sprites are not shown as instructions.
+        RomLibrary library;
+        auto rom = resolve_rom(game, library);
         Decoder decoder;
-        decoder.load_game(game);
-        decoder.decode();
+        std::string listing;
+        write_listing(listing, build_cfg(rom.data, rom.size), rom.data, decoder);
+        std::cout << listing;
+        return 0;
+    }
+
+    if (mode == "analyze") {
+        return analyze(argc, argv);
+    }
+
+    if (mode == "headless") {
+        return run_headless(game, argc, argv);
+    }
+
+    if (mode == "term") {
+        return run_terminal(game, argc, argv);
+    }
+
+    if (mode == "trace") {
+        // Turn a binary trace written by `run` into text.
+        std::ifstream input(game, std::ios::binary);
+        Decoder decoder;
+        print_trace(std::cout, read_trace(input), decoder);
         return 0;
     }
 
@@ -83,9 +168,68 @@ int main(int argc, char** argv)
     snooz::Chip8 chip8;
     chip8.load_game(game);
 
-    std::vector<sf::RectangleShape> rectangles;
-    //update_pixels(chip8, rectangles);
+    AudioRing audio_ring;
+    RingSink audio_sink(audio_ring);
+    Buzzer buzzer(audio_sink);
+    BuzzerStream sound(audio_ring);
+    sound.play();
+
+    // The core runs on its own thread. This thread only handles events and drawing.
+    EmulatorThread emulator(chip8);
+    Debugger debugger;
+    emulator.set_buzzer(&buzzer);
+    emulator.set_debugger(&debugger);
+    std::unique_ptr<DebugServer> debug_server;
+    bool pacer_stats = false;
+    // Out of 256, 0 to turn it off. See Deflicker.
+    int deflicker_decay = 176;
+    for (int i = 3; i < argc; i++) {
+        std::string option(argv[i]);
+        if ((option == "--debug-server" || option == "--deflicker") && i + 1 == argc) {
+            std::cerr << "Missing value for " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+        if (option == "--debug-server") {
+            try {
+                debug_server.reset(new DebugServer(argv[++i]));
+            } catch (const std::runtime_error& error) {
+                // Path too long, or already taken.
+                std::cerr << error.what() << '\n';
+                return -1;
+            }
+            emulator.set_debug_server(debug_server.get());
+        } else if (option == "--timerfd") {
+            emulator.set_use_timerfd(true);
+        } else if (option == "--pacer-stats") {
+            pacer_stats = true;
+        } else if (option == "--deflicker") {
+            std::string value(argv[++i]);
+            try {
+                deflicker_decay = static_cast<int>(parse_number(value, 255));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid value " << value << " for " << option << '\n';
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else {
+            // Like headless and term: a mistyped option is not silently ignored.
+            std::cerr << "Unknown option " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    emulator.start();
+
+    Renderer renderer;
+    std::unique_ptr<Deflicker> deflicker;
+    if (deflicker_decay > 0) deflicker.reset(new Deflicker(static_cast<std::uint8_t>(deflicker_decay)));
+    std::vector<std::uint32_t> pixels(64 * zoom * 32 * zoom);
+    sf::Texture texture;
+    texture.create(64 * zoom, 32 * zoom);
+    sf::Sprite screen(texture);
     sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "SFML works!");
+    window.setFramerateLimit(60);
 
     bool is_debug = false;
     std::string debug_text = "";
@@ -105,17 +249,22 @@ int main(int argc, char** argv)
                 if (event.key.code == sf::Keyboard::Space){
                     // Do something here
                     is_debug = !is_debug;
+                    emulator.set_paused(is_debug);
                     if (!is_debug) debug_text = "";
                 }
 
                 if (keyboard_mapping.find((int)event.key.code) != keyboard_mapping.end()) {
-                    chip8.set_key_pressed(keyboard_mapping[static_cast<int>(event.key.code)]);
+                    emulator.push_key(keyboard_mapping[static_cast<int>(event.key.code)], true);
                 }
                 // Debug prints
                 if (is_debug) {
                     switch (event.key.code) {
                     case sf::Keyboard::Num0:
-                            debug_text = std::to_string(chip8.register_value(0x00));
+                            debug_text = std::to_string(emulator.frame().registers[0x00]);
+                            break;
+                    case sf::Keyboard::N:
+                            // Single step. The state shows up with the next frame.
+                            emulator.step();
                             break;
                     default:
                         break;
@@ -126,41 +275,48 @@ int main(int argc, char** argv)
             if (event.type == sf::Event::EventType::KeyReleased) {
 
                 if (keyboard_mapping.find((int)event.key.code) != keyboard_mapping.end()) {
-                    chip8.set_key_released(keyboard_mapping[static_cast<int>(event.key.code)]);
+                    emulator.push_key(keyboard_mapping[static_cast<int>(event.key.code)], false);
                 }
 
             }
         }
 
-        if (!is_debug) {
-            chip8.emulateCycle();
-
+        // Pick up the latest frame if the core published one. Never blocks.
+        if (emulator.update_frame() && is_debug) {
+            debug_text = frame_state(emulator.frame());
+        }
+        update_pixels(emulator.frame(), deflicker.get(), renderer, pixels, texture);
+        if (!is_debug && emulator.paused()) {
+            // The debugger hit a breakpoint.
+            is_debug = true;
+        }
 
-            window.clear();
-            // Update the screen only if there is a change. Then redraw
-            if (chip8.draw_flag()) {
-                update_pixels(chip8, rectangles);
-                // meh. save some cpu cycles.
-                chip8.set_draw_flag(false);
-            }
-            for (auto& rectangle: rectangles) {
-                window.draw(rectangle);
-            }
+        window.clear();
+        if (!is_debug) {
+            window.draw(screen);
 
 #ifdef DEBUG
-            print_text(chip8.print_state(), window);
+            print_text(frame_state(emulator.frame()), window);
 #endif
-            window.display();
-
-            chip8.decrease_timers();
-            std::this_thread::sleep_for(std::chrono::milliseconds(loop_delta_time));
         } else {
-            window.clear();
             print_text(debug_text, window);
-            window.display();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
+        window.display();
+    }
+
+    emulator.stop();
+    sound.stop();
+
+    if (pacer_stats) {
+        auto jitter = emulator.frame_jitter();
+        std::cout << "frame pacing over " << jitter.frames << " frames, deviation from 16.67ms: p50 " << jitter.p50
+                  << "ms p90 " << jitter.p90 << "ms p99 " << jitter.p99 << "ms max " << jitter.max << "ms\n";
     }
+
+#if CHIP8_TRACE_LEVEL > CHIP8_TRACE_OFF
+    std::ofstream trace_output("chip8.trace", std::ios::binary);
+    write_trace(trace_output, chip8.trace().records());
+#endif
     return 0;
 }
 
@@ -176,6 +332,263 @@ int main(int argc, char** argv)
 //
 //    return 0;
 //}
+// Static analysis of one or more ROMs (directories and archives are expanded), analyzed in parallel.
+// JSON by default, Graphviz with --dot.
+int analyze(int argc, char** argv) {
+    bool dot = false;
+    std::vector<std::pair<std::string, std::vector<std::uint8_t>>> roms;
+    for (int i = 2; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--dot") {
+            dot = true;
+            continue;
+        }
+
+        RomLibrary library;
+        if (arg.find(':') != std::string::npos) {
+            auto rom = resolve_rom(arg, library);
+            roms.emplace_back(arg, std::vector<std::uint8_t>(rom.begin(), rom.end()));
+            continue;
+        }
+        library = RomLibrary::open(arg);
+        for (auto& entry: library.entries()) {
+            roms.emplace_back(entry.name, std::vector<std::uint8_t>(entry.rom.begin(), entry.rom.end()));
+        }
+    }
+
+    auto analyses = analyze_corpus(roms);
+    if (dot) {
+        for (auto& analysis: analyses) write_dot(std::cout, analysis);
+    } else {
+        write_json(std::cout, analyses);
+    }
+    return 0;
+}
+
+// Decimal digits only, up to max. Throw std::invalid_argument or std::out_of_range: std::stoull alone takes "-1"
+// and "12abc".
+std::uint64_t parse_number(const std::string& value, std::uint64_t max) {
+    if (value.empty() || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        throw std::invalid_argument(value);
+    }
+    auto number = std::stoull(value);
+    if (number > max) throw std::out_of_range(value);
+    return number;
+}
+
+// No SFML at all in there. Print the result in a `key: value` format easy to grep.
+int run_headless(const std::string& game, int argc, char** argv) {
+    HeadlessOptions options;
+    std::uint32_t seed = 0;
+    std::string profile_path;
+    std::unique_ptr<WavWriter> wav;
+    std::string video_path;
+    VideoOptions video_options;
+    for (int i = 3; i < argc; i += 2) {
+        std::string option(argv[i]);
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+        std::string value(argv[i + 1]);
+        try {
+            if (option == "--frames") {
+                options.frames = parse_number(value, UINT64_MAX);
+            } else if (option == "--instructions") {
+                options.instructions = parse_number(value, UINT64_MAX);
+            } else if (option == "--input") {
+                std::ifstream script(value);
+                if (!script) {
+                    std::cerr << "Cannot open input script " << value << '\n';
+                    return -1;
+                }
+                try {
+                    options.input = parse_input_script(script);
+                } catch (const std::invalid_argument& error) {
+                    std::cerr << "Invalid input script " << value << ", " << error.what() << '\n';
+                    return -1;
+                }
+            } else if (option == "--seed") {
+                seed = static_cast<std::uint32_t>(parse_number(value, UINT32_MAX));
+            } else if (option == "--wav") {
+                wav.reset(new WavWriter(value));
+            } else if (option == "--video") {
+                video_path = value;
+            } else if (option == "--video-scale") {
+                video_options.scale = std::max<std::size_t>(1, parse_number(value, 64));
+            } else if (option == "--deflicker") {
+                video_options.deflicker = static_cast<std::uint8_t>(parse_number(value, 255));
+            } else if (option == "--profile") {
+#ifdef CHIP8_PROFILE
+                profile_path = value;
+#else
+                std::cerr << "The profiler is not compiled in. Configure with -DCHIP8_PROFILE=ON\n";
+                return -1;
+#endif
+            } else {
+                std::cerr << "Unknown option " << option << '\n';
+                print_usage(argv[0]);
+                return -1;
+            }
+        } catch (const std::logic_error&) {
+            // Not a number, or out of range.
+            std::cerr << "Invalid value " << value << " for " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        } catch (const std::runtime_error& error) {
+            // A file that cannot be written.
+            std::cerr << error.what() << " for " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if (options.frames == 0 && options.instructions == 0) {
+        options.frames = 600;
+    }
+
+    std::unique_ptr<Buzzer> buzzer;
+    if (wav) {
+        buzzer.reset(new Buzzer(*wav));
+        options.buzzer = buzzer.get();
+    }
+
+    std::unique_ptr<VideoExporter> video;
+    if (!video_path.empty()) {
+        video_options.format = video_format_for(video_path);
+        try {
+            video.reset(new VideoExporter(video_path, 64, 32, video_options));
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << '\n';
+            return -1;
+        }
+        options.video = video.get();
+    }
+
+    snooz::Chip8 chip8;
+    chip8.seed(seed);
+    chip8.load_game(game);
+    auto result = snooz::run_headless(chip8, options);
+    if (video) {
+        try {
+            video->finish();
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << '\n';
+            return -1;
+        }
+    }
+
+    std::cout << "profile: " << chip8.profile().name << '\n';
+    std::cout << "instructions: " << result.instructions << '\n';
+    std::cout << "frames: " << result.frames << '\n';
+    std::cout << "seconds: " << result.seconds << '\n';
+    std::cout << "mips: " << result.mips() << '\n';
+    if (video) std::cout << "video_frames: " << video->frames() << '\n';
+    std::cout << std::hex << std::setfill('0');
+    std::cout << "framebuffer_hash: " << std::setw(16) << result.framebuffer_hash << '\n';
+    std::cout << "memory_hash: " << std::setw(16) << result.memory_hash << '\n';
+
+#ifdef CHIP8_PROFILE
+    if (!profile_path.empty()) {
+        std::ofstream profile(profile_path);
+        Decoder decoder;
+        chip8.profiler().report(profile, decoder, chip8.memory());
+    }
+#endif
+    return 0;
+}
+
+// Same core thread as `run`, drawn in the terminal. Terminals only send characters, with the keyboard repeat, and
+// no key release: a key stays pressed for a few frames after each character.
+int run_terminal(const std::string& game, int argc, char** argv) {
+    constexpr int key_hold_frames = 8;
+    const std::chrono::microseconds period(16667);
+
+    auto mode = CellMode::HalfBlock;
+    int deflicker_decay = 176;
+    for (int i = 3; i < argc; i++) {
+        std::string option(argv[i]);
+        if (option == "--deflicker" && i + 1 == argc) {
+            std::cerr << "Missing value for " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+        if (option == "--braille") {
+            mode = CellMode::Braille;
+        } else if (option == "--deflicker") {
+            std::string value(argv[++i]);
+            try {
+                deflicker_decay = static_cast<int>(parse_number(value, 255));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid value " << value << " for " << option << '\n';
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else {
+            std::cerr << "Unknown option " << option << '\n';
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    snooz::Chip8 chip8;
+    chip8.load_game(game);
+    std::unique_ptr<RawTerminal> terminal;
+    try {
+        terminal.reset(new RawTerminal);
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << '\n';
+        return -1;
+    }
+
+    EmulatorThread emulator(chip8);
+    emulator.start();
+
+    std::unique_ptr<Deflicker> deflicker;
+    if (deflicker_decay > 0) deflicker.reset(new Deflicker(static_cast<std::uint8_t>(deflicker_decay)));
+    // Below a title line.
+    TerminalRenderer renderer(mode, 2, 1);
+    std::string output = "\x1b[1;1H" + game + " - Esc to quit";
+    std::array<int, 16> held{};
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+
+    auto deadline = std::chrono::steady_clock::now();
+    bool quit = false;
+    while (!quit) {
+        deadline += period;
+        for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now()) {
+            auto typed = terminal->read(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+            // Ctrl-C, or Esc alone: escape sequences of other keys come in one read.
+            if (typed.find('\x03') != std::string::npos || typed == "\x1b") quit = true;
+            for (auto c: typed) {
+                auto key = terminal_key(c);
+                if (key < 0) continue;
+                if (held[key] == 0) emulator.push_key(key, true);
+                held[key] = key_hold_frames;
+            }
+        }
+        for (std::size_t key = 0; key < held.size(); key++) {
+            if (held[key] > 0 && --held[key] == 0) emulator.push_key(key, false);
+        }
+
+        emulator.update_frame();
+        auto view = FramebufferView::of(emulator.frame().gfx);
+        if (deflicker) view = deflicker->process(view);
+        renderer.render(view, output);
+        terminal->write(output);
+        bytes += output.size();
+        frames++;
+        output.clear();
+    }
+
+    emulator.stop();
+    terminal.reset();
+    std::cout << "terminal output: " << (frames > 0 ? bytes / frames : 0) << " bytes per frame over " << frames
+              << " frames\n";
+    return 0;
+}
+
 void setup_graphics() {
     assert(FONT.loadFromFile("/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf"));
 }
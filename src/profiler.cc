@@ -0,0 +1,129 @@
+#include "profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+#include "decoder.h"
+
+namespace snooz {
+
+constexpr std::size_t Profiler::class_count;
+constexpr std::uint64_t Profiler::sample_period;
+
+namespace {
+const char* const class_names[Profiler::class_count] = {
+        "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+        "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+        "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+        "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+        "unknown",
+};
+constexpr std::size_t unknown_class = Profiler::class_count - 1;
+}
+
+std::size_t Profiler::opcode_class(std::uint16_t opcode) {
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        if (opcode == 0x00E0) return 0;
+        if ((opcode & 0x00FF) == 0x00EE) return 1;
+        return unknown_class;
+    case 0x8000:
+        switch (opcode & 0x000F) {
+        case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7:
+            return 9 + (opcode & 0x000F);
+        case 0xE:
+            return 17;
+        default:
+            return unknown_class;
+        }
+    case 0xE000:
+        if ((opcode & 0x00FF) == 0x9E) return 23;
+        if ((opcode & 0x00FF) == 0xA1) return 24;
+        return unknown_class;
+    case 0xF000:
+        switch (opcode & 0x00FF) {
+        case 0x07: return 25;
+        case 0x0A: return 26;
+        case 0x15: return 27;
+        case 0x18: return 28;
+        case 0x1E: return 29;
+        case 0x29: return 30;
+        case 0x33: return 31;
+        case 0x55: return 32;
+        case 0x65: return 33;
+        default: return unknown_class;
+        }
+    case 0x9000: return 18;
+    case 0xA000: return 19;
+    case 0xB000: return 20;
+    case 0xC000: return 21;
+    case 0xD000: return 22;
+    default:
+        // 1NNN to 7XNN
+        return 2 + ((opcode >> 12) - 1);
+    }
+}
+
+const char* Profiler::class_name(std::size_t opcode_class) {
+    return opcode_class < class_count ? class_names[opcode_class] : "invalid";
+}
+
+void Profiler::reset() {
+    instructions_ = 0;
+    class_counts_.fill(0);
+    class_ticks_.fill(0);
+    class_samples_.fill(0);
+    pc_counts_.fill(0);
+}
+
+void Profiler::report(std::ostream& out, Decoder& decoder, const std::array<std::uint8_t, 4096>& memory,
+                      std::size_t hot_pcs) const {
+    std::uint64_t total = 0;
+    for (auto count: class_counts_) total += count;
+    if (total == 0) {
+        out << "No instruction executed\n";
+        return;
+    }
+
+    std::vector<std::size_t> classes;
+    for (std::size_t i = 0; i < class_count; i++) {
+        if (class_counts_[i] > 0) classes.push_back(i);
+    }
+    std::sort(classes.begin(), classes.end(), [this](std::size_t a, std::size_t b) {
+        return class_counts_[a] > class_counts_[b];
+    });
+
+    out << "Opcode classes (" << std::dec << total << " instructions)\n";
+    out << "class        count   share  ticks/op\n";
+    for (auto op_class: classes) {
+        out << std::left << std::setw(8) << class_names[op_class] << std::right
+            << std::setw(10) << class_counts_[op_class] << ' '
+            << std::fixed << std::setprecision(2) << std::setw(6) << 100.0 * class_counts_[op_class] / total << "% ";
+        if (class_samples_[op_class] > 0) {
+            out << std::setw(9) << class_ticks_[op_class] / class_samples_[op_class];
+        } else {
+            out << std::setw(9) << '-';
+        }
+        out << '\n';
+    }
+
+    std::vector<std::uint16_t> pcs;
+    for (std::uint16_t pc = 0; pc < pc_counts_.size(); pc++) {
+        if (pc_counts_[pc] > 0) pcs.push_back(pc);
+    }
+    std::sort(pcs.begin(), pcs.end(), [this](std::uint16_t a, std::uint16_t b) {
+        return pc_counts_[a] > pc_counts_[b];
+    });
+    if (pcs.size() > hot_pcs) pcs.resize(hot_pcs);
+
+    out << "\nHot addresses\n";
+    out << "     count   share  disassembly\n";
+    for (auto pc: pcs) {
+        std::uint16_t opcode = (memory[pc] << 8) | memory[(pc + 1) & 0xFFF];
+        out << std::setw(10) << pc_counts_[pc] << ' '
+            << std::setw(6) << 100.0 * pc_counts_[pc] / total << "%  "
+            << decoder.interpret(opcode, pc) << '\n';
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+// Execution profile of a ROM: how often each opcode class and each address runs, and roughly how much
+// time each handler takes. Only compiled in when CHIP8_PROFILE is defined (cmake -DCHIP8_PROFILE=ON).
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace snooz {
+
+class Decoder;
+
+class Profiler {
+public:
+    // One entry per instruction handler, plus one for unknown opcodes.
+    static constexpr std::size_t class_count = 35;
+    // Handler time is measured on one instruction out of sample_period.
+    static constexpr std::uint64_t sample_period = 64;
+
+    static std::size_t opcode_class(std::uint16_t opcode);
+    static const char* class_name(std::size_t opcode_class);
+
+    // Call before dispatching. Return the start tick if that instruction is sampled, 0 otherwise.
+    std::uint64_t enter(std::uint16_t pc, std::uint16_t opcode) {
+        pc_counts_[pc & 0xFFF]++;
+        class_counts_[opcode_class(opcode)]++;
+        if (++instructions_ % sample_period != 0) return 0;
+        return ticks();
+    }
+
+    // Call after dispatching with the value returned by enter().
+    void leave(std::uint64_t start, std::uint16_t opcode) {
+        if (start == 0) return;
+        auto op_class = opcode_class(opcode);
+        class_ticks_[op_class] += ticks() - start;
+        class_samples_[op_class]++;
+    }
+
+    void reset();
+
+    // Opcode classes sorted by count, then the `hot_pcs` most executed addresses disassembled.
+    void report(std::ostream& out, Decoder& decoder, const std::array<std::uint8_t, 4096>& memory,
+                std::size_t hot_pcs = 32) const;
+
+    std::uint64_t class_executions(std::size_t opcode_class) const { return class_counts_[opcode_class]; }
+    std::uint64_t pc_executions(std::uint16_t pc) const { return pc_counts_[pc & 0xFFF]; }
+
+private:
+    static std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    std::uint64_t instructions_{0};
+    std::array<std::uint64_t, class_count> class_counts_{};
+    std::array<std::uint64_t, class_count> class_ticks_{};
+    std::array<std::uint64_t, class_count> class_samples_{};
+    std::array<std::uint64_t, 4096> pc_counts_{};
+};
+
+}
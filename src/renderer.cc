@@ -0,0 +1,166 @@
+#include "renderer.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace snooz {
+
+namespace {
+
+// `count` copies of color. The bulk of the work at large scales: one 16 bytes store per 4 pixels.
+inline std::uint32_t* fill(std::uint32_t* out, std::uint32_t color, std::size_t count) {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    auto colors = _mm_set1_epi32(static_cast<int>(color));
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), colors);
+    }
+#endif
+    for (; i < count; i++) out[i] = color;
+    return out + count;
+}
+
+}
+
+Palette default_palette() {
+    return {{rgba(0, 0, 0), rgba(255, 255, 255), rgba(255, 64, 64), rgba(255, 255, 64)}};
+}
+
+Renderer::Renderer(const Palette& palette, Filter filter):
+        filter_(filter) {
+    set_palette(palette);
+}
+
+void Renderer::set_palette(const Palette& palette) {
+    palette_ = palette;
+    auto background = palette.colors[0];
+    auto foreground = palette.colors[1];
+    for (unsigned value = 0; value < 256; value++) {
+        planes_colors_[value] = palette.colors[value & 3];
+
+        // Per channel, from the background to the foreground.
+        std::uint32_t color = 0;
+        for (unsigned shift = 0; shift < 32; shift += 8) {
+            auto from = (background >> shift) & 0xFF;
+            auto to = (foreground >> shift) & 0xFF;
+            auto channel = (from * (255 - value) + to * value + 127) / 255;
+            color |= channel << shift;
+        }
+        intensity_colors_[value] = color;
+    }
+    invalidate();
+}
+
+void Renderer::set_filter(Filter filter) {
+    filter_ = filter;
+    invalidate();
+}
+
+std::size_t Renderer::render(const FramebufferView& view, const RgbaTarget& target) {
+    if (view.width == 0 || view.height == 0) return 0;
+    auto scale = std::min(target.width / view.width, target.height / view.height);
+    if (scale == 0) return 0;
+
+    // Scale2x doubles first, the rest of the scale is nearest.
+    auto smooth = filter_ == Filter::Scale2x && scale >= 2;
+    auto image_width = smooth ? view.width * 2 * (scale / 2) : view.width * scale;
+    auto image_height = smooth ? view.height * 2 * (scale / 2) : view.height * scale;
+    auto x = (target.width - image_width) / 2;
+    auto y = (target.height - image_height) / 2;
+
+    auto same = valid_ && target.pixels == last_target_.pixels && target.width == last_target_.width
+                && target.height == last_target_.height && target.stride == last_target_.stride
+                && view.width == last_width_ && view.height == last_height_ && view.format == last_format_;
+    colors_ = view.format == PixelFormat::Intensity ? intensity_colors_.data() : planes_colors_.data();
+
+    std::size_t first = 0;
+    std::size_t last = view.height;
+    if (same) {
+        auto row_changed = [&](std::size_t row) {
+            return std::memcmp(view.pixels + row * view.stride, previous_.data() + row * view.width, view.width) != 0;
+        };
+        while (first < last && !row_changed(first)) first++;
+        if (first == last) return scale;
+        while (!row_changed(last - 1)) last--;
+    } else {
+        // Only the borders: the image covers the rest.
+        auto background = palette_.colors[0];
+        for (std::size_t row = 0; row < target.height; row++) {
+            auto line = target.pixels + row * target.stride;
+            if (row < y || row >= y + image_height) {
+                fill(line, background, target.width);
+            } else {
+                fill(line, background, x);
+                fill(line + x + image_width, background, target.width - x - image_width);
+            }
+        }
+    }
+
+    previous_.resize(view.width * view.height);
+    for (auto row = first; row < last; row++) {
+        std::memcpy(previous_.data() + row * view.width, view.pixels + row * view.stride, view.width);
+    }
+    valid_ = true;
+    last_target_ = target;
+    last_width_ = view.width;
+    last_height_ = view.height;
+    last_format_ = view.format;
+
+    if (smooth) {
+        scale2x(view);
+        // A doubled pixel also depends on the rows above and below.
+        first = first > 0 ? first - 1 : 0;
+        last = std::min(last + 1, view.height);
+        draw_rows(doubled_.data(), view.width * 2, view.width * 2, first * 2, last * 2, scale / 2, target, x, y);
+    } else {
+        draw_rows(view.pixels, view.stride, view.width, first, last, scale, target, x, y);
+    }
+    return scale;
+}
+
+void Renderer::draw_rows(const std::uint8_t* pixels, std::size_t stride, std::size_t width, std::size_t first,
+                         std::size_t last, std::size_t scale, const RgbaTarget& target, std::size_t x,
+                         std::size_t y) {
+    auto row_bytes = width * scale * sizeof(std::uint32_t);
+    for (auto row = first; row < last; row++) {
+        auto line = target.pixels + (y + row * scale) * target.stride + x;
+        auto out = line;
+        auto source = pixels + row * stride;
+        for (std::size_t column = 0; column < width; column++) {
+            out = fill(out, colors_[source[column]], scale);
+        }
+        // The other lines of the row are the same.
+        for (std::size_t copy = 1; copy < scale; copy++) {
+            std::memcpy(line + copy * target.stride, line, row_bytes);
+        }
+    }
+}
+
+void Renderer::scale2x(const FramebufferView& view) {
+    auto width = view.width;
+    auto height = view.height;
+    doubled_.resize(width * height * 4);
+    auto at = [&](std::size_t x, std::size_t y) { return view.pixels[y * view.stride + x]; };
+
+    for (std::size_t y = 0; y < height; y++) {
+        for (std::size_t x = 0; x < width; x++) {
+            // Neighbours, the pixel itself out of the screen.
+            auto p = at(x, y);
+            auto a = y > 0 ? at(x, y - 1) : p;
+            auto b = x + 1 < width ? at(x + 1, y) : p;
+            auto c = x > 0 ? at(x - 1, y) : p;
+            auto d = y + 1 < height ? at(x, y + 1) : p;
+
+            auto out = doubled_.data() + (y * 2) * (width * 2) + x * 2;
+            out[0] = static_cast<std::uint8_t>(c == a && c != d && a != b ? a : p);
+            out[1] = static_cast<std::uint8_t>(a == b && a != c && b != d ? b : p);
+            out[width * 2] = static_cast<std::uint8_t>(d == c && d != b && c != a ? c : p);
+            out[width * 2 + 1] = static_cast<std::uint8_t>(b == d && b != a && d != c ? d : p);
+        }
+    }
+}
+
+}
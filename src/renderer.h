@@ -0,0 +1,106 @@
+// Software renderer: draws a CHIP-8 framebuffer, scaled up, into an RGBA buffer. For video export, screenshots and
+// remote display, where there is no SFML window.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace snooz {
+
+enum class PixelFormat {
+    // As the core stores them. The low two bits are the planes of XO-CHIP: 0 is the background, 1 and 2 a single
+    // plane, 3 both. CHIP-8 and SCHIP only use 0 and 1.
+    Planes,
+    // 0 to 255, from the background to the first plane color. See Deflicker.
+    Intensity,
+};
+
+// Pixels, one byte each.
+struct FramebufferView {
+    const std::uint8_t* pixels;
+    std::size_t width;
+    std::size_t height;
+    // Bytes from one row to the next.
+    std::size_t stride;
+    PixelFormat format{PixelFormat::Planes};
+
+    static FramebufferView of(const std::array<std::uint8_t, 64*32>& gfx) { return {gfx.data(), 64, 32, 64}; }
+};
+
+// RGBA bytes in memory order, as SFML textures and most encoders take them. Little endian hosts.
+constexpr std::uint32_t rgba(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) {
+    return static_cast<std::uint32_t>(r) | static_cast<std::uint32_t>(g) << 8 | static_cast<std::uint32_t>(b) << 16
+           | static_cast<std::uint32_t>(a) << 24;
+}
+
+// Color of each pixel value, see PixelFormat.
+struct Palette {
+    std::array<std::uint32_t, 4> colors;
+
+    static Palette monochrome(std::uint32_t background, std::uint32_t foreground) {
+        return {{background, foreground, foreground, foreground}};
+    }
+};
+
+// White on black, and the usual XO-CHIP red and yellow for the second plane.
+Palette default_palette();
+
+enum class Filter {
+    Nearest,
+    // EPX/Scale2x first, then nearest. Smooths diagonals without blurring. Needs a scale of 2 at least.
+    Scale2x,
+};
+
+// Where to draw. stride is in pixels.
+struct RgbaTarget {
+    std::uint32_t* pixels;
+    std::size_t width;
+    std::size_t height;
+    std::size_t stride;
+};
+
+class Renderer {
+public:
+    explicit Renderer(const Palette& palette = default_palette(), Filter filter = Filter::Nearest);
+
+    void set_palette(const Palette& palette);
+    void set_filter(Filter filter);
+    // Color of every byte value in that format. Also the color table of indexed outputs, like GIF.
+    const std::array<std::uint32_t, 256>& colors(PixelFormat format) const {
+        return format == PixelFormat::Intensity ? intensity_colors_ : planes_colors_;
+    }
+
+    // Draw the framebuffer scaled by the largest integer that fits, centered on the background color. Only the rows
+    // that changed since the previous call are drawn again, as long as the target and the sizes are the same.
+    // Return the scale, 0 if the target is smaller than the framebuffer (nothing is drawn).
+    std::size_t render(const FramebufferView& view, const RgbaTarget& target);
+    // The next render draws everything, e.g. when something else wrote to the target.
+    void invalidate() { valid_ = false; }
+
+private:
+    void draw_rows(const std::uint8_t* pixels, std::size_t stride, std::size_t width, std::size_t first,
+                   std::size_t last, std::size_t scale, const RgbaTarget& target, std::size_t x, std::size_t y);
+    void scale2x(const FramebufferView& view);
+
+    Palette palette_;
+    Filter filter_;
+    // Color of each byte, for both formats.
+    std::array<std::uint32_t, 256> planes_colors_;
+    std::array<std::uint32_t, 256> intensity_colors_;
+    const std::uint32_t* colors_{planes_colors_.data()};
+
+    // What the last render drew, to find the rows that changed.
+    bool valid_{false};
+    RgbaTarget last_target_{};
+    std::size_t last_width_{0};
+    std::size_t last_height_{0};
+    PixelFormat last_format_{PixelFormat::Planes};
+    std::vector<std::uint8_t> previous_;
+    // Scale2x output, in pixel values.
+    std::vector<std::uint8_t> doubled_;
+};
+
+}
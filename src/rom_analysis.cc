@@ -0,0 +1,394 @@
+#include "rom_analysis.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+
+namespace snooz {
+
+namespace {
+
+// Value of I at some point of the program: not reached yet, known constant, or anything.
+constexpr int I_undefined = -2;
+constexpr int I_varies = -1;
+
+int meet(int a, int b) {
+    if (a == I_undefined) return b;
+    if (b == I_undefined) return a;
+    return a == b ? a : I_varies;
+}
+
+std::uint16_t opcode_at(const std::vector<std::uint8_t>& rom, std::uint16_t origin, std::uint16_t address) {
+    return (rom[address - origin] << 8) | rom[address - origin + 1];
+}
+
+std::vector<std::vector<int>> predecessors(const ControlFlowGraph& cfg) {
+    std::vector<std::vector<int>> preds(cfg.blocks.size());
+    for (size_t i = 0; i < cfg.blocks.size(); i++) {
+        for (auto successor: cfg.blocks[i].successors) {
+            auto index = cfg.block_index(successor);
+            if (index >= 0) preds[index].push_back(static_cast<int>(i));
+        }
+    }
+    return preds;
+}
+
+// Entry of the program and of every subroutine. They are not reached through flow edges.
+std::vector<int> entries(const ControlFlowGraph& cfg) {
+    std::vector<int> result;
+    for (size_t i = 0; i < cfg.blocks.size(); i++) {
+        auto start = cfg.blocks[i].start;
+        if (start == cfg.origin || cfg.has(start, ControlFlowGraph::Subroutine)) {
+            result.push_back(static_cast<int>(i));
+        }
+    }
+    return result;
+}
+
+void build_call_graph(RomAnalysis& analysis) {
+    auto& cfg = analysis.cfg;
+    analysis.call_graph[cfg.origin];
+
+    // Attribute every block to the entries it can be reached from without following calls.
+    for (auto entry: entries(cfg)) {
+        auto function = cfg.blocks[entry].start;
+        auto& callees = analysis.call_graph[function];
+        std::vector<bool> seen(cfg.blocks.size(), false);
+        std::vector<int> stack{entry};
+        while (!stack.empty()) {
+            auto index = stack.back();
+            stack.pop_back();
+            if (seen[index]) continue;
+            seen[index] = true;
+
+            auto& block = cfg.blocks[index];
+            callees.insert(block.calls.begin(), block.calls.end());
+            for (auto successor: block.successors) {
+                auto next = cfg.block_index(successor);
+                if (next >= 0) stack.push_back(next);
+            }
+        }
+    }
+}
+
+// Iterative dominators (Cooper, Harvey, Kennedy) over a virtual root linked to every entry.
+std::vector<int> dominators(const ControlFlowGraph& cfg, const std::vector<std::vector<int>>& preds) {
+    auto count = static_cast<int>(cfg.blocks.size());
+    auto root = count;
+
+    // Reverse post order from the root.
+    std::vector<int> order;
+    std::vector<int> state(count, 0);
+    for (auto entry: entries(cfg)) {
+        std::vector<std::pair<int, size_t>> stack{{entry, 0}};
+        if (state[entry] != 0) continue;
+        state[entry] = 1;
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            auto& successors = cfg.blocks[top.first].successors;
+            if (top.second < successors.size()) {
+                auto next = cfg.block_index(successors[top.second++]);
+                if (next >= 0 && state[next] == 0) {
+                    state[next] = 1;
+                    stack.push_back({next, 0});
+                }
+            } else {
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    std::vector<int> position(count + 1, -1);
+    position[root] = -1;
+    for (size_t i = 0; i < order.size(); i++) position[order[i]] = static_cast<int>(i);
+
+    std::vector<int> idom(count + 1, -2);
+    idom[root] = root;
+    auto is_entry = std::vector<bool>(count, false);
+    for (auto entry: entries(cfg)) {
+        is_entry[entry] = true;
+        idom[entry] = root;
+    }
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (a != root && (b == root || position[a] > position[b])) a = idom[a];
+            while (b != root && (a == root || position[b] > position[a])) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto node: order) {
+            if (is_entry[node]) continue;
+            int new_idom = -2;
+            for (auto pred: preds[node]) {
+                if (idom[pred] == -2) continue;
+                new_idom = new_idom == -2 ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != -2 && idom[node] != new_idom) {
+                idom[node] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
+
+bool dominates(const std::vector<int>& idom, int dominator, int node) {
+    auto root = static_cast<int>(idom.size()) - 1;
+    while (node != root && node >= 0) {
+        if (node == dominator) return true;
+        node = idom[node];
+    }
+    return false;
+}
+
+void find_loops(RomAnalysis& analysis) {
+    auto& cfg = analysis.cfg;
+    auto preds = predecessors(cfg);
+    auto idom = dominators(cfg, preds);
+
+    // Natural loop of every back edge. Back edges to the same header are merged.
+    std::map<int, std::set<int>> bodies;
+    for (size_t from = 0; from < cfg.blocks.size(); from++) {
+        for (auto successor: cfg.blocks[from].successors) {
+            auto header = cfg.block_index(successor);
+            if (header < 0 || idom[from] == -2 || !dominates(idom, header, static_cast<int>(from))) continue;
+
+            auto& body = bodies[header];
+            body.insert(header);
+            std::vector<int> stack{static_cast<int>(from)};
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+                if (!body.insert(node).second) continue;
+                for (auto pred: preds[node]) stack.push_back(pred);
+            }
+        }
+    }
+
+    analysis.loop_depth.assign(cfg.blocks.size(), 0);
+    for (auto& entry: bodies) {
+        Loop loop;
+        loop.header = entry.first;
+        loop.blocks.assign(entry.second.begin(), entry.second.end());
+        loop.depth = 0;
+        for (auto block: loop.blocks) analysis.loop_depth[block]++;
+        analysis.loops.push_back(loop);
+    }
+    for (auto& loop: analysis.loops) {
+        loop.depth = analysis.loop_depth[loop.header];
+    }
+}
+
+// Forward data flow of the value of I over the blocks, then collect the FX33/FX55 targets.
+void find_writes(RomAnalysis& analysis, const std::vector<std::uint8_t>& rom) {
+    auto& cfg = analysis.cfg;
+    std::vector<int> in(cfg.blocks.size(), I_undefined);
+    for (auto entry: entries(cfg)) {
+        // Subroutines can be called with any I.
+        in[entry] = cfg.blocks[entry].start == cfg.origin ? 0 : I_varies;
+    }
+
+    auto transfer = [&](const BasicBlock& block, int I, bool record) {
+        for (std::uint16_t address = block.start; address < block.end; address += 2) {
+            auto opcode = opcode_at(rom, cfg.origin, address);
+            auto x = (opcode & 0x0F00) >> 8;
+            switch (opcode & 0xF000) {
+            case 0xA000:
+                I = opcode & 0x0FFF;
+                break;
+            case 0x2000:
+                // The callee can change I.
+                I = I_varies;
+                break;
+            case 0xF000:
+                switch (opcode & 0x00FF) {
+                case 0x1E:
+                case 0x29:
+                    I = I_varies;
+                    break;
+                case 0x33:
+                case 0x55: {
+                    if (!record) break;
+                    auto count = (opcode & 0x00FF) == 0x33 ? 3 : x + 1;
+                    if (I < 0) {
+                        analysis.writes_unknown_address = true;
+                    } else {
+                        for (int i = 0; i < count; i++) analysis.writable.set((I + i) & 0xFFF);
+                    }
+                    break;
+                }
+                }
+                break;
+            }
+        }
+        return I;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < cfg.blocks.size(); i++) {
+            if (in[i] == I_undefined) continue;
+            auto out = transfer(cfg.blocks[i], in[i], false);
+            for (auto successor: cfg.blocks[i].successors) {
+                auto next = cfg.block_index(successor);
+                if (next < 0) continue;
+                auto merged = meet(in[next], out);
+                if (merged != in[next]) {
+                    in[next] = merged;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cfg.blocks.size(); i++) {
+        if (in[i] != I_undefined) transfer(cfg.blocks[i], in[i], true);
+    }
+    for (size_t address = 0; address < analysis.writable.size(); address++) {
+        if (analysis.writable[address] && cfg.is_code(address)) {
+            analysis.self_modifying = true;
+            break;
+        }
+    }
+}
+
+void json_string(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (auto c: value) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+}
+
+RomAnalysis analyze_rom(const std::string& name, const std::vector<std::uint8_t>& rom) {
+    RomAnalysis analysis;
+    analysis.name = name;
+    analysis.cfg = build_cfg(rom);
+    for (auto& block: analysis.cfg.blocks) {
+        if (block.indirect_jump) analysis.has_indirect_jumps = true;
+    }
+
+    build_call_graph(analysis);
+    find_loops(analysis);
+    find_writes(analysis, rom);
+    return analysis;
+}
+
+std::vector<RomAnalysis> analyze_corpus(const std::vector<std::pair<std::string, std::vector<std::uint8_t>>>& roms,
+                                        unsigned threads) {
+    std::vector<RomAnalysis> results(roms.size());
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, std::max<size_t>(roms.size(), 1));
+
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (auto i = next++; i < roms.size(); i = next++) {
+            results[i] = analyze_rom(roms[i].first, roms[i].second);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) pool.emplace_back(worker);
+    worker();
+    for (auto& thread: pool) thread.join();
+    return results;
+}
+
+void write_dot(std::ostream& out, const RomAnalysis& analysis) {
+    auto& cfg = analysis.cfg;
+    out << "digraph ";
+    json_string(out, analysis.name);
+    out << " {\n    node [shape=box, fontname=monospace];\n" << std::hex;
+    for (size_t i = 0; i < cfg.blocks.size(); i++) {
+        auto& block = cfg.blocks[i];
+        out << "    b" << block.start << " [label=\"" << block.start << "-" << block.end - 2;
+        if (analysis.loop_depth[i] > 0) out << "\\nloop depth " << std::dec << analysis.loop_depth[i] << std::hex;
+        out << "\"";
+        if (cfg.has(block.start, ControlFlowGraph::Subroutine) || block.start == cfg.origin) out << ", style=bold";
+        out << "];\n";
+        for (auto successor: block.successors) {
+            out << "    b" << block.start << " -> b" << successor << ";\n";
+        }
+        for (auto call: block.calls) {
+            out << "    b" << block.start << " -> b" << call << " [style=dashed];\n";
+        }
+    }
+    out << "}\n" << std::dec;
+}
+
+void write_json(std::ostream& out, const RomAnalysis& analysis) {
+    auto& cfg = analysis.cfg;
+    out << "{\"name\": ";
+    json_string(out, analysis.name);
+    out << ", \"size\": " << cfg.length
+        << ", \"safe_to_compile\": " << (analysis.safe_to_compile() ? "true" : "false")
+        << ", \"self_modifying\": " << (analysis.self_modifying ? "true" : "false")
+        << ", \"writes_unknown_address\": " << (analysis.writes_unknown_address ? "true" : "false")
+        << ", \"indirect_jumps\": " << (analysis.has_indirect_jumps ? "true" : "false");
+
+    out << ",\n  \"blocks\": [";
+    for (size_t i = 0; i < cfg.blocks.size(); i++) {
+        auto& block = cfg.blocks[i];
+        out << (i == 0 ? "" : ",") << "\n    {\"start\": " << block.start << ", \"end\": " << block.end
+            << ", \"loop_depth\": " << analysis.loop_depth[i] << ", \"successors\": [";
+        for (size_t s = 0; s < block.successors.size(); s++) out << (s == 0 ? "" : ", ") << block.successors[s];
+        out << "], \"calls\": [";
+        for (size_t c = 0; c < block.calls.size(); c++) out << (c == 0 ? "" : ", ") << block.calls[c];
+        out << "], \"returns\": " << (block.returns ? "true" : "false") << "}";
+    }
+
+    out << "],\n  \"call_graph\": {";
+    bool first = true;
+    for (auto& entry: analysis.call_graph) {
+        out << (first ? "" : ", ") << "\"" << entry.first << "\": [";
+        first = false;
+        bool first_callee = true;
+        for (auto callee: entry.second) {
+            out << (first_callee ? "" : ", ") << callee;
+            first_callee = false;
+        }
+        out << "]";
+    }
+
+    out << "},\n  \"loops\": [";
+    for (size_t i = 0; i < analysis.loops.size(); i++) {
+        auto& loop = analysis.loops[i];
+        out << (i == 0 ? "" : ", ") << "{\"header\": " << cfg.blocks[loop.header].start << ", \"depth\": " << loop.depth
+            << ", \"blocks\": " << loop.blocks.size() << "}";
+    }
+
+    out << "],\n  \"writable\": [";
+    // Ranges of consecutive writable addresses.
+    first = true;
+    for (size_t address = 0; address < analysis.writable.size(); address++) {
+        if (!analysis.writable[address]) continue;
+        auto end = address;
+        while (end + 1 < analysis.writable.size() && analysis.writable[end + 1]) end++;
+        out << (first ? "" : ", ") << "[" << address << ", " << end << "]";
+        first = false;
+        address = end;
+    }
+    out << "]}";
+}
+
+void write_json(std::ostream& out, const std::vector<RomAnalysis>& analyses) {
+    out << "[";
+    for (size_t i = 0; i < analyses.size(); i++) {
+        out << (i == 0 ? "\n" : ",\n");
+        write_json(out, analyses[i]);
+    }
+    out << "\n]\n";
+}
+
+}
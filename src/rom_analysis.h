@@ -0,0 +1,62 @@
+// Static analysis of a ROM on top of the control flow graph: call graph, loops, and which addresses the
+// program can write through I. Used to decide which ROMs can be cached or compiled aggressively.
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cfg.h"
+
+namespace snooz {
+
+struct Loop {
+    // Block index of the loop header (target of the back edge).
+    int header;
+    // Block indices of the loop body, header included. Sorted.
+    std::vector<int> blocks;
+    // 1 for outermost loops.
+    int depth;
+};
+
+struct RomAnalysis {
+    std::string name;
+    ControlFlowGraph cfg;
+
+    // Entry point (0x200) and subroutines, to the subroutines they call.
+    std::map<std::uint16_t, std::set<std::uint16_t>> call_graph;
+
+    std::vector<Loop> loops;
+    // Number of loops containing each block, indexed like cfg.blocks.
+    std::vector<int> loop_depth;
+
+    // Addresses that FX33/FX55 can write to.
+    std::bitset<4096> writable;
+    // A write happens with an I that cannot be computed statically, so any address may be written.
+    bool writes_unknown_address{false};
+    // Some writable address is also reachable code.
+    bool self_modifying{false};
+    // At least one BNNN: part of the control flow is only known at runtime.
+    bool has_indirect_jumps{false};
+
+    // The code found statically is all the code, and it never changes.
+    bool safe_to_compile() const { return !writes_unknown_address && !self_modifying && !has_indirect_jumps; }
+};
+
+RomAnalysis analyze_rom(const std::string& name, const std::vector<std::uint8_t>& rom);
+
+// Analyze every ROM, spread over `threads` threads (0 means one per core). Results are in the input order.
+std::vector<RomAnalysis> analyze_corpus(const std::vector<std::pair<std::string, std::vector<std::uint8_t>>>& roms,
+                                        unsigned threads = 0);
+
+// Graphviz: one node per basic block, plain edges for the flow, dashed edges for calls.
+void write_dot(std::ostream& out, const RomAnalysis& analysis);
+void write_json(std::ostream& out, const RomAnalysis& analysis);
+void write_json(std::ostream& out, const std::vector<RomAnalysis>& analyses);
+
+}
@@ -0,0 +1,272 @@
+#include "rom_library.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "hash.h"
+
+namespace snooz {
+
+// Read-only mapping of a whole file.
+struct RomLibrary::Mapping {
+    const std::uint8_t* data{nullptr};
+    std::size_t size{0};
+
+    explicit Mapping(const std::string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw RomError("Cannot open " + path + ": " + std::strerror(errno));
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw RomError("Cannot stat " + path + ": " + std::strerror(errno));
+        }
+        size = static_cast<std::size_t>(info.st_size);
+        if (size > 0) {
+            auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw RomError("Cannot map " + path + ": " + std::strerror(errno));
+            }
+            data = static_cast<const std::uint8_t*>(address);
+        }
+        ::close(fd);
+    }
+
+    ~Mapping() {
+        if (data != nullptr) munmap(const_cast<std::uint8_t*>(data), size);
+    }
+};
+
+namespace {
+
+constexpr std::uint32_t local_header_signature = 0x04034b50;
+constexpr std::uint32_t central_header_signature = 0x02014b50;
+constexpr std::uint32_t end_of_central_directory_signature = 0x06054b50;
+
+std::uint16_t read16(const std::uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+std::uint32_t read32(const std::uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+bool is_directory(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+bool exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+std::string basename(const std::string& path) {
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Entry of the central directory, before its content is resolved.
+struct ZipEntry {
+    std::string name;
+    std::uint16_t method;
+    std::uint32_t crc;
+    std::size_t compressed_size;
+    std::size_t size;
+    std::size_t data_offset;
+};
+
+void inflate_raw(const std::uint8_t* in, std::size_t in_size, std::uint8_t* out, std::size_t out_size,
+                 const std::string& name) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Negative window bits: raw deflate data, no zlib header.
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) throw RomError("Cannot initialize zlib");
+
+    stream.next_in = const_cast<Bytef*>(in);
+    stream.avail_in = static_cast<uInt>(in_size);
+    stream.next_out = out;
+    stream.avail_out = static_cast<uInt>(out_size);
+    auto status = inflate(&stream, Z_FINISH);
+    auto produced = stream.total_out;
+    inflateEnd(&stream);
+
+    if (status != Z_STREAM_END || produced != out_size) {
+        throw RomError("Corrupted entry " + name + " in archive");
+    }
+}
+
+}
+
+RomLibrary::RomLibrary() = default;
+RomLibrary::~RomLibrary() = default;
+RomLibrary::RomLibrary(RomLibrary&&) = default;
+RomLibrary& RomLibrary::operator=(RomLibrary&&) = default;
+
+RomLibrary RomLibrary::open(const std::string& path) {
+    RomLibrary library;
+    if (is_directory(path)) {
+        library.open_directory(path);
+    } else {
+        library.open_archive(path);
+    }
+    library.index();
+    return library;
+}
+
+void RomLibrary::open_archive(const std::string& path) {
+    mapping_.reset(new Mapping(path));
+    auto data = mapping_->data;
+    auto size = mapping_->size;
+
+    if (size < 4 || read32(data) != local_header_signature) {
+        // Not a zip: a single ROM.
+        entries_.push_back(RomEntry{basename(path), 0, RomSpan{data, size}});
+        return;
+    }
+
+    // The end of central directory record is at the end, followed by an optional comment.
+    std::size_t eocd = std::string::npos;
+    for (std::size_t i = size >= 22 ? size - 22 : 0; i + 22 <= size && i + 0xFFFF + 22 >= size; i--) {
+        if (read32(data + i) == end_of_central_directory_signature) {
+            eocd = i;
+            break;
+        }
+        if (i == 0) break;
+    }
+    if (eocd == std::string::npos) throw RomError(path + " is not a valid zip archive");
+
+    auto count = read16(data + eocd + 10);
+    std::size_t offset = read32(data + eocd + 16);
+
+    std::vector<ZipEntry> zip_entries;
+    std::size_t inflated_size = 0;
+    for (std::uint16_t i = 0; i < count; i++) {
+        if (offset + 46 > size || read32(data + offset) != central_header_signature) {
+            throw RomError(path + ": corrupted central directory");
+        }
+        auto header = data + offset;
+        ZipEntry entry;
+        entry.method = read16(header + 10);
+        entry.crc = read32(header + 16);
+        entry.compressed_size = read32(header + 20);
+        entry.size = read32(header + 24);
+        auto name_length = read16(header + 28);
+        auto extra_length = read16(header + 30);
+        auto comment_length = read16(header + 32);
+        std::size_t local_offset = read32(header + 42);
+        if (offset + 46 + name_length > size) throw RomError(path + ": corrupted central directory");
+        entry.name.assign(reinterpret_cast<const char*>(header + 46), name_length);
+        offset += 46 + name_length + extra_length + comment_length;
+
+        // Directories.
+        if (entry.name.empty() || entry.name.back() == '/') continue;
+
+        if (local_offset + 30 > size || read32(data + local_offset) != local_header_signature) {
+            throw RomError(path + ": corrupted entry " + entry.name);
+        }
+        entry.data_offset = local_offset + 30 + read16(data + local_offset + 26) + read16(data + local_offset + 28);
+        if (entry.data_offset + entry.compressed_size > size) throw RomError(path + ": truncated entry " + entry.name);
+
+        if (entry.method == 8) {
+            // Deflate does not expand more than 1032 times: anything claiming more is corrupted, not a reason to
+            // allocate gigabytes.
+            if (entry.size / 1032 > entry.compressed_size) throw RomError(path + ": corrupted entry " + entry.name);
+            inflated_size += entry.size;
+        } else if (entry.method != 0) {
+            throw RomError(path + ": unsupported compression for " + entry.name);
+        }
+        zip_entries.push_back(entry);
+    }
+
+    // Decompress everything once. The arena is not resized afterwards so the spans stay valid.
+    arena_.resize(inflated_size);
+    std::size_t arena_offset = 0;
+    for (auto& entry: zip_entries) {
+        RomSpan rom;
+        if (entry.method == 0) {
+            rom = RomSpan{data + entry.data_offset, entry.compressed_size};
+        } else {
+            inflate_raw(data + entry.data_offset, entry.compressed_size, arena_.data() + arena_offset, entry.size, entry.name);
+            rom = RomSpan{arena_.data() + arena_offset, entry.size};
+            arena_offset += entry.size;
+        }
+        if (crc32(0, rom.data, static_cast<uInt>(rom.size)) != entry.crc) {
+            throw RomError(path + ": bad checksum for " + entry.name);
+        }
+        entries_.push_back(RomEntry{entry.name, 0, rom});
+    }
+}
+
+void RomLibrary::open_directory(const std::string& path) {
+    auto dir = opendir(path.c_str());
+    if (dir == nullptr) throw RomError("Cannot open " + path + ": " + std::strerror(errno));
+
+    std::vector<std::string> names;
+    while (auto entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if (name[0] != '.' && !is_directory(path + "/" + name)) names.push_back(name);
+    }
+    closedir(dir);
+
+    // Read every file back to back in the arena, and only then create the spans.
+    std::vector<std::size_t> offsets;
+    for (auto& name: names) {
+        Mapping file(path + "/" + name);
+        offsets.push_back(arena_.size());
+        arena_.insert(arena_.end(), file.data, file.data + file.size);
+    }
+    offsets.push_back(arena_.size());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        entries_.push_back(RomEntry{names[i], 0, RomSpan{arena_.data() + offsets[i], offsets[i + 1] - offsets[i]}});
+    }
+}
+
+void RomLibrary::index() {
+    std::sort(entries_.begin(), entries_.end(), [](const RomEntry& a, const RomEntry& b) { return a.name < b.name; });
+    for (size_t i = 0; i < entries_.size(); i++) {
+        auto& entry = entries_[i];
+        entry.hash = fnv1a(entry.rom.data, entry.rom.size);
+        by_name_[entry.name] = i;
+        by_hash_.emplace(entry.hash, i);
+    }
+}
+
+const RomEntry* RomLibrary::find(const std::string& name) const {
+    auto it = by_name_.find(name);
+    return it == by_name_.end() ? nullptr : &entries_[it->second];
+}
+
+const RomEntry* RomLibrary::find(std::uint64_t hash) const {
+    auto it = by_hash_.find(hash);
+    return it == by_hash_.end() ? nullptr : &entries_[it->second];
+}
+
+const RomEntry& RomLibrary::at(const std::string& name) const {
+    auto entry = find(name);
+    if (entry == nullptr) throw RomError("No ROM named " + name);
+    return *entry;
+}
+
+RomSpan resolve_rom(const std::string& source, RomLibrary& library) {
+    auto colon = source.rfind(':');
+    if (!exists(source) && colon != std::string::npos && exists(source.substr(0, colon))) {
+        library = RomLibrary::open(source.substr(0, colon));
+        return library.at(source.substr(colon + 1)).rom;
+    }
+
+    library = RomLibrary::open(source);
+    if (library.entries().size() != 1 || is_directory(source)) {
+        throw RomError(source + " contains several ROMs. Pick one with " + source + ":NAME");
+    }
+    return library.entries().front().rom;
+}
+
+}
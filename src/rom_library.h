@@ -0,0 +1,80 @@
+// Collection of ROMs loaded once from a zip archive (like c8games.zip) or a directory, and indexed by name
+// and by content hash. Batch runs and game switching then get the bytes from memory, never from the disk.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace snooz {
+
+// Any problem reading or loading a ROM: missing file, corrupted archive, ROM too large...
+class RomError : public std::runtime_error {
+public:
+    explicit RomError(const std::string& what): std::runtime_error(what) {}
+};
+
+// Non owning view on the bytes of a ROM.
+struct RomSpan {
+    const std::uint8_t* data;
+    std::size_t size;
+
+    const std::uint8_t* begin() const { return data; }
+    const std::uint8_t* end() const { return data + size; }
+};
+
+struct RomEntry {
+    std::string name;
+    // FNV-1a of the content. See hash.h
+    std::uint64_t hash;
+    RomSpan rom;
+};
+
+class RomLibrary {
+public:
+    RomLibrary();
+    ~RomLibrary();
+    RomLibrary(RomLibrary&&);
+    RomLibrary& operator=(RomLibrary&&);
+    RomLibrary(const RomLibrary&) = delete;
+    RomLibrary& operator=(const RomLibrary&) = delete;
+
+    // Open a zip archive (stored or deflated entries) or a directory of ROMs. Throw RomError.
+    static RomLibrary open(const std::string& path);
+
+    // nullptr if not found. The spans stay valid as long as the library is alive.
+    const RomEntry* find(const std::string& name) const;
+    const RomEntry* find(std::uint64_t hash) const;
+
+    // Throw RomError if there is no ROM with that name.
+    const RomEntry& at(const std::string& name) const;
+
+    // Sorted by name.
+    const std::vector<RomEntry>& entries() const { return entries_; }
+
+private:
+    struct Mapping;
+
+    void open_archive(const std::string& path);
+    void open_directory(const std::string& path);
+    void index();
+
+    // The archive, mapped in memory. Stored entries point directly in there.
+    std::unique_ptr<Mapping> mapping_;
+    // Decompressed entries and files read from a directory, back to back.
+    std::vector<std::uint8_t> arena_;
+
+    std::vector<RomEntry> entries_;
+    std::unordered_map<std::string, std::size_t> by_name_;
+    std::unordered_map<std::uint64_t, std::size_t> by_hash_;
+};
+
+// `archive.zip:NAME` or `directory:NAME` is looked up in the library opened from the first part.
+// Anything else is a single ROM file. The library keeps the bytes alive.
+RomSpan resolve_rom(const std::string& source, RomLibrary& library);
+
+}
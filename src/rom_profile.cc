@@ -0,0 +1,56 @@
+#include "rom_profile.h"
+#include <algorithm>
+#include <iterator>
+
+namespace snooz {
+
+namespace {
+
+constexpr Quirks none{};
+// BLITZ draws its buildings down to the bottom edge. Wrapped around, they hit the plane at the top.
+constexpr Quirks clipped{false, false, false, true, false};
+
+// The ROMs of games/ (and c8games.zip). idle_skip_safe comes from `main analyze`: no self modifying code and no
+// write through an unknown I. Sorted by hash.
+constexpr RomProfile database[] = {
+    {"TETRIS",   0x04eb2109dc29b1abULL, none,    12, true,  Engine::FlatTable},
+    {"PONG2",    0x0f81c6a74dcd366eULL, none,    10, true,  Engine::FlatTable},
+    {"BLINKY",   0x0fd332d0bc68c9f2ULL, none,    20, false, Engine::FlatTable},
+    {"GUESS",    0x1bbb10c8e5cadbb5ULL, none,    10, true,  Engine::FlatTable},
+    {"MAZE",     0x25e96e1086ce43cbULL, none,    10, true,  Engine::FlatTable},
+    {"BLITZ",    0x29bcab9b664d212bULL, clipped, 10, true,  Engine::FlatTable},
+    {"PUZZLE",   0x36f264b8f72349a6ULL, none,    10, false, Engine::FlatTable},
+    {"TANK",     0x3e2c2d43b296b74cULL, none,    12, true,  Engine::FlatTable},
+    {"HIDDEN",   0x3f58eb4fa83dcd98ULL, none,    10, false, Engine::FlatTable},
+    {"MERLIN",   0x43def5533f6d8d25ULL, none,    10, false, Engine::FlatTable},
+    {"TICTAC",   0x56049e83866b207dULL, none,    10, false, Engine::FlatTable},
+    {"PONG",     0x624b3eed64313f42ULL, none,    10, true,  Engine::FlatTable},
+    {"MISSILE",  0x71cdb8b926f1b988ULL, none,    10, true,  Engine::FlatTable},
+    {"UFO",      0x8d8a02fa3a2ed293ULL, none,    10, true,  Engine::FlatTable},
+    {"INVADERS", 0x8e547ebb12c026b4ULL, none,    15, true,  Engine::FlatTable},
+    {"KALEID",   0xa8e9391ebb18df6fULL, none,    15, false, Engine::FlatTable},
+    {"CONNECT4", 0xadf99268db3c3bc9ULL, none,    10, false, Engine::FlatTable},
+    {"WIPEOFF",  0xb7e1d74b387bede6ULL, none,    15, true,  Engine::FlatTable},
+    {"BRIX",     0xc86e8ff63fce668cULL, none,    10, true,  Engine::FlatTable},
+    {"VBRIX",    0xcdaa32787deaa913ULL, none,    12, true,  Engine::FlatTable},
+    {"15PUZZLE", 0xe59fd57fa44ecb40ULL, none,    10, false, Engine::FlatTable},
+    {"VERS",     0xeae1357f230d90c5ULL, none,    10, true,  Engine::FlatTable},
+    {"SYZYGY",   0xec7ca0de3e110327ULL, none,    15, false, Engine::FlatTable},
+};
+
+constexpr RomProfile unknown{"unknown", 0, none, 10, false, Engine::Reference};
+
+}
+
+const RomProfile& default_profile() {
+    return unknown;
+}
+
+const RomProfile* find_profile(std::uint64_t hash) {
+    auto it = std::lower_bound(std::begin(database), std::end(database), hash, [](const RomProfile& profile, std::uint64_t h) {
+        return profile.hash < h;
+    });
+    return it != std::end(database) && it->hash == hash ? &*it : nullptr;
+}
+
+}
@@ -0,0 +1,50 @@
+// Built-in database of the known ROMs, keyed by content hash: which interpreter quirks they expect and how fast
+// they should run. Chip8 applies the matching profile when a ROM is loaded.
+
+#pragma once
+
+#include <cstdint>
+
+namespace snooz {
+
+// Behaviours that differ between the original COSMAC VIP interpreter and the later ones (CHIP-48, SCHIP).
+// All false is what this emulator always did.
+struct Quirks {
+    // 8XY6/8XYE shift VY and store the result in VX, instead of shifting VX in place.
+    bool shift_uses_vy{false};
+    // FX55/FX65 leave I pointing after the last register written or read.
+    bool load_store_increments_i{false};
+    // BNNN jumps to XNN + VX instead of NNN + V0.
+    bool jump_uses_vx{false};
+    // Sprites are cut at the screen edges instead of wrapping around.
+    bool clip_sprites{false};
+    // 8XY1/8XY2/8XY3 set VF to 0.
+    bool logic_resets_vf{false};
+};
+
+// How Chip8 dispatches an opcode to its handler. Both run the same handlers.
+enum class Engine {
+    // Hash map per opcode group. Slow but obvious, used for unknown ROMs.
+    Reference,
+    // A single 4096 entries table of handlers, indexed by the first nibble and the last byte of the opcode.
+    FlatTable,
+};
+
+struct RomProfile {
+    const char* name;
+    std::uint64_t hash;
+    Quirks quirks;
+    // Instructions executed per 60Hz frame.
+    std::uint32_t instructions_per_frame;
+    // The code never changes at runtime, so a loop that only polls a timer or a key can be skipped over.
+    bool idle_skip_safe;
+    Engine engine;
+};
+
+// Profile of a ROM not in the database.
+const RomProfile& default_profile();
+
+// nullptr if the ROM is unknown. `hash` is the FNV-1a of the whole ROM, see hash.h
+const RomProfile* find_profile(std::uint64_t hash);
+
+}
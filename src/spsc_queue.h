@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace snooz {
+
+/// Wait-free bounded queue for exactly one producer thread and one consumer thread.
+/// Capacity must be a power of two. push() fails instead of blocking when the queue is full.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only.
+    bool push(const T& value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.
+    bool pop(T& value) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer only. Push as many values as there is room for, return how many were pushed.
+    std::size_t push(const T* values, std::size_t count) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto room = Capacity - (tail - head_.load(std::memory_order_acquire));
+        if (count > room) count = room;
+        for (std::size_t i = 0; i < count; i++) {
+            slots_[(tail + i) & (Capacity - 1)] = values[i];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer only. Pop up to count values, return how many were popped.
+    std::size_t pop(T* values, std::size_t count) {
+        auto head = head_.load(std::memory_order_relaxed);
+        auto available = tail_.load(std::memory_order_acquire) - head;
+        if (count > available) count = available;
+        for (std::size_t i = 0; i < count; i++) {
+            values[i] = slots_[(head + i) & (Capacity - 1)];
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Approximate when called from a third thread.
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> slots_{};
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+}
@@ -0,0 +1,174 @@
+#include "terminal.h"
+#include <algorithm>
+#include <cctype>
+#include <poll.h>
+#include <stdexcept>
+#include <termios.h>
+#include <unistd.h>
+
+namespace snooz {
+
+namespace {
+
+// Characters of each half-block pattern: bit 0 is the top pixel, bit 1 the bottom one.
+const char* const half_blocks[] = {" ", "▀", "▄", "█"};
+
+// Cells that did not change between two runs are sent again when that is shorter than moving the cursor.
+constexpr std::size_t max_gap = 2;
+
+void move_to(std::size_t row, std::size_t column, std::string& out) {
+    out += "\x1b[";
+    out += std::to_string(row);
+    out += ';';
+    out += std::to_string(column);
+    out += 'H';
+}
+
+}
+
+TerminalRenderer::TerminalRenderer(CellMode mode, std::size_t row, std::size_t column):
+        mode_(mode),
+        row_(row),
+        column_(column),
+        cell_width_(mode == CellMode::Braille ? 2 : 1),
+        cell_height_(mode == CellMode::Braille ? 4 : 2) {
+}
+
+std::uint8_t TerminalRenderer::cell(std::size_t x, std::size_t y) const {
+    auto pixel = [&](std::size_t dx, std::size_t dy) -> std::uint8_t {
+        auto px = x * cell_width_ + dx;
+        auto py = y * cell_height_ + dy;
+        return px < width_ && py < height_ ? pixels_[py * width_ + px] : 0;
+    };
+    if (mode_ == CellMode::HalfBlock) return pixel(0, 0) | pixel(0, 1) << 1;
+    // Braille dots 1 to 8, as in U+2800 to U+28FF.
+    return pixel(0, 0) | pixel(0, 1) << 1 | pixel(0, 2) << 2 | pixel(1, 0) << 3 | pixel(1, 1) << 4
+           | pixel(1, 2) << 5 | pixel(0, 3) << 6 | pixel(1, 3) << 7;
+}
+
+void TerminalRenderer::put_cell(std::uint8_t cell, std::string& out) const {
+    if (mode_ == CellMode::HalfBlock) {
+        out += half_blocks[cell];
+    } else if (cell == 0) {
+        // Empty braille pattern looks the same, in a third of the bytes.
+        out += ' ';
+    } else {
+        out += static_cast<char>(0xE2);
+        out += static_cast<char>(0xA0 | cell >> 6);
+        out += static_cast<char>(0x80 | (cell & 0x3F));
+    }
+}
+
+void TerminalRenderer::render(const FramebufferView& view, std::string& out) {
+    // Everything is sent when the terminal content is unknown.
+    auto full = !valid_ || view.width != width_ || view.height != height_;
+    if (full) {
+        width_ = view.width;
+        height_ = view.height;
+        pixels_.assign(width_ * height_, 0);
+        cells_.assign(columns() * rows(), 0);
+        valid_ = true;
+    }
+
+    auto threshold = view.format == PixelFormat::Intensity ? 128 : 1;
+    for (std::size_t cell_y = 0; cell_y < rows(); cell_y++) {
+        // Characters are only looked at over the pixel rows that changed.
+        bool dirty = full;
+        for (auto y = cell_y * cell_height_; y < std::min(height_, (cell_y + 1) * cell_height_); y++) {
+            auto source = view.pixels + y * view.stride;
+            auto previous = pixels_.data() + y * width_;
+            for (std::size_t x = 0; x < width_; x++) {
+                std::uint8_t on = source[x] >= threshold;
+                dirty |= on != previous[x];
+                previous[x] = on;
+            }
+        }
+        if (!dirty) continue;
+
+        auto stored = cells_.data() + cell_y * columns();
+        std::size_t x = 0;
+        while (x < columns()) {
+            if (!full && cell(x, cell_y) == stored[x]) {
+                x++;
+                continue;
+            }
+            // A run of changed cells, with short gaps of unchanged ones in it.
+            auto end = x + 1;
+            for (auto next = end; next < columns() && next <= end + max_gap; next++) {
+                if (full || cell(next, cell_y) != stored[next]) end = next + 1;
+            }
+            move_to(row_ + cell_y, column_ + x, out);
+            for (; x < end; x++) {
+                stored[x] = cell(x, cell_y);
+                put_cell(stored[x], out);
+            }
+        }
+    }
+}
+
+struct RawTerminal::Saved {
+    termios attributes;
+};
+
+RawTerminal::RawTerminal() {
+    termios attributes;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &attributes) != 0) {
+        throw std::runtime_error("Standard input is not a terminal");
+    }
+    saved_.reset(new Saved{attributes});
+    attributes.c_iflag &= ~(ICRNL | IXON);
+    attributes.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+    attributes.c_cc[VMIN] = 0;
+    attributes.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &attributes);
+    // Alternate screen, cleared, cursor hidden.
+    write("\x1b[?1049h\x1b[2J\x1b[?25l");
+}
+
+RawTerminal::~RawTerminal() {
+    write("\x1b[?25h\x1b[?1049l");
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_->attributes);
+}
+
+std::string RawTerminal::read(std::chrono::microseconds timeout) {
+    pollfd input{STDIN_FILENO, POLLIN, 0};
+    auto milliseconds = static_cast<int>((timeout.count() + 999) / 1000);
+    std::string typed;
+    if (poll(&input, 1, std::max(0, milliseconds)) <= 0) return typed;
+    char buffer[64];
+    ssize_t count;
+    while ((count = ::read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) typed.append(buffer, count);
+    return typed;
+}
+
+void RawTerminal::write(const std::string& data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        auto count = ::write(STDOUT_FILENO, data.data() + written, data.size() - written);
+        if (count <= 0) return;
+        written += count;
+    }
+}
+
+int terminal_key(char c) {
+    switch (std::tolower(static_cast<unsigned char>(c))) {
+    case '1': return 0x1;
+    case '2': return 0x2;
+    case '3': return 0x3;
+    case 'q': return 0x4;
+    case 'w': return 0x5;
+    case 'e': return 0x6;
+    case 'a': return 0x7;
+    case 's': return 0x8;
+    case 'd': return 0x9;
+    case 'z': return 0xA;
+    case 'x': return 0xB;
+    case 'c': return 0xC;
+    case 'r': return 0xD;
+    case 'f': return 0xE;
+    case 'v': return 0xF;
+    default: return -1;
+    }
+}
+
+}
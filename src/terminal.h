@@ -0,0 +1,79 @@
+// Text frontend, for machines without a display: the framebuffer is drawn with Unicode block or braille characters
+// and only the cells that changed are sent, so that 60 frames per second fit through a slow SSH link.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "renderer.h"
+
+namespace snooz {
+
+enum class CellMode {
+    // One character for 1x2 pixels: 64x16 characters for CHIP-8.
+    HalfBlock,
+    // One character for 2x4 pixels: 32x8 characters. Needs a font with braille patterns.
+    Braille,
+};
+
+class TerminalRenderer {
+public:
+    // The framebuffer is drawn from that terminal position, 1 based.
+    explicit TerminalRenderer(CellMode mode = CellMode::HalfBlock, std::size_t row = 1, std::size_t column = 1);
+
+    // Append to out what brings the terminal from the previous frame to this one: a cursor move and characters for
+    // every run of cells that changed, nothing for the rows that did not. Pixels are on when not 0 in
+    // PixelFormat::Planes, from half the intensity in PixelFormat::Intensity. The terminal colors are left as they are.
+    void render(const FramebufferView& view, std::string& out);
+    // The next render draws every cell, e.g. after the screen was cleared.
+    void invalidate() { valid_ = false; }
+
+    CellMode mode() const { return mode_; }
+    // Characters taken by the last frame.
+    std::size_t columns() const { return (width_ + cell_width_ - 1) / cell_width_; }
+    std::size_t rows() const { return (height_ + cell_height_ - 1) / cell_height_; }
+
+private:
+    std::uint8_t cell(std::size_t x, std::size_t y) const;
+    void put_cell(std::uint8_t cell, std::string& out) const;
+
+    CellMode mode_;
+    std::size_t row_;
+    std::size_t column_;
+    std::size_t cell_width_;
+    std::size_t cell_height_;
+
+    bool valid_{false};
+    std::size_t width_{0};
+    std::size_t height_{0};
+    // Pixels of the last render, 0 or 1, and the pattern of each character on screen.
+    std::vector<std::uint8_t> pixels_;
+    std::vector<std::uint8_t> cells_;
+};
+
+// Standard input in raw mode: no echo, no line buffering, and Ctrl-C comes as a byte instead of a signal. Output goes
+// to the alternate screen, without cursor. The destructor puts everything back.
+class RawTerminal {
+public:
+    // Throw std::runtime_error if standard input is not a terminal.
+    RawTerminal();
+    ~RawTerminal();
+    RawTerminal(const RawTerminal&) = delete;
+    RawTerminal& operator=(const RawTerminal&) = delete;
+
+    // What was typed, waiting at most timeout for the first byte. Empty if nothing came.
+    std::string read(std::chrono::microseconds timeout);
+    void write(const std::string& data);
+
+private:
+    struct Saved;
+    std::unique_ptr<Saved> saved_;
+};
+
+// CHIP-8 key of a typed character, with the same keys as the window, or -1.
+int terminal_key(char c);
+
+}
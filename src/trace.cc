@@ -0,0 +1,58 @@
+#include "trace.h"
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include "decoder.h"
+
+namespace snooz {
+
+void write_trace(std::ostream& out, const std::vector<TraceRecord>& records) {
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TraceRecord));
+}
+
+std::vector<TraceRecord> read_trace(std::istream& in) {
+    std::vector<TraceRecord> records;
+    TraceRecord record;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+void print_trace(std::ostream& out, const std::vector<TraceRecord>& records, Decoder& decoder) {
+    for (auto& record: records) {
+        out << std::dec << std::setw(10) << record.cycle << ' ';
+        if (record.event == TraceEvent::Instruction) {
+            out << decoder.interpret(record.opcode, record.pc) << '\n';
+            continue;
+        }
+
+        out << std::hex << record.pc << '\t';
+        switch (record.event) {
+        case TraceEvent::UnknownOpcode:
+            out << "Unknown opcode " << record.opcode;
+            break;
+        case TraceEvent::KeyPressed:
+            out << "Key pressed " << static_cast<int>(record.arg);
+            break;
+        case TraceEvent::KeyReleased:
+            out << "Key released " << static_cast<int>(record.arg);
+            break;
+        case TraceEvent::KeyCheck:
+            out << "Check key " << static_cast<int>(record.arg) << " (" << decoder.interpret(record.opcode, record.pc) << ")";
+            break;
+        case TraceEvent::StackOverflow:
+            out << "Stack overflow, halted";
+            break;
+        case TraceEvent::StackUnderflow:
+            out << "Stack underflow, halted";
+            break;
+        default:
+            out << "Unknown event " << static_cast<int>(record.event);
+            break;
+        }
+        out << '\n';
+    }
+}
+
+}
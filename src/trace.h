@@ -0,0 +1,92 @@
+// Binary tracing of the emulator. Events are fixed-size records written to a ring buffer owned by
+// each Chip8 instance, and turned into text offline with print_trace().
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Trace levels. Pick one at compile time with -DCHIP8_TRACE_LEVEL=<n> (CMake cache variable of the same
+// name). Everything above the selected level is compiled out, and with CHIP8_TRACE_OFF the Chip8 does
+// not even carry a trace buffer.
+#define CHIP8_TRACE_OFF 0
+// Unknown opcodes.
+#define CHIP8_TRACE_ERROR 1
+// Keyboard events and key checks.
+#define CHIP8_TRACE_INPUT 2
+// Every executed instruction.
+#define CHIP8_TRACE_ALL 3
+
+#ifndef CHIP8_TRACE_LEVEL
+#define CHIP8_TRACE_LEVEL CHIP8_TRACE_OFF
+#endif
+
+namespace snooz {
+
+class Decoder;
+
+enum class TraceEvent : std::uint8_t {
+    Instruction = 0,
+    UnknownOpcode,
+    KeyPressed,
+    KeyReleased,
+    // EX9E/EXA1 checked a key. arg is the key index.
+    KeyCheck,
+    // 2NNN with the 16 levels of stack in use, or 00EE with an empty stack. The chip halts.
+    StackOverflow,
+    StackUnderflow,
+};
+
+struct TraceRecord {
+    std::uint64_t cycle;
+    std::uint16_t pc;
+    std::uint16_t opcode;
+    TraceEvent event;
+    std::uint8_t arg;
+    std::uint8_t padding[2];
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records are written as is to disk");
+
+/// Flight recorder: keeps the last Capacity records, older ones are overwritten.
+/// record() is only called by the thread running the emulator and never blocks nor allocates.
+template <std::size_t Capacity>
+class TraceRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    void record(std::uint64_t cycle, std::uint16_t pc, std::uint16_t opcode, TraceEvent event, std::uint8_t arg) {
+        auto head = head_.load(std::memory_order_relaxed);
+        records_[head & (Capacity - 1)] = TraceRecord{cycle, pc, opcode, event, arg, {0, 0}};
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Copy the recorded events, oldest first. Call it when the emulator is not running.
+    std::vector<TraceRecord> records() const {
+        auto head = head_.load(std::memory_order_acquire);
+        auto count = head < Capacity ? head : Capacity;
+        std::vector<TraceRecord> out;
+        out.reserve(count);
+        for (auto i = head - count; i < head; i++) {
+            out.push_back(records_[i & (Capacity - 1)]);
+        }
+        return out;
+    }
+
+    void clear() { head_.store(0, std::memory_order_release); }
+
+private:
+    std::array<TraceRecord, Capacity> records_;
+    std::atomic<std::size_t> head_{0};
+};
+
+using Trace = TraceRing<1 << 14>;
+
+// Offline tools.
+void write_trace(std::ostream& out, const std::vector<TraceRecord>& records);
+std::vector<TraceRecord> read_trace(std::istream& in);
+// One line per record. Instructions are disassembled with Decoder::interpret.
+void print_trace(std::ostream& out, const std::vector<TraceRecord>& records, Decoder& decoder);
+
+}
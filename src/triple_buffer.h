@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace snooz {
+
+/// Lock-free triple buffer. One producer writes into its own buffer and publishes it,
+/// one consumer picks up the most recent published buffer. Neither side ever waits:
+/// the producer can publish faster than the consumer reads (older frames are dropped)
+/// and the consumer keeps the last frame if nothing new arrived.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // ----------------------------------------------------------------
+    // Producer side
+    // ----------------------------------------------------------------
+    T& write_buffer() { return buffers_[write_]; }
+
+    // Swap the write buffer with the shared middle buffer and flag it as fresh.
+    void publish() {
+        auto previous = middle_.exchange(write_ | fresh_bit, std::memory_order_acq_rel);
+        write_ = previous & index_mask;
+    }
+
+    // ----------------------------------------------------------------
+    // Consumer side
+    // ----------------------------------------------------------------
+
+    // Grab the latest published buffer if there is one. Return true when read_buffer() changed.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+            return false;
+        }
+        auto previous = middle_.exchange(read_, std::memory_order_acq_rel);
+        read_ = previous & index_mask;
+        return true;
+    }
+
+    const T& read_buffer() const { return buffers_[read_]; }
+
+private:
+    static constexpr std::uint8_t index_mask = 0x3;
+    static constexpr std::uint8_t fresh_bit = 0x4;
+
+    std::array<T, 3> buffers_{};
+
+    // Only touched by the producer.
+    alignas(64) std::uint8_t write_{0};
+    // Index of the buffer in transit, plus the fresh bit.
+    alignas(64) std::atomic<std::uint8_t> middle_{1};
+    // Only touched by the consumer.
+    alignas(64) std::uint8_t read_{2};
+};
+
+}
@@ -0,0 +1,489 @@
+#include "video_export.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "deflicker.h"
+
+namespace snooz {
+
+namespace {
+
+using Bytes = std::vector<std::uint8_t>;
+
+// Bounded queue between two threads. pop() returns false once the queue is closed and empty.
+template <typename T>
+class Channel {
+public:
+    explicit Channel(std::size_t capacity): capacity_(capacity) {}
+
+    void push(T value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(value));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        value = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    bool closed_{false};
+};
+
+void write_le16(std::ostream& out, std::size_t value) {
+    out.put(static_cast<char>(value & 0xFF));
+    out.put(static_cast<char>((value >> 8) & 0xFF));
+}
+
+// Get the rendered frames in order, on the writer thread.
+class Encoder {
+public:
+    virtual ~Encoder() = default;
+    virtual void frame(const Bytes& data) = 0;
+    virtual void finish() {}
+};
+
+class RawEncoder : public Encoder {
+public:
+    explicit RawEncoder(std::ostream& out): out_(out) {}
+
+    void frame(const Bytes& data) override {
+        out_.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+private:
+    std::ostream& out_;
+};
+
+class Y4mEncoder : public Encoder {
+public:
+    Y4mEncoder(std::ostream& out, std::size_t width, std::size_t height): out_(out) {
+        out_ << "YUV4MPEG2 W" << width << " H" << height << " F60:1 Ip A1:1 C420jpeg\n";
+    }
+
+    void frame(const Bytes& data) override {
+        out_ << "FRAME\n";
+        out_.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+private:
+    std::ostream& out_;
+};
+
+// Variable length codes, least significant bit first, in sub-blocks of 255 bytes at most.
+class GifBitWriter {
+public:
+    explicit GifBitWriter(std::ostream& out): out_(out) {}
+
+    void write(std::uint32_t code, int size) {
+        bits_ |= code << count_;
+        count_ += size;
+        while (count_ >= 8) {
+            put(static_cast<std::uint8_t>(bits_ & 0xFF));
+            bits_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void flush() {
+        if (count_ > 0) put(static_cast<std::uint8_t>(bits_ & 0xFF));
+        bits_ = 0;
+        count_ = 0;
+        flush_block();
+    }
+
+private:
+    void put(std::uint8_t byte) {
+        block_[size_++] = byte;
+        if (size_ == 255) flush_block();
+    }
+
+    void flush_block() {
+        if (size_ == 0) return;
+        out_.put(static_cast<char>(size_));
+        out_.write(reinterpret_cast<const char*>(block_), size_);
+        size_ = 0;
+    }
+
+    std::ostream& out_;
+    std::uint32_t bits_{0};
+    int count_{0};
+    std::uint8_t block_[255];
+    std::size_t size_{0};
+};
+
+// LZW string table: (prefix code, next byte) -> code, open addressing. At most 4096 - 258 entries between two
+// clear codes, so 8192 slots stay half empty.
+class LzwTable {
+public:
+    LzwTable() { clear(); }
+
+    void clear() { std::fill(keys_.begin(), keys_.end(), -1); }
+
+    int find(int prefix, std::uint8_t byte) const {
+        auto key = (prefix << 8) | byte;
+        for (auto slot = hash(key);; slot = (slot + 1) & mask) {
+            if (keys_[slot] == key) return codes_[slot];
+            if (keys_[slot] < 0) return -1;
+        }
+    }
+
+    void insert(int prefix, std::uint8_t byte, int code) {
+        auto key = (prefix << 8) | byte;
+        auto slot = hash(key);
+        while (keys_[slot] >= 0) slot = (slot + 1) & mask;
+        keys_[slot] = key;
+        codes_[slot] = static_cast<std::int16_t>(code);
+    }
+
+private:
+    static constexpr std::size_t mask = 8191;
+    static std::size_t hash(int key) { return (static_cast<std::uint32_t>(key) * 2654435761u >> 19) & mask; }
+
+    std::array<int, mask + 1> keys_;
+    std::array<std::int16_t, mask + 1> codes_;
+};
+
+class GifEncoder : public Encoder {
+public:
+    GifEncoder(std::ostream& out, std::size_t width, std::size_t height, const std::array<std::uint32_t, 256>& colors):
+            out_(out),
+            width_(width),
+            height_(height) {
+        out_.write("GIF89a", 6);
+        write_le16(out_, width);
+        write_le16(out_, height);
+        // Global color table of 256 entries, background color 0, square pixels.
+        out_.put(static_cast<char>(0xF7));
+        out_.put(0);
+        out_.put(0);
+        for (auto color: colors) {
+            out_.put(static_cast<char>(color & 0xFF));
+            out_.put(static_cast<char>((color >> 8) & 0xFF));
+            out_.put(static_cast<char>((color >> 16) & 0xFF));
+        }
+        // Loop forever.
+        out_.write("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+    }
+
+    void frame(const Bytes& image) override {
+        if (pending_frames_ > 0 && image == pending_) {
+            pending_frames_++;
+            return;
+        }
+        // GIF delays are in 1/100s, and many players slow down anything under 2/100s: a frame shown for a single
+        // 60Hz tick is replaced by the next one instead of being written.
+        if (pending_frames_ >= 2) write_pending();
+        pending_ = image;
+        pending_frames_++;
+    }
+
+    void finish() override {
+        if (pending_frames_ > 0) write_pending();
+        out_.put(0x3B);
+    }
+
+private:
+    void write_pending() {
+        // Rectangle that changed since the last frame written.
+        std::size_t left = width_, right = 0, top = height_, bottom = 0;
+        if (canvas_.empty()) {
+            left = 0, right = width_, top = 0, bottom = height_;
+        } else {
+            for (std::size_t y = 0; y < height_; y++) {
+                auto row = y * width_;
+                if (std::memcmp(canvas_.data() + row, pending_.data() + row, width_) == 0) continue;
+                top = std::min(top, y);
+                bottom = y + 1;
+                for (std::size_t x = 0; x < width_; x++) {
+                    if (canvas_[row + x] != pending_[row + x]) {
+                        left = std::min(left, x);
+                        right = std::max(right, x + 1);
+                    }
+                }
+            }
+            // Nothing changed, but the delay still needs a frame.
+            if (bottom == 0) left = 0, right = 1, top = 0, bottom = 1;
+        }
+
+        elapsed_frames_ += pending_frames_;
+        auto end = (elapsed_frames_ * 100 + 30) / 60;
+        auto delay = end - written_centiseconds_;
+        written_centiseconds_ = end;
+
+        // Graphic control: leave the frame in place for the next one to draw over, no transparency.
+        out_.write("\x21\xF9\x04\x04", 4);
+        write_le16(out_, delay);
+        out_.put(0);
+        out_.put(0);
+
+        out_.put(0x2C);
+        write_le16(out_, left);
+        write_le16(out_, top);
+        write_le16(out_, right - left);
+        write_le16(out_, bottom - top);
+        out_.put(0);
+
+        pixels_.clear();
+        for (auto y = top; y < bottom; y++) {
+            auto row = pending_.data() + y * width_;
+            pixels_.insert(pixels_.end(), row + left, row + right);
+        }
+        write_lzw();
+
+        canvas_ = pending_;
+        pending_frames_ = 0;
+    }
+
+    void write_lzw() {
+        constexpr int min_code_size = 8;
+        constexpr int clear_code = 1 << min_code_size;
+        constexpr int end_code = clear_code + 1;
+
+        out_.put(min_code_size);
+        GifBitWriter bits(out_);
+        int code_size = min_code_size + 1;
+        int last_code = end_code;
+        table_.clear();
+        bits.write(clear_code, code_size);
+
+        int current = pixels_.front();
+        for (std::size_t i = 1; i < pixels_.size(); i++) {
+            auto byte = pixels_[i];
+            auto code = table_.find(current, byte);
+            if (code >= 0) {
+                current = code;
+                continue;
+            }
+            bits.write(current, code_size);
+            table_.insert(current, byte, ++last_code);
+            if (last_code >= (1 << code_size)) code_size++;
+            if (last_code == 4095) {
+                bits.write(clear_code, code_size);
+                table_.clear();
+                code_size = min_code_size + 1;
+                last_code = end_code;
+            }
+            current = byte;
+        }
+        bits.write(current, code_size);
+        bits.write(end_code, code_size);
+        bits.flush();
+        out_.put(0);
+    }
+
+    std::ostream& out_;
+    std::size_t width_;
+    std::size_t height_;
+    // What a player shows after the last frame written.
+    Bytes canvas_;
+    Bytes pending_;
+    std::uint64_t pending_frames_{0};
+    std::uint64_t elapsed_frames_{0};
+    std::uint64_t written_centiseconds_{0};
+    Bytes pixels_;
+    LzwTable table_;
+};
+
+// Full range BT.601, as JPEG: chroma averaged over 2x2 pixels.
+void rgba_to_yuv420(const std::vector<std::uint32_t>& rgba, std::size_t width, std::size_t height, Bytes& yuv) {
+    yuv.resize(width * height * 3 / 2);
+    auto luma = yuv.data();
+    auto cb = luma + width * height;
+    auto cr = cb + (width / 2) * (height / 2);
+    auto channel = [](std::uint32_t color, int shift) { return static_cast<int>((color >> shift) & 0xFF); };
+    auto clamp = [](int value) { return static_cast<std::uint8_t>(std::min(255, std::max(0, value))); };
+
+    for (std::size_t i = 0; i < width * height; i++) {
+        auto color = rgba[i];
+        luma[i] = clamp((77 * channel(color, 0) + 150 * channel(color, 8) + 29 * channel(color, 16) + 128) >> 8);
+    }
+    for (std::size_t y = 0; y < height / 2; y++) {
+        for (std::size_t x = 0; x < width / 2; x++) {
+            int r = 0, g = 0, b = 0;
+            for (auto i: {(2 * y) * width + 2 * x, (2 * y) * width + 2 * x + 1,
+                          (2 * y + 1) * width + 2 * x, (2 * y + 1) * width + 2 * x + 1}) {
+                r += channel(rgba[i], 0);
+                g += channel(rgba[i], 8);
+                b += channel(rgba[i], 16);
+            }
+            // Sums of 4 pixels: the coefficients are divided by 4 more.
+            auto out = y * (width / 2) + x;
+            cb[out] = clamp(((-43 * r - 85 * g + 128 * b) >> 10) + 128);
+            cr[out] = clamp(((128 * r - 107 * g - 21 * b) >> 10) + 128);
+        }
+    }
+}
+
+}
+
+VideoFormat video_format_for(const std::string& path) {
+    auto ends_with = [&](const std::string& suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".y4m")) return VideoFormat::Y4M;
+    if (ends_with(".gif")) return VideoFormat::Gif;
+    return VideoFormat::Raw;
+}
+
+// Three stages, each on its own thread: emulation (the caller), rendering, then encoding and writing. A few frames
+// can wait between two stages.
+struct VideoExporter::Pipeline {
+    Pipeline(const std::string& path, std::size_t width, std::size_t height, const VideoOptions& options):
+            path(path),
+            out(path, std::ios::binary),
+            width(width),
+            height(height),
+            options(options),
+            deflicker(options.deflicker),
+            renderer(options.palette, options.filter),
+            rgba(width * options.scale * height * options.scale) {
+        if (!out) throw std::runtime_error("Cannot open " + path);
+
+        auto format = options.deflicker != 0 ? PixelFormat::Intensity : PixelFormat::Planes;
+        auto image_width = width * options.scale;
+        auto image_height = height * options.scale;
+        switch (options.format) {
+        case VideoFormat::Y4M:
+            encoder.reset(new Y4mEncoder(out, image_width, image_height));
+            break;
+        case VideoFormat::Raw:
+            encoder.reset(new RawEncoder(out));
+            break;
+        case VideoFormat::Gif:
+            encoder.reset(new GifEncoder(out, image_width, image_height, renderer.colors(format)));
+            break;
+        }
+
+        render_thread = std::thread([this] { render_loop(); });
+        write_thread = std::thread([this] { write_loop(); });
+    }
+
+    void render_loop() {
+        Bytes frame;
+        while (frames.pop(frame)) {
+            FramebufferView view{frame.data(), width, height, width};
+            if (options.deflicker != 0) view = deflicker.process(view);
+
+            Bytes image;
+            auto image_width = width * options.scale;
+            auto image_height = height * options.scale;
+            if (options.format == VideoFormat::Gif) {
+                // Color indices, nearest.
+                image.resize(image_width * image_height);
+                for (std::size_t y = 0; y < image_height; y++) {
+                    auto source = view.pixels + (y / options.scale) * view.stride;
+                    auto out = image.data() + y * image_width;
+                    for (std::size_t x = 0; x < image_width; x++) out[x] = source[x / options.scale];
+                }
+            } else {
+                renderer.render(view, RgbaTarget{rgba.data(), image_width, image_height, image_width});
+                if (options.format == VideoFormat::Y4M) {
+                    rgba_to_yuv420(rgba, image_width, image_height, image);
+                } else {
+                    auto bytes = reinterpret_cast<const std::uint8_t*>(rgba.data());
+                    image.assign(bytes, bytes + rgba.size() * sizeof(std::uint32_t));
+                }
+            }
+            rendered.push(std::move(image));
+        }
+        rendered.close();
+    }
+
+    void write_loop() {
+        Bytes image;
+        while (rendered.pop(image)) encoder->frame(image);
+    }
+
+    void finish() {
+        frames.close();
+        if (render_thread.joinable()) render_thread.join();
+        if (write_thread.joinable()) write_thread.join();
+        if (encoder != nullptr) {
+            encoder->finish();
+            encoder.reset();
+        }
+        out.close();
+        // A full disk shows up here, or earlier and the stream stopped writing since.
+        if (out.fail()) throw std::runtime_error("Cannot write " + path);
+    }
+
+    std::string path;
+    std::ofstream out;
+    std::size_t width;
+    std::size_t height;
+    VideoOptions options;
+
+    Channel<Bytes> frames{8};
+    Channel<Bytes> rendered{8};
+    std::unique_ptr<Encoder> encoder;
+
+    // Render thread only.
+    Deflicker deflicker;
+    Renderer renderer;
+    std::vector<std::uint32_t> rgba;
+
+    std::thread render_thread;
+    std::thread write_thread;
+};
+
+VideoExporter::VideoExporter(const std::string& path, std::size_t width, std::size_t height,
+                             const VideoOptions& options):
+        pipeline_(new Pipeline(path, width, height, options)) {
+}
+
+VideoExporter::~VideoExporter() {
+    try {
+        finish();
+    } catch (const std::runtime_error&) {
+        // Nobody to tell. Call finish() to know whether the file was written.
+    }
+}
+
+void VideoExporter::push(const FramebufferView& frame) {
+    if (pipeline_ == nullptr) return;
+    if (frame.width != pipeline_->width || frame.height != pipeline_->height) {
+        throw std::invalid_argument("Frame of " + std::to_string(frame.width) + "x" + std::to_string(frame.height)
+                                    + " in a video of " + std::to_string(pipeline_->width) + "x"
+                                    + std::to_string(pipeline_->height));
+    }
+    Bytes copy(frame.width * frame.height);
+    for (std::size_t row = 0; row < frame.height; row++) {
+        std::memcpy(copy.data() + row * frame.width, frame.pixels + row * frame.stride, frame.width);
+    }
+    pipeline_->frames.push(std::move(copy));
+    frames_++;
+}
+
+void VideoExporter::finish() {
+    if (pipeline_ == nullptr) return;
+    // Gone even if it throws: the threads are joined and the file closed by then.
+    std::unique_ptr<Pipeline> pipeline(std::move(pipeline_));
+    pipeline->finish();
+}
+
+}
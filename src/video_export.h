@@ -0,0 +1,61 @@
+// Records the frames of a headless run into a video file. Rendering and encoding run on worker threads, one frame
+// behind the emulation.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "renderer.h"
+
+namespace snooz {
+
+enum class VideoFormat {
+    // YUV4MPEG2, 4:2:0, 60 fps. Uncompressed, read by ffmpeg and most players.
+    Y4M,
+    // RGBA bytes, frame after frame, no header.
+    Raw,
+    // Animated GIF. Only the rectangle that changed is stored for each frame, and frames that do not change only
+    // make the previous one last longer.
+    Gif,
+};
+
+// From the extension: .y4m, .gif, anything else is raw.
+VideoFormat video_format_for(const std::string& path);
+
+struct VideoOptions {
+    VideoFormat format{VideoFormat::Y4M};
+    // Integer scale of the framebuffer.
+    std::size_t scale{4};
+    // Y4M and raw only, GIF is always nearest.
+    Filter filter{Filter::Nearest};
+    Palette palette{default_palette()};
+    // Decay of the deflicker, see Deflicker. 0 for none.
+    std::uint8_t deflicker{0};
+};
+
+class VideoExporter {
+public:
+    // Throw std::runtime_error if the file cannot be written. width and height are the size of the framebuffer.
+    VideoExporter(const std::string& path, std::size_t width, std::size_t height, const VideoOptions& options);
+    ~VideoExporter();
+    VideoExporter(const VideoExporter&) = delete;
+    VideoExporter& operator=(const VideoExporter&) = delete;
+
+    // Emulation thread. The frame is copied and handed over to the workers, this only blocks when they are more
+    // than a few frames behind. In PixelFormat::Planes, of the size given to the constructor: throw
+    // std::invalid_argument otherwise.
+    void push(const FramebufferView& frame);
+    // Wait for every frame to be written and close the file. Throw std::runtime_error if it could not be written
+    // entirely, e.g. the disk is full. Called by the destructor, which cannot report that.
+    void finish();
+
+    std::uint64_t frames() const { return frames_; }
+
+private:
+    struct Pipeline;
+    std::unique_ptr<Pipeline> pipeline_;
+    std::uint64_t frames_{0};
+};
+
+}
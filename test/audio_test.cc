@@ -0,0 +1,153 @@
+// The buzzer without a sound card: samples collected in memory or in a WAV file, and the ring fed by a simulated
+// callback.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "audio.h"
+
+using namespace snooz;
+
+namespace {
+
+class VectorSink : public AudioSink {
+public:
+    void write(const std::int16_t* samples, std::size_t count) override {
+        samples_.insert(samples_.end(), samples, samples + count);
+    }
+
+    const std::vector<std::int16_t>& samples() const { return samples_; }
+
+private:
+    std::vector<std::int16_t> samples_;
+};
+
+// Sound timer state at each tick.
+const std::vector<bool> beeps = {false, true, true, true, false, false, true, false};
+
+}
+
+TEST(audio, edges_on_tick_boundaries) {
+    VectorSink sink;
+    Buzzer buzzer(sink);
+    for (auto on: beeps) buzzer.tick(on);
+
+    auto& samples = sink.samples();
+    ASSERT_EQ(beeps.size() * samples_per_tick, samples.size());
+    for (std::size_t tick = 0; tick < beeps.size(); tick++) {
+        auto begin = samples.begin() + tick * samples_per_tick;
+        auto end = begin + samples_per_tick;
+        if (!beeps[tick]) {
+            // Silent from the first sample of the tick to the last.
+            ASSERT_TRUE(std::all_of(begin, end, [](std::int16_t sample) { return sample == 0; })) << tick;
+            continue;
+        }
+        // A square wave all along, never a sample at 0.
+        ASSERT_TRUE(std::none_of(begin, end, [](std::int16_t sample) { return sample == 0; })) << tick;
+        ASSERT_TRUE(std::any_of(begin, end, [](std::int16_t sample) { return sample < 0; })) << tick;
+    }
+
+    // Every beep starts on the same edge, and the wave has no seam between two ticks of the same beep.
+    auto first = samples.begin() + samples_per_tick;
+    auto second = samples.begin() + 6 * samples_per_tick;
+    ASSERT_TRUE(std::equal(first, first + samples_per_tick, second));
+    ASSERT_FALSE(std::equal(first, first + samples_per_tick, first + samples_per_tick));
+    std::size_t edges = 0;
+    for (auto it = first + 1; it != first + 3 * samples_per_tick; ++it) {
+        if (*it != *(it - 1)) edges++;
+    }
+    // 440Hz over 3 ticks: 44 half periods.
+    ASSERT_NEAR(44, static_cast<int>(edges), 1);
+}
+
+TEST(audio, pattern) {
+    VectorSink sink;
+    Buzzer buzzer(sink);
+    std::array<std::uint8_t, 16> ones;
+    ones.fill(0xFF);
+    buzzer.set_pattern(ones);
+    buzzer.tick(true);
+    buzzer.clear_pattern();
+    buzzer.tick(true);
+
+    auto& samples = sink.samples();
+    auto mid = samples.begin() + samples_per_tick;
+    ASSERT_TRUE(std::all_of(samples.begin(), mid, [&](std::int16_t sample) { return sample == samples.front(); }));
+    ASSERT_GT(samples.front(), 0);
+    // Back to the square wave on the next tick.
+    ASSERT_TRUE(std::any_of(mid, samples.end(), [](std::int16_t sample) { return sample < 0; }));
+}
+
+TEST(audio, wav_file) {
+    char path[] = "/tmp/audio_testXXXXXX";
+    auto fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    {
+        WavWriter wav(path);
+        Buzzer buzzer(wav);
+        for (auto on: beeps) buzzer.tick(on);
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::vector<std::uint8_t> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    std::remove(path);
+
+    auto le32 = [&](std::size_t pos) {
+        return data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 | static_cast<std::uint32_t>(data[pos + 3]) << 24;
+    };
+    auto data_size = beeps.size() * samples_per_tick * 2;
+    ASSERT_EQ(44 + data_size, data.size());
+    ASSERT_EQ("RIFF", std::string(data.begin(), data.begin() + 4));
+    ASSERT_EQ(36 + data_size, le32(4));
+    ASSERT_EQ(audio_sample_rate, le32(24));
+    ASSERT_EQ("data", std::string(data.begin() + 36, data.begin() + 40));
+    ASSERT_EQ(data_size, le32(40));
+    // First tick silent, the second starts right at its boundary.
+    auto second_tick = 44 + samples_per_tick * 2;
+    ASSERT_EQ(0, data[second_tick - 2] | data[second_tick - 1]);
+    ASSERT_NE(0, data[second_tick] | data[second_tick + 1]);
+}
+
+// Ticks written every 1/60s give or take 2ms, the callback reading chunks on its own clock, a little slower: the
+// backlog grows until the sink trims it. Measures how late each tick starts to play.
+TEST(audio, ring_latency) {
+    AudioRing ring;
+    RingSink sink(ring);
+    Buzzer buzzer(sink);
+    std::minstd_rand random(5);
+    std::uniform_real_distribution<double> jitter(-88, 88);
+
+    const double chunk_period = audio_chunk_size * 1.005;
+    double next_read = 0;
+    std::int16_t chunk[audio_chunk_size];
+    std::size_t worst_backlog = 0;
+    std::size_t underruns = 0;
+    for (int tick = 0; tick < 3600; tick++) {
+        auto write_time = tick * static_cast<double>(samples_per_tick) + jitter(random);
+        for (; next_read < write_time; next_read += chunk_period) {
+            if (tick > 2 && ring.size() < audio_chunk_size) underruns++;
+            read_audio(ring, chunk, audio_chunk_size);
+        }
+        // Samples ahead of what is kept of the tick.
+        auto queued = ring.size();
+        auto dropped = sink.dropped();
+        buzzer.tick(tick % 2 == 0);
+        auto trimmed = sink.dropped() - dropped;
+        ASSERT_LE(queued, trimmed + RingSink::max_backlog) << tick;
+        worst_backlog = std::max(worst_backlog, queued - trimmed);
+    }
+    // The reader is slower: some samples had to go, and the backlog reached its cap.
+    ASSERT_GT(sink.dropped(), 0u);
+    ASSERT_EQ(RingSink::max_backlog, worst_backlog);
+    ASSERT_EQ(0u, underruns);
+
+    // The backlog plus the three chunks queued in the device: under 20ms.
+    auto worst_latency = worst_backlog + 3 * audio_chunk_size;
+    ASSERT_LT(worst_latency * 1000.0 / audio_sample_rate, 20.0);
+}
@@ -0,0 +1,137 @@
+// The C interface, through the shared library, against the C++ core it wraps.
+
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "libchip8.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+std::vector<std::uint8_t> blinky() {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    for (auto& entry: library.entries()) {
+        if (entry.name == "BLINKY") return {entry.rom.begin(), entry.rom.end()};
+    }
+    return {};
+}
+
+// A key pattern that moves around: a different key every 7 frames, none in between.
+std::uint16_t keys_at(std::uint32_t frame) {
+    return frame % 7 < 3 ? static_cast<std::uint16_t>(1 << (frame / 7 % 16)) : 0;
+}
+
+}
+
+TEST(capi, same_frames_as_core) {
+    auto rom = blinky();
+    ASSERT_FALSE(rom.empty());
+    EXPECT_EQ(CHIP8_ABI_VERSION, chip8_abi_version());
+
+    auto machine = chip8_create();
+    ASSERT_NE(nullptr, machine);
+    chip8_seed(machine, 3);
+    ASSERT_EQ(CHIP8_OK, chip8_load(machine, rom.data(), rom.size()));
+
+    Chip8 chip8;
+    chip8.seed(3);
+    chip8.load_rom(RomSpan{rom.data(), rom.size()});
+    EXPECT_EQ(chip8.instructions_per_frame(), chip8_instructions_per_frame(machine));
+
+    std::vector<std::uint16_t> keys(300);
+    for (std::uint32_t frame = 0; frame < keys.size(); frame++) keys[frame] = keys_at(frame);
+    // One frame at a time for the first half, then the rest in one batch.
+    std::uint64_t executed = 0;
+    for (std::uint32_t frame = 0; frame < 150; frame++) {
+        chip8_set_keys(machine, keys[frame]);
+        executed += chip8_run_frame(machine);
+    }
+    executed += chip8_run_frames(machine, 150, keys.data() + 150);
+
+    NoHooks hooks;
+    std::uint16_t previous = 0;
+    for (std::uint32_t frame = 0; frame < keys.size(); frame++) {
+        for (std::size_t key = 0; key < 16; key++) {
+            auto bit = 1 << key;
+            if ((keys[frame] & bit) == (previous & bit)) continue;
+            if (keys[frame] & bit) {
+                chip8.set_key_pressed(key);
+            } else {
+                chip8.set_key_released(key);
+            }
+        }
+        previous = keys[frame];
+        chip8.run_cycles(chip8.instructions_per_frame(), hooks);
+    }
+
+    EXPECT_EQ(chip8.cycles(), executed);
+    EXPECT_EQ(chip8.cycles(), chip8_cycles(machine));
+    EXPECT_EQ(0, std::memcmp(chip8.gfx().data(), chip8_framebuffer(machine), CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT));
+    EXPECT_EQ(chip8.sound_active(), chip8_sound_active(machine) != 0);
+    chip8_destroy(machine);
+}
+
+TEST(capi, save_and_load_state) {
+    auto rom = blinky();
+    auto machine = chip8_create();
+    ASSERT_EQ(CHIP8_OK, chip8_load(machine, rom.data(), rom.size()));
+    chip8_run_frames(machine, 100, nullptr);
+    ASSERT_EQ(CHIP8_OK, chip8_set_key(machine, 7, 1));
+    // Saved with the state, and set again on load.
+    ASSERT_EQ(CHIP8_OK, chip8_set_instructions_per_frame(machine, 13));
+
+    std::vector<std::uint8_t> state(chip8_state_size());
+    EXPECT_EQ(CHIP8_ERROR_ARGUMENT, chip8_save_state(machine, state.data(), state.size() - 1));
+    ASSERT_EQ(CHIP8_OK, chip8_save_state(machine, state.data(), state.size()));
+    chip8_run_frames(machine, 100, nullptr);
+    std::vector<std::uint8_t> expected(chip8_framebuffer(machine), chip8_framebuffer(machine) + 64 * 32);
+    auto cycles = chip8_cycles(machine);
+
+    // Into another machine, after the same ROM.
+    auto other = chip8_create();
+    ASSERT_EQ(CHIP8_OK, chip8_load(other, rom.data(), rom.size()));
+    ASSERT_EQ(CHIP8_OK, chip8_load_state(other, state.data(), state.size()));
+    EXPECT_EQ(1 << 7, chip8_keys(other));
+    EXPECT_EQ(13u, chip8_instructions_per_frame(other));
+    chip8_run_frames(other, 100, nullptr);
+    EXPECT_EQ(cycles, chip8_cycles(other));
+    EXPECT_EQ(0, std::memcmp(expected.data(), chip8_framebuffer(other), expected.size()));
+
+    // Offsets in the layout of libchip8.cc: magic, version, memory, V, I, pc, opcode, stack, sp, screen, timers.
+    constexpr std::size_t keys_offset = 4 + 4 + 4096 + 16 + 2 + 2 + 2 + 32 + 1 + 2048 + 2;
+    constexpr std::size_t key_index_offset = keys_offset + 16 + 2;
+    for (auto corruption: {std::make_pair(std::size_t{0}, 0x20), std::make_pair(keys_offset + 3, 2),
+                           std::make_pair(key_index_offset, 16)}) {
+        auto corrupted = state;
+        corrupted[corruption.first] = static_cast<std::uint8_t>(corruption.second);
+        EXPECT_EQ(CHIP8_ERROR_STATE, chip8_load_state(other, corrupted.data(), corrupted.size()));
+        EXPECT_STRNE("", chip8_last_error(other));
+    }
+
+    // Not with another ROM.
+    std::vector<std::uint8_t> loop{0x12, 0x00};
+    ASSERT_EQ(CHIP8_OK, chip8_load(other, loop.data(), loop.size()));
+    EXPECT_EQ(CHIP8_ERROR_STATE, chip8_load_state(other, state.data(), state.size()));
+    chip8_destroy(other);
+    chip8_destroy(machine);
+}
+
+TEST(capi, errors_do_not_throw) {
+    auto machine = chip8_create();
+    std::vector<std::uint8_t> too_large(4096);
+    EXPECT_EQ(CHIP8_ERROR_ROM, chip8_load(machine, too_large.data(), too_large.size()));
+    EXPECT_STRNE("", chip8_last_error(machine));
+    EXPECT_EQ(CHIP8_ERROR_ARGUMENT, chip8_set_key(machine, 16, 1));
+    EXPECT_EQ(CHIP8_ERROR_ARGUMENT, chip8_set_instructions_per_frame(machine, 0));
+    ASSERT_EQ(CHIP8_OK, chip8_load(machine, too_large.data(), 16));
+    EXPECT_STREQ("", chip8_last_error(machine));
+    chip8_destroy(machine);
+
+    EXPECT_EQ(CHIP8_ERROR_ARGUMENT, chip8_load(nullptr, too_large.data(), 16));
+    EXPECT_EQ(0u, chip8_run_frame(nullptr));
+    EXPECT_EQ(nullptr, chip8_framebuffer(nullptr));
+    chip8_destroy(nullptr);
+}
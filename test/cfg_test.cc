@@ -0,0 +1,94 @@
+// Control flow recovered from a hand-built ROM: which bytes are code, which are data, and the labels.
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "cfg.h"
+#include "decoder.h"
+
+using namespace snooz;
+
+namespace {
+
+const std::vector<std::uint8_t> rom = {
+        0x22, 0x08,                     // 200: call 208
+        0x30, 0x00,                     // 202: skip if V0 == 0
+        0x12, 0x04,                     // 204: jump 204
+        0x12, 0x06,                     // 206: jump 206
+        0xA2, 0x0E,                     // 208: I = 20E
+        0xD0, 0x05,                     // 20A: draw 5 rows from I
+        0x00, 0xEE,                     // 20C: return
+        0xF0, 0x90, 0x90, 0x90, 0xF0,   // 20E: sprite
+        0xAB,                           // 213: never used
+};
+
+}
+
+TEST(cfg, code_and_data) {
+    auto cfg = build_cfg(rom);
+    ASSERT_EQ(0x200, cfg.origin);
+    ASSERT_EQ(rom.size(), cfg.length);
+
+    for (std::uint16_t address = 0x200; address < 0x20E; address++) {
+        ASSERT_TRUE(cfg.is_code(address)) << std::hex << address;
+        ASSERT_FALSE(cfg.is_data(address)) << std::hex << address;
+        ASSERT_EQ(address % 2 == 0, cfg.has(address, ControlFlowGraph::InstructionStart)) << std::hex << address;
+    }
+    for (std::uint16_t address = 0x20E; address < 0x213; address++) {
+        ASSERT_FALSE(cfg.is_code(address)) << std::hex << address;
+        ASSERT_TRUE(cfg.is_data(address)) << std::hex << address;
+    }
+    ASSERT_FALSE(cfg.is_code(0x213));
+    ASSERT_FALSE(cfg.is_data(0x213));
+}
+
+TEST(cfg, blocks_and_labels) {
+    auto cfg = build_cfg(rom);
+
+    ASSERT_TRUE(cfg.has(0x208, ControlFlowGraph::Subroutine));
+    ASSERT_TRUE(cfg.has(0x204, ControlFlowGraph::JumpTarget));
+    ASSERT_TRUE(cfg.has(0x206, ControlFlowGraph::JumpTarget));
+    ASSERT_FALSE(cfg.has(0x202, ControlFlowGraph::JumpTarget));
+
+    std::vector<std::uint16_t> starts;
+    for (auto& block: cfg.blocks) starts.push_back(block.start);
+    ASSERT_EQ((std::vector<std::uint16_t>{0x200, 0x202, 0x204, 0x206, 0x208}), starts);
+
+    // The call continues at the return address, the subroutine is in `calls`.
+    auto call = cfg.block_at(0x200);
+    ASSERT_EQ((std::vector<std::uint16_t>{0x202}), call->successors);
+    ASSERT_EQ((std::vector<std::uint16_t>{0x208}), call->calls);
+    // Both sides of the skip.
+    ASSERT_EQ((std::vector<std::uint16_t>{0x204, 0x206}), cfg.block_at(0x202)->successors);
+    ASSERT_EQ((std::vector<std::uint16_t>{0x204}), cfg.block_at(0x204)->successors);
+
+    auto subroutine = cfg.block_at(0x20A);
+    ASSERT_EQ(0x208, subroutine->start);
+    ASSERT_EQ(0x20E, subroutine->end);
+    ASSERT_TRUE(subroutine->returns);
+    ASSERT_TRUE(subroutine->successors.empty());
+    ASSERT_EQ(nullptr, cfg.block_at(0x20E));
+    ASSERT_EQ(4, cfg.block_index(0x208));
+    ASSERT_EQ(-1, cfg.block_index(0x20A));
+}
+
+TEST(cfg, listing) {
+    auto cfg = build_cfg(rom);
+    Decoder decoder;
+    std::string listing;
+    write_listing(listing, cfg, rom.data(), decoder);
+    ASSERT_EQ("    200\t[0x2208]\tCall subroutine at 0x208\n"
+              "    202\t[0x3000]\tSkips next instruction if V0 equals 0\n"
+              "L_204:\n"
+              "    204\t[0x1204]\tJump to address 0x204\n"
+              "L_206:\n"
+              "    206\t[0x1206]\tJump to address 0x206\n"
+              "\n"
+              "sub_208:\n"
+              "    208\t[0xa20e]\tSet I to 526\n"
+              "    20a\t[0xd005]\tDraw a sprite at coordinate (V0, V0)\n"
+              "    20c\t[0xee]\tReturn from subroutine\n"
+              "    20e\tdb 0xf0, 0x90, 0x90, 0x90, 0xf0\t; data\n"
+              "    213\tdb 0xab\n",
+              listing);
+}
@@ -0,0 +1,211 @@
+// The remote debugging server, driven through a socketpair the way a client would.
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "chip_8.h"
+#include "debug_server.h"
+#include "debugger.h"
+
+using namespace snooz;
+
+namespace {
+
+std::string packet(const std::string& payload) {
+    unsigned checksum = 0;
+    for (auto c: payload) checksum += static_cast<std::uint8_t>(c);
+    char tail[4];
+    std::snprintf(tail, sizeof(tail), "#%02x", checksum & 0xFF);
+    return "$" + payload + tail;
+}
+
+class Client {
+public:
+    Client() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("socketpair");
+        server_fd_ = fds[0];
+        fd_ = fds[1];
+    }
+    ~Client() { close(fd_); }
+
+    int server_fd() const { return server_fd_; }
+
+    void send_raw(const std::string& bytes) {
+        std::size_t sent = 0;
+        while (sent < bytes.size()) {
+            auto n = ::send(fd_, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) throw std::runtime_error("send");
+            sent += n;
+        }
+    }
+
+    // Everything the server sent so far. `closed` tells whether it hung up.
+    std::string receive(bool* closed = nullptr) {
+        std::string received;
+        char buffer[4096];
+        while (true) {
+            auto n = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n > 0) {
+                received.append(buffer, n);
+                continue;
+            }
+            // Closing with unread data resets the connection instead of ending it.
+            if (closed) *closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            return received;
+        }
+    }
+
+private:
+    int server_fd_;
+    int fd_;
+};
+
+// V0 = 5, then V0 += 1 in a loop.
+const std::vector<std::uint8_t> rom = {0x60, 0x05, 0x70, 0x01, 0x12, 0x02};
+
+}
+
+TEST(debug_server, commands) {
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    Debugger debugger;
+    Client client;
+    DebugServer server(client.server_fd());
+
+    // Attaching stops the core.
+    ASSERT_TRUE(server.poll(chip8, debugger, false));
+    ASSERT_EQ("", client.receive());
+
+    // Several ranges in one packet.
+    client.send_raw(packet("m200,2;204,2;ffe,2"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("6005;1202;0000"), client.receive());
+    // Reading past the end of memory is an error, not a wrap.
+    client.send_raw(packet("mfff,2"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("E01"), client.receive());
+
+    // Two packets in a single read are both answered, in order.
+    client.send_raw(packet("G" "0102030405060708090a0b0c0d0e0f10" "0123" "0200" "00" "00" "00") + packet("g"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("OK") + "+" + packet("0102030405060708090a0b0c0d0e0f10" "0123" "0200" "00" "00" "00"),
+              client.receive());
+    ASSERT_EQ(0x04, chip8.register_value(3));
+    ASSERT_EQ(0x0123, chip8.snapshot().I);
+
+    // A bad checksum is refused and the packet ignored.
+    client.send_raw("$g#00");
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("-", client.receive());
+
+    client.send_raw(packet("Z0,202"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("OK"), client.receive());
+    ASSERT_TRUE(debugger.has_breakpoint(0x202));
+
+    client.send_raw(packet("s"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("S05"), client.receive());
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(5, chip8.register_value(0));
+
+    // Continue is answered only once the debugger breaks.
+    client.send_raw(packet("c"));
+    ASSERT_FALSE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+", client.receive());
+    auto reason = debugger.run(chip8, 100);
+    ASSERT_EQ(StopReason::Breakpoint, reason);
+    server.stopped(reason);
+    ASSERT_EQ(packet("S05"), client.receive());
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(6, chip8.register_value(0));
+
+    // Only one reply per continue.
+    server.stopped(reason);
+    ASSERT_EQ("", client.receive());
+}
+
+// sp is 16 with the stack full: it survives a g/G round trip, and anything above is refused.
+TEST(debug_server, stack_pointer) {
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    Debugger debugger;
+    Client client;
+    DebugServer server(client.server_fd());
+    const std::string registers = "0102030405060708090a0b0c0d0e0f10" "0123" "0200";
+
+    client.send_raw(packet("G" + registers + "10" "00" "00") + packet("g"));
+    ASSERT_TRUE(server.poll(chip8, debugger, false));
+    ASSERT_EQ("+" + packet("OK") + "+" + packet(registers + "10" "00" "00"), client.receive());
+    ASSERT_EQ(16, chip8.snapshot().sp);
+
+    client.send_raw(packet("G" + registers + "11" "00" "00"));
+    ASSERT_TRUE(server.poll(chip8, debugger, true));
+    ASSERT_EQ("+" + packet("E01"), client.receive());
+    ASSERT_EQ(16, chip8.snapshot().sp);
+}
+
+TEST(debug_server, unfinished_packet_flood_disconnects) {
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    Debugger debugger;
+    Client client;
+    DebugServer server(client.server_fd());
+
+    client.send_raw(packet("Z0,202"));
+    ASSERT_TRUE(server.poll(chip8, debugger, false));
+    ASSERT_EQ("+" + packet("OK"), client.receive());
+
+    // A packet that never ends: the server drops the client rather than buffer it forever.
+    client.send_raw("$M200,4000:" + std::string(64 * 1024, '0'));
+    ASSERT_FALSE(server.poll(chip8, debugger, true));
+    bool closed = false;
+    client.receive(&closed);
+    ASSERT_TRUE(closed);
+    // And like any client leaving, it does not leave the core stuck on its breakpoints.
+    ASSERT_FALSE(debugger.has_breakpoint(0x202));
+    ASSERT_FALSE(debugger.armed());
+}
+
+TEST(debug_server, unread_answers_disconnect) {
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    Debugger debugger;
+    Client client;
+    DebugServer server(client.server_fd());
+
+    client.send_raw(packet("Z0,202"));
+    ASSERT_TRUE(server.poll(chip8, debugger, false));
+    ASSERT_EQ("+" + packet("OK"), client.receive());
+
+    // Reads of the whole memory, 8K each, and nothing read back: the socket buffer fills up, then the server's.
+    bool disconnected = false;
+    for (int frame = 0; frame < 200 && !disconnected; frame++) {
+        std::string requests;
+        for (int i = 0; i < 8; i++) requests += packet("m0,1000");
+        client.send_raw(requests);
+        disconnected = !server.poll(chip8, debugger, true);
+    }
+    ASSERT_TRUE(disconnected);
+    ASSERT_FALSE(debugger.has_breakpoint(0x202));
+}
+
+TEST(debug_server, client_hang_up_clears_breakpoints) {
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    Debugger debugger;
+    auto client = std::unique_ptr<Client>(new Client());
+    DebugServer server(client->server_fd());
+
+    client->send_raw(packet("Z0,202"));
+    ASSERT_TRUE(server.poll(chip8, debugger, false));
+    client.reset();
+    ASSERT_FALSE(server.poll(chip8, debugger, true));
+    ASSERT_FALSE(debugger.has_breakpoint(0x202));
+}
@@ -0,0 +1,118 @@
+// Breakpoints, watchpoints and conditions stop the core before the instruction they are about.
+
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "debugger.h"
+
+using namespace snooz;
+
+TEST(debugger, breakpoint) {
+    // V0 += 1, V1 += 1, loop.
+    Chip8 chip8;
+    chip8.load_from_buffer({0x70, 0x01, 0x71, 0x01, 0x12, 0x00});
+    Debugger debugger;
+    debugger.add_breakpoint(0x202);
+
+    ASSERT_EQ(StopReason::Breakpoint, debugger.run(chip8, 100));
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(1, chip8.register_value(0));
+    ASSERT_EQ(0, chip8.register_value(1));
+
+    // The next run executes the instruction it stopped on, and stops there again one loop later.
+    ASSERT_EQ(StopReason::Breakpoint, debugger.run(chip8, 100));
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(2, chip8.register_value(0));
+    ASSERT_EQ(1, chip8.register_value(1));
+
+    debugger.remove_breakpoint(0x202);
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 100));
+    ASSERT_FALSE(debugger.armed());
+}
+
+TEST(debugger, write_watchpoint_wraps) {
+    // I = FFE, V0 to V2 stored at FFE, FFF and 000.
+    Chip8 chip8;
+    chip8.load_from_buffer({0xAF, 0xFE, 0x60, 0x07, 0xF2, 0x55, 0x12, 0x06});
+    Debugger debugger;
+    debugger.add_watchpoint(0x000, 1, WatchWrite);
+    // Reads of the same address do not count.
+    debugger.add_watchpoint(0xFFE, 2, WatchRead);
+
+    ASSERT_EQ(StopReason::Watchpoint, debugger.run(chip8, 100));
+    ASSERT_EQ(0x204, chip8.pc());
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 100));
+    ASSERT_EQ(0x07, chip8.memory()[0xFFE]);
+}
+
+TEST(debugger, read_watchpoint_wraps) {
+    // I = FFF, draw 2 rows from FFF and 000, then FX65 from 300.
+    Chip8 chip8;
+    chip8.load_from_buffer({0xAF, 0xFF, 0xD0, 0x02, 0xA3, 0x00, 0xF1, 0x65, 0x12, 0x08});
+    Debugger debugger;
+    debugger.add_watchpoint(0x000, 1, WatchRead);
+    debugger.add_watchpoint(0x301, 1, WatchReadWrite);
+
+    ASSERT_EQ(StopReason::Watchpoint, debugger.run(chip8, 100));
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(StopReason::Watchpoint, debugger.run(chip8, 100));
+    ASSERT_EQ(0x206, chip8.pc());
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 100));
+}
+
+TEST(debugger, condition_breaks_on_edge) {
+    // V0 += 1, loop: V0 changes every other instruction.
+    Chip8 chip8;
+    chip8.load_from_buffer({0x70, 0x01, 0x12, 0x00});
+    Debugger debugger;
+    debugger.add_condition({0, Condition::Equal, 3});
+
+    ASSERT_EQ(StopReason::Condition, debugger.run(chip8, 1000));
+    ASSERT_EQ(3, chip8.register_value(0));
+    // Still true on the next instructions: no break until it goes false and true again, 256 increments later.
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 500));
+    ASSERT_EQ(StopReason::Condition, debugger.run(chip8, 100));
+    ASSERT_EQ(3, chip8.register_value(0));
+}
+
+// Every condition is updated on every instruction, whatever stops it.
+TEST(debugger, conditions_do_not_fire_late) {
+    Chip8 chip8;
+    chip8.load_from_buffer({0x70, 0x01, 0x12, 0x00});
+    Debugger debugger;
+    // Both become true on the same instruction.
+    debugger.add_condition({0, Condition::Equal, 2});
+    debugger.add_condition({0, Condition::Greater, 1});
+    ASSERT_EQ(StopReason::Condition, debugger.run(chip8, 1000));
+    ASSERT_EQ(2, chip8.register_value(0));
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 100));
+
+    // A condition that becomes true on a breakpoint.
+    Chip8 other;
+    other.load_from_buffer({0x70, 0x01, 0x12, 0x00});
+    Debugger breaking;
+    breaking.add_breakpoint(0x202);
+    breaking.add_condition({0, Condition::Equal, 1});
+    ASSERT_EQ(StopReason::Breakpoint, breaking.run(other, 100));
+    breaking.remove_breakpoint(0x202);
+    ASSERT_EQ(StopReason::None, breaking.run(other, 100));
+}
+
+TEST(debugger, single_step) {
+    Chip8 chip8;
+    chip8.load_from_buffer({0x70, 0x01, 0x71, 0x01, 0x12, 0x00});
+    Debugger debugger;
+    debugger.add_breakpoint(0x200);
+    debugger.add_breakpoint(0x202);
+    debugger.add_condition({0, Condition::Equal, 1});
+
+    // Breakpoints are ignored.
+    ASSERT_EQ(StopReason::Step, debugger.step(chip8));
+    ASSERT_EQ(0x202, chip8.pc());
+    ASSERT_EQ(StopReason::Step, debugger.step(chip8));
+    ASSERT_EQ(0x204, chip8.pc());
+    ASSERT_EQ(1, chip8.register_value(1));
+    // V0 became 1 during the steps: that edge is not reported afterwards.
+    debugger.remove_breakpoint(0x200);
+    debugger.remove_breakpoint(0x202);
+    ASSERT_EQ(StopReason::None, debugger.run(chip8, 10));
+}
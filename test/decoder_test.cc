@@ -0,0 +1,116 @@
+// The disassembler against the listing the decoder printed before it formatted into buffers (golden/disassembly.txt),
+// on every bundled ROM. Two kinds of lines changed on purpose and nothing else: `Set VX to NN` lost its missing space,
+// and the E and F opcodes the old decoder did not know are described.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "decoder.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+using Listing = std::vector<std::string>;
+
+Listing split_lines(const std::string& text) {
+    Listing lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    return lines;
+}
+
+// `== <game>` then its lines, comments skipped.
+std::map<std::string, Listing> read_golden(std::istream& in) {
+    std::map<std::string, Listing> listings;
+    Listing* current = nullptr;
+    for (std::string line; std::getline(in, line);) {
+        if (line.empty() || line[0] == '#') continue;
+        if (line.compare(0, 3, "== ") == 0) {
+            current = &listings[line.substr(3)];
+        } else if (current) {
+            current->push_back(line);
+        }
+    }
+    return listings;
+}
+
+// `Set VX toNN` as it was printed, `Set VX to NN` now.
+bool spacing_fixed(const std::string& old_line, const std::string& line) {
+    auto to = old_line.rfind("\tSet V");
+    if (to == std::string::npos) return false;
+    auto value = old_line.find(" to", to);
+    if (value == std::string::npos || value + 3 >= old_line.size() || old_line[value + 3] == ' ') return false;
+    return line == old_line.substr(0, value + 3) + ' ' + old_line.substr(value + 3);
+}
+
+// An E or F opcode printed as unknown now has a description, with its address like every other line.
+bool newly_described(const std::string& old_line, const std::string& line, std::uint16_t opcode, std::uint16_t pc) {
+    if (old_line.compare(0, 17, "Unknown Opcode 0x") != 0) return false;
+    if ((opcode >> 12) != 0xE && (opcode >> 12) != 0xF) return false;
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "%x\t[0x%x]\t", pc, opcode);
+    return line.compare(0, std::strlen(prefix), prefix) == 0 && line.size() > std::strlen(prefix) &&
+           line.find("Unknown") == std::string::npos;
+}
+
+}
+
+TEST(decoder, matches_old_listing) {
+    std::ifstream in(CHIP8_GOLDEN_DIR "/disassembly.txt");
+    ASSERT_TRUE(in.good());
+    auto golden = read_golden(in);
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    ASSERT_EQ(library.entries().size(), golden.size());
+
+    std::size_t lines = 0, spacing = 0, described = 0;
+    for (auto& entry: library.entries()) {
+        SCOPED_TRACE(entry.name);
+        auto found = golden.find(entry.name);
+        ASSERT_NE(golden.end(), found);
+        auto& old_listing = found->second;
+
+        Decoder decoder;
+        decoder.load_rom(entry.rom);
+        std::string text;
+        decoder.disassemble(std::back_inserter(text));
+        auto listing = split_lines(text);
+        ASSERT_EQ(old_listing.size(), listing.size());
+
+        for (std::size_t i = 0; i < listing.size(); i++) {
+            auto pc = static_cast<std::uint16_t>(0x200 + 2 * i);
+            auto high = entry.rom.data[2 * i];
+            auto low = 2 * i + 1 < entry.rom.size ? entry.rom.data[2 * i + 1] : 0;
+            auto opcode = static_cast<std::uint16_t>(high << 8 | low);
+
+            // Every way of formatting a line agrees.
+            std::string single;
+            decoder.format_to(std::back_inserter(single), opcode, pc);
+            ASSERT_EQ(listing[i], single) << i;
+            ASSERT_EQ(listing[i], decoder.interpret(opcode, pc)) << i;
+
+            auto& old_line = old_listing[i];
+            if (listing[i] == old_line) {
+                continue;
+            } else if (spacing_fixed(old_line, listing[i])) {
+                spacing++;
+            } else if (newly_described(old_line, listing[i], opcode, pc)) {
+                described++;
+            } else {
+                FAIL() << i << ": " << old_line << " became " << listing[i];
+            }
+        }
+        lines += listing.size();
+    }
+    // Counted on the listing when it was generated: a change here is a change in the output.
+    ASSERT_EQ(5458u, lines);
+    ASSERT_EQ(675u, spacing);
+    ASSERT_EQ(250u, described);
+}
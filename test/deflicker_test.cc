@@ -0,0 +1,54 @@
+// The deflicker against its definition, one pixel at a time. Widths that are not a multiple of 16 go through both
+// the SSE2 loop and the scalar tail in the same row.
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "deflicker.h"
+
+using namespace snooz;
+
+TEST(deflicker, matches_scalar) {
+    std::minstd_rand random(3);
+    for (std::size_t width: {5, 16, 17, 37, 64, 100, 128}) {
+        for (unsigned decay: {0, 1, 128, 176, 255}) {
+            const std::size_t height = 3;
+            const std::size_t stride = width + 7;
+            Deflicker deflicker(static_cast<std::uint8_t>(decay));
+            std::vector<std::uint8_t> expected(width * height, 0);
+            std::vector<std::uint8_t> frame(stride * height);
+
+            for (int step = 0; step < 30; step++) {
+                // Mostly dark frames so that the fade goes all the way down. Any value but 0 is lit, including
+                // those with the sign bit set.
+                for (auto& pixel: frame) pixel = random() % 4 == 0 ? static_cast<std::uint8_t>(random()) : 0;
+                if (step > 20) std::fill(frame.begin(), frame.end(), 0);
+
+                auto view = deflicker.process(FramebufferView{frame.data(), width, height, stride});
+                ASSERT_EQ(PixelFormat::Intensity, view.format);
+                ASSERT_EQ(width, view.width);
+                for (std::size_t y = 0; y < height; y++) {
+                    for (std::size_t x = 0; x < width; x++) {
+                        auto& intensity = expected[y * width + x];
+                        intensity = frame[y * stride + x] != 0 ? 255 : (intensity * decay) >> 8;
+                        ASSERT_EQ(intensity, view.pixels[y * view.stride + x])
+                                << "width " << width << " decay " << decay << " step " << step << " at " << x << ','
+                                << y;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(deflicker, fades_and_resets) {
+    std::vector<std::uint8_t> frame(64 * 32, 0);
+    frame[0] = 1;
+    Deflicker deflicker(128);
+    ASSERT_EQ(255, deflicker.process(FramebufferView{frame.data(), 64, 32, 64}).pixels[0]);
+    frame[0] = 0;
+    ASSERT_EQ(127, deflicker.process(FramebufferView{frame.data(), 64, 32, 64}).pixels[0]);
+    ASSERT_EQ(63, deflicker.process(FramebufferView{frame.data(), 64, 32, 64}).pixels[0]);
+    deflicker.reset();
+    ASSERT_EQ(0, deflicker.process(FramebufferView{frame.data(), 64, 32, 64}).pixels[0]);
+}
@@ -0,0 +1,105 @@
+// The core on its own thread, seen from the window thread: frames coming in, a key waking up a ROM that waits for
+// one, and pausing.
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "debugger.h"
+#include "emulator_thread.h"
+
+using namespace snooz;
+
+namespace {
+
+// V0 += 1 and a pixel toggled on every loop: the screen changes every frame.
+const std::vector<std::uint8_t> counter = {0x70, 0x01, 0xD1, 0x21, 0x12, 0x00};
+
+// Poll the frames until one satisfies done, for a few seconds at most. Sequence numbers must only go up.
+template <typename Done>
+bool wait_for_frame(EmulatorThread& emulator, Done done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    auto last = emulator.frame().sequence;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (emulator.update_frame()) {
+            EXPECT_GT(emulator.frame().sequence, last);
+            last = emulator.frame().sequence;
+            if (done(emulator.frame())) return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+}
+
+TEST(emulator_thread, frames) {
+    Chip8 chip8;
+    chip8.load_from_buffer(counter);
+    EmulatorThread emulator(chip8);
+    // Stopping a thread never started does nothing.
+    emulator.stop();
+
+    emulator.start();
+    // The first frame is published right away, then one per drawn frame.
+    ASSERT_TRUE(wait_for_frame(emulator, [](const Frame& frame) { return frame.sequence >= 1; }));
+    ASSERT_TRUE(wait_for_frame(emulator, [](const Frame& frame) { return frame.registers[0] >= 20; }));
+    emulator.stop();
+    emulator.stop();
+
+    // Nothing runs once stopped.
+    emulator.update_frame();
+    auto cycles = chip8.cycles();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(cycles, chip8.cycles());
+}
+
+// A ROM blocked on FX0A sleeps until a key: push_key has to wake it up.
+TEST(emulator_thread, key_wakes_up) {
+    // V0 = key, then draw its digit and wait there.
+    const std::vector<std::uint8_t> rom = {0xF0, 0x0A, 0xF0, 0x29, 0xD1, 0x15, 0x12, 0x06};
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    EmulatorThread emulator(chip8);
+    emulator.start();
+    ASSERT_TRUE(wait_for_frame(emulator, [](const Frame& frame) { return frame.sequence >= 1; }));
+
+    // Long enough for the core to go to sleep on the key, with no deadline to wake up on its own.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(emulator.push_key(5, true));
+    ASSERT_TRUE(wait_for_frame(emulator, [](const Frame& frame) { return frame.registers[0] == 5; }));
+    emulator.push_key(5, false);
+}
+
+TEST(emulator_thread, pause_and_step) {
+    Chip8 chip8;
+    chip8.load_from_buffer(counter);
+    Debugger debugger;
+    EmulatorThread emulator(chip8);
+    emulator.set_debugger(&debugger);
+    emulator.start();
+    ASSERT_TRUE(wait_for_frame(emulator, [](const Frame& frame) { return frame.registers[0] >= 5; }));
+
+    emulator.set_paused(true);
+    ASSERT_TRUE(emulator.paused());
+    // The frame in flight when the pause was asked, and the one published on pausing.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    while (emulator.update_frame()) {
+    }
+    auto paused = emulator.frame();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(emulator.update_frame());
+    ASSERT_EQ(paused.pc, chip8.pc());
+
+    // One instruction, published.
+    emulator.step();
+    ASSERT_TRUE(wait_for_frame(emulator, [&](const Frame& frame) { return frame.pc != paused.pc; }));
+    ASSERT_EQ(paused.sequence + 1, emulator.frame().sequence);
+
+    emulator.set_paused(false);
+    auto count = emulator.frame().registers[0];
+    ASSERT_TRUE(wait_for_frame(emulator, [&](const Frame& frame) {
+        return static_cast<std::uint8_t>(frame.registers[0] - count) >= 5;
+    }));
+}
@@ -0,0 +1,69 @@
+// The jitter percentiles on known deviations, and what the pacer counts as a frame.
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "frame_pacer.h"
+
+using namespace snooz;
+
+TEST(frame_pacer, percentiles) {
+    // 1 to 100ms, shuffled.
+    std::vector<float> deviations;
+    for (int i = 1; i <= 100; i++) deviations.push_back(static_cast<float>(i));
+    std::shuffle(deviations.begin(), deviations.end(), std::minstd_rand(3));
+
+    auto jitter = summarize_jitter(deviations);
+    ASSERT_EQ(100u, jitter.frames);
+    ASSERT_EQ(50, jitter.p50);
+    ASSERT_EQ(90, jitter.p90);
+    ASSERT_EQ(99, jitter.p99);
+    ASSERT_EQ(100, jitter.max);
+
+    // A single late frame in a thousand shows in the maximum only.
+    std::vector<float> steady(999, 0.1f);
+    steady.push_back(8);
+    jitter = summarize_jitter(steady);
+    ASSERT_FLOAT_EQ(0.1f, jitter.p99);
+    ASSERT_EQ(8, jitter.max);
+
+    // Ten of them reach p99.
+    std::fill(steady.begin(), steady.begin() + 10, 8.f);
+    ASSERT_EQ(8, summarize_jitter(steady).p99);
+    ASSERT_FLOAT_EQ(0.1f, summarize_jitter(steady).p90);
+
+    jitter = summarize_jitter({0.25f});
+    ASSERT_EQ(1u, jitter.frames);
+    ASSERT_EQ(0.25, jitter.p50);
+    ASSERT_EQ(0.25, jitter.max);
+    ASSERT_EQ(0u, summarize_jitter({}).frames);
+}
+
+// A frame is the time between two waits: none before the second, none across a restart, and only the last ones kept.
+TEST(frame_pacer, frames_measured) {
+    using std::chrono::microseconds;
+    // Spinning the whole period: no scheduler slack in the way.
+    FramePacer pacer(microseconds(200), microseconds(200));
+    ASSERT_EQ(0u, pacer.jitter().frames);
+    pacer.wait();
+    ASSERT_EQ(0u, pacer.jitter().frames);
+    for (int i = 0; i < 10; i++) pacer.wait();
+    ASSERT_EQ(10u, pacer.jitter().frames);
+
+    // A pause of 50 periods is not a frame. How long the frames took depends on the machine: only their order is
+    // checked.
+    std::this_thread::sleep_for(microseconds(10000));
+    pacer.restart();
+    pacer.wait();
+    auto jitter = pacer.jitter();
+    ASSERT_EQ(10u, jitter.frames);
+    ASSERT_LE(jitter.p50, jitter.p90);
+    ASSERT_LE(jitter.p90, jitter.p99);
+    ASSERT_LE(jitter.p99, jitter.max);
+
+    for (int i = 0; i < 2000; i++) pacer.wait();
+    ASSERT_EQ(1024u, pacer.jitter().frames);
+}
@@ -0,0 +1,111 @@
+// Whole games, headless, with the same scripted input: the framebuffer hashes at every checkpoint must match the
+// ones in golden/frames.txt. Run with CHIP8_UPDATE_GOLDEN=1 (or build the update_golden target) to rewrite them
+// after a change that is supposed to alter the output.
+
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <map>
+#include <sstream>
+#include <gtest/gtest.h>
+#include "headless.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+constexpr std::uint64_t frames = 600;
+constexpr std::uint64_t checkpoint_interval = 60;
+
+using Checkpoints = std::vector<std::uint64_t>;
+
+Checkpoints run_game(RomSpan rom, const std::vector<ScriptedKey>& input) {
+    Chip8 chip8;
+    chip8.seed(0);
+    chip8.load_rom(rom);
+
+    HeadlessOptions options;
+    options.frames = frames;
+    options.input = input;
+    options.checkpoint_interval = checkpoint_interval;
+    return run_headless(chip8, options).checkpoints;
+}
+
+// One line per checkpoint: `<game> <frame> <hash in hex>`.
+std::map<std::string, Checkpoints> read_golden(std::istream& in) {
+    std::map<std::string, Checkpoints> golden;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream ss(line);
+        std::string name;
+        std::uint64_t frame;
+        std::uint64_t hash;
+        if (ss >> name >> frame >> std::hex >> hash) golden[name].push_back(hash);
+    }
+    return golden;
+}
+
+void write_golden(std::ostream& out, const std::map<std::string, Checkpoints>& games) {
+    out << "# Framebuffer hashes (FNV-1a of Chip8::gfx) of golden_test: `<game> <frame> <hash>`.\n";
+    out << "# Generated with CHIP8_UPDATE_GOLDEN=1, do not edit.\n";
+    for (auto& game: games) {
+        for (std::size_t i = 0; i < game.second.size(); i++) {
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(game.second[i]));
+            out << game.first << ' ' << (i + 1) * checkpoint_interval << ' ' << hash << '\n';
+        }
+    }
+}
+
+}
+
+TEST(golden, frames) {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    ASSERT_FALSE(library.entries().empty());
+
+    std::ifstream script(CHIP8_GOLDEN_DIR "/input.txt");
+    ASSERT_TRUE(script.good()) << "missing " CHIP8_GOLDEN_DIR "/input.txt";
+    auto input = parse_input_script(script);
+    ASSERT_FALSE(input.empty());
+
+    // Each game on its own thread: the games are independent and the suite is as long as the slowest one.
+    std::map<std::string, std::future<Checkpoints>> runs;
+    for (auto& entry: library.entries()) {
+        runs.emplace(entry.name, std::async(std::launch::async, run_game, entry.rom, std::cref(input)));
+    }
+    std::map<std::string, Checkpoints> games;
+    for (auto& run: runs) games[run.first] = run.second.get();
+
+    auto update = std::getenv("CHIP8_UPDATE_GOLDEN");
+    if (update != nullptr && std::string(update) != "0") {
+        std::ofstream out(CHIP8_GOLDEN_DIR "/frames.txt");
+        write_golden(out, games);
+        ASSERT_TRUE(out.good()) << "cannot write " CHIP8_GOLDEN_DIR "/frames.txt";
+        return;
+    }
+
+    std::ifstream in(CHIP8_GOLDEN_DIR "/frames.txt");
+    ASSERT_TRUE(in.good()) << "missing " CHIP8_GOLDEN_DIR "/frames.txt, run with CHIP8_UPDATE_GOLDEN=1";
+    auto golden = read_golden(in);
+
+    for (auto& game: games) {
+        auto expected = golden.find(game.first);
+        if (expected == golden.end()) {
+            ADD_FAILURE() << game.first << ": no golden frames";
+            continue;
+        }
+        EXPECT_EQ(expected->second.size(), game.second.size()) << game.first << ": number of checkpoints";
+        for (std::size_t i = 0; i < std::min(expected->second.size(), game.second.size()); i++) {
+            if (expected->second[i] != game.second[i]) {
+                ADD_FAILURE() << game.first << ": framebuffer differs at frame " << (i + 1) * checkpoint_interval;
+                break;
+            }
+        }
+    }
+    EXPECT_EQ(golden.size(), games.size()) << "games were added or removed";
+}
@@ -0,0 +1,68 @@
+// Input scripts, and the counts run_headless reports.
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#include "headless.h"
+
+using namespace snooz;
+
+namespace {
+
+std::vector<ScriptedKey> parse(const std::string& text) {
+    std::istringstream in(text);
+    return parse_input_script(in);
+}
+
+}
+
+TEST(headless, input_script) {
+    auto events = parse("# start\n0 5 down\n\n10 a up\n10 F down\n");
+    ASSERT_EQ(3u, events.size());
+    ASSERT_EQ(0u, events[0].frame);
+    ASSERT_EQ(5, events[0].key);
+    ASSERT_TRUE(events[0].pressed);
+    ASSERT_EQ(10u, events[1].frame);
+    ASSERT_EQ(0xA, events[1].key);
+    ASSERT_FALSE(events[1].pressed);
+    ASSERT_EQ(0xF, events[2].key);
+}
+
+TEST(headless, input_script_errors) {
+    ASSERT_THROW(parse("0 5 dwon\n"), std::invalid_argument);
+    ASSERT_THROW(parse("0 5\n"), std::invalid_argument);
+    ASSERT_THROW(parse("x 5 down\n"), std::invalid_argument);
+    ASSERT_THROW(parse("0 10 down\n"), std::invalid_argument);
+    ASSERT_THROW(parse("0 5 down now\n"), std::invalid_argument);
+    // Out of order: the earlier event would never be played.
+    ASSERT_THROW(parse("10 5 down\n3 5 up\n"), std::invalid_argument);
+    try {
+        parse("0 5 down\n\n4 5 dwon\n");
+        FAIL();
+    } catch (const std::invalid_argument& error) {
+        ASSERT_EQ("line 3: unknown action: 4 5 dwon", std::string(error.what()));
+    }
+}
+
+// A return with an empty stack stops the machine on the first instruction: the rest of the frame is not counted.
+TEST(headless, halt_stops_counting) {
+    Chip8 chip8;
+    chip8.load_from_buffer({0x00, 0xEE});
+    HeadlessOptions options;
+    options.frames = 5;
+    options.instructions_per_frame = 10;
+    auto result = run_headless(chip8, options);
+    ASSERT_FALSE(chip8.should_continue());
+    ASSERT_EQ(1u, result.instructions);
+    ASSERT_EQ(1u, result.frames);
+
+    // And the instruction limit holds in the middle of a frame. 1200: jump to itself.
+    Chip8 loop;
+    loop.load_from_buffer({0x12, 0x00});
+    options.frames = 0;
+    options.instructions = 25;
+    result = run_headless(loop, options);
+    ASSERT_EQ(25u, result.instructions);
+    ASSERT_EQ(3u, result.frames);
+}
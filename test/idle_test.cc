@@ -0,0 +1,71 @@
+// Skipping over idle loops must leave the machine exactly where running them would.
+
+#include <random>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+// Up to count instructions, idle loops skipped. Like run_cycles otherwise.
+std::uint64_t run_skipping(Chip8& chip8, std::uint64_t count) {
+    std::uint64_t executed = 0;
+    while (executed < count && chip8.should_continue()) {
+        auto skipped = chip8.skip_idle(count - executed);
+        if (skipped == 0) {
+            chip8.emulateCycle();
+            skipped = 1;
+        }
+        executed += skipped;
+    }
+    return executed;
+}
+
+}
+
+TEST(idle, skip_matches_run) {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    ASSERT_FALSE(library.entries().empty());
+
+    std::uint64_t total_skipped = 0;
+    for (auto& entry: library.entries()) {
+        Chip8 reference;
+        Chip8 skipping;
+        for (auto chip8: {&reference, &skipping}) {
+            chip8->seed(0);
+            chip8->load_rom(entry.rom);
+        }
+
+        std::minstd_rand input(1);
+        NoHooks hooks;
+        for (int frame = 0; frame < 1200; frame++) {
+            // Keys change rarely so that the games spend time waiting.
+            if (frame % 45 == 0) {
+                std::size_t key = input() % 16;
+                auto pressed = input() % 2 == 0;
+                for (auto chip8: {&reference, &skipping}) {
+                    if (pressed) {
+                        chip8->set_key_pressed(key);
+                    } else {
+                        chip8->set_key_released(key);
+                    }
+                }
+            }
+
+            auto idle = skipping.idle() != Idle::No;
+            auto before = skipping.cycles();
+            reference.run_cycles(reference.instructions_per_frame(), hooks);
+            run_skipping(skipping, skipping.instructions_per_frame());
+            if (idle) total_skipped += skipping.cycles() - before;
+
+            ASSERT_EQ(reference.should_continue(), skipping.should_continue()) << entry.name << " frame " << frame;
+            ASSERT_EQ(reference.state_hash(), skipping.state_hash()) << entry.name << " frame " << frame;
+            ASSERT_EQ(reference.cycles(), skipping.cycles()) << entry.name << " frame " << frame;
+            ASSERT_EQ(reference.opcode(), skipping.opcode()) << entry.name << " frame " << frame;
+        }
+    }
+    // Most games wait on a key or the delay timer at some point.
+    EXPECT_GT(total_skipped, 0u);
+}
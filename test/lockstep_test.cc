@@ -0,0 +1,85 @@
+// Every engine must match the reference op_XXXX implementations, instruction by instruction.
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "decoder.h"
+#include "lockstep.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+TEST(lockstep, flat_table_on_games) {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    ASSERT_FALSE(library.entries().empty());
+
+    for (auto& entry: library.entries()) {
+        LockstepOptions options;
+        auto result = run_lockstep(entry.rom, options);
+
+        std::ostringstream report;
+        write_report(report, entry.name, result);
+        EXPECT_FALSE(result.diverged) << report.str();
+    }
+}
+
+TEST(lockstep, flat_table_on_random_programs) {
+    for (std::uint32_t seed = 0; seed < 200; seed++) {
+        auto program = random_program(seed, 256);
+        LockstepOptions options;
+        options.seed = seed;
+        options.instructions = 5000;
+        auto result = run_lockstep(RomSpan{program.data(), program.size()}, options);
+
+        std::ostringstream report;
+        write_report(report, "random program " + std::to_string(seed), result);
+        EXPECT_FALSE(result.diverged) << report.str();
+    }
+}
+
+// The checker itself: a candidate with other quirks diverges on the first instruction they change, and the report
+// names what differs and ends with that instruction.
+TEST(lockstep, reports_divergence) {
+    // V1 = 5, V2 = 3, V1 >>= 1 (or V1 = V2 >> 1), then a jump to itself.
+    const std::vector<std::uint8_t> program = {0x61, 0x05, 0x62, 0x03, 0x81, 0x26, 0x12, 0x06};
+    Quirks quirks;
+    quirks.shift_uses_vy = true;
+    LockstepOptions options;
+    options.instructions = 100;
+    options.history = 2;
+    options.candidate_quirks = &quirks;
+    auto result = run_lockstep(RomSpan{program.data(), program.size()}, options);
+
+    ASSERT_TRUE(result.diverged);
+    ASSERT_EQ(3u, result.instructions);
+    ASSERT_EQ("V[0x1]", result.difference);
+    Decoder decoder;
+    ASSERT_EQ((std::vector<std::string>{decoder.interpret(0x6203, 0x202), decoder.interpret(0x8126, 0x204)}),
+              result.trace);
+
+    std::ostringstream report;
+    write_report(report, "shift", result);
+    ASSERT_EQ("shift: V[0x1] differs after instruction 3\n"
+              "    " + result.trace[0] + "\n"
+              "    " + result.trace[1] + "\n", report.str());
+
+    // Without the override, both run with the quirks of the profile: no divergence.
+    auto same = run_lockstep(RomSpan{program.data(), program.size()}, LockstepOptions{});
+    ASSERT_FALSE(same.diverged);
+    ASSERT_EQ(20000u, same.instructions);
+}
+
+TEST(lockstep, reports_jump_divergence) {
+    // V0 = 2, V3 = 4, B306: jumps to 0x308 with V0, 0x30A with V3.
+    const std::vector<std::uint8_t> program = {0x60, 0x02, 0x63, 0x04, 0xB3, 0x06};
+    Quirks quirks;
+    quirks.jump_uses_vx = true;
+    LockstepOptions options;
+    options.candidate_quirks = &quirks;
+    auto result = run_lockstep(RomSpan{program.data(), program.size()}, options);
+    ASSERT_TRUE(result.diverged);
+    ASSERT_EQ("pc", result.difference);
+    ASSERT_EQ(3u, result.trace.size());
+    ASSERT_EQ(Decoder().interpret(0xB306, 0x204), result.trace.back());
+}
@@ -21,6 +21,14 @@ public:
     }
 };
 
+// Load source with the quirks given instead of those of its profile, and run its first instructions.
+void run_with_quirks(Chip8FreeAccess& chip8, const std::vector<uint8_t>& source, const snooz::Quirks& quirks,
+                     int cycles) {
+    chip8.load_from_buffer(source);
+    chip8.set_quirks(quirks);
+    for (int i = 0; i < cycles; i++) chip8.emulateCycle();
+}
+
 TEST(opcode, op_annn) {
     Chip8FreeAccess chip8;
 
@@ -169,6 +177,45 @@ TEST(opcode, draw_dxyn) {
 
 }
 
+// Sprites going past the right or bottom edge wrap around to the other side.
+TEST(opcode, draw_dxyn_wraps) {
+    Chip8FreeAccess chip8;
+
+    std::vector<uint8_t> source{
+            0x61, 0x3C, // V1 = 60
+            0x62, 0x1E, // V2 = 30
+            0xA2, 0x0A, // I = 20A
+            0xD1, 0x24, // draw 4 rows at (60, 30)
+            0x12, 0x08, // loop
+            0xFF, 0x81, 0x81, 0xFF};
+    chip8.load_from_buffer(source);
+    for (int i = 0; i < 4; i++) chip8.emulateCycle();
+
+    std::array<uint8_t, 4> rows{0xFF, 0x81, 0x81, 0xFF};
+    std::array<int, 4> screen_rows{30, 31, 0, 1};
+    int lit = 0;
+    for (auto pixel: chip8.gfx()) lit += pixel;
+    ASSERT_EQ(20, lit);
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 8; column++) {
+            auto x = (60 + column) % 64;
+            ASSERT_EQ((rows[row] >> (7 - column)) & 1, chip8.gfx()[screen_rows[row] * 64 + x])
+                    << "row " << row << " column " << column;
+        }
+    }
+    ASSERT_EQ(0, chip8.V()[0xF]);
+}
+
+// A new machine starts from zeroed registers, stack and memory, apart from the font.
+TEST(opcode, construction_zeroes_state) {
+    Chip8FreeAccess chip8;
+
+    for (auto value: chip8.V()) ASSERT_EQ(0, value);
+    for (auto address: chip8.stacks()) ASSERT_EQ(0, address);
+    for (std::size_t address = 0x200; address < 0x1000; address++) ASSERT_EQ(0, chip8.memory()[address]);
+    for (auto pixel: chip8.gfx()) ASSERT_EQ(0, pixel);
+}
+
 TEST(opcode, cond_3xnn) {
     Chip8FreeAccess chip8;
 
@@ -276,6 +323,60 @@ TEST(opcode, delay_FX07) {
     ASSERT_EQ(0x03, chip8.V()[0xB]);
 }
 
+// The timers tick by themselves every instructions_per_frame instructions.
+TEST(opcode, timers_follow_cycles) {
+    snooz::Chip8 chip8;
+
+    // V1 = 5, delay = V1, sound = V1, then loop forever.
+    std::vector<uint8_t> source{0x61, 0x05, 0xF1, 0x15, 0xF1, 0x18, 0x12, 0x06};
+    chip8.load_from_buffer(source);
+    chip8.set_instructions_per_frame(10);
+
+    for (int i = 0; i < 3; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x05, chip8.delay_timer());
+    for (int i = 0; i < 7; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x04, chip8.delay_timer());
+    // The sound was still on during the last instruction of the frame.
+    ASSERT_TRUE(chip8.sound_active());
+    for (int i = 0; i < 40; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x00, chip8.delay_timer());
+    ASSERT_EQ(0x00, chip8.sound_timer());
+    ASSERT_TRUE(chip8.sound_active());
+    chip8.emulateCycle();
+    ASSERT_FALSE(chip8.sound_active());
+}
+
+// A snapshot keeps the phase of the timer clock, even after the speed changed in the middle of a frame.
+TEST(opcode, restore_keeps_timer_phase) {
+    // V1 = 0x30, delay = V1, sound = V1, then count in V2 forever.
+    std::vector<uint8_t> source{0x61, 0x30, 0xF1, 0x15, 0xF1, 0x18, 0x72, 0x01, 0x12, 0x06};
+    snooz::Chip8 reference;
+    snooz::Chip8 restored;
+    for (auto chip8: {&reference, &restored}) {
+        chip8->load_from_buffer(source);
+        chip8->set_instructions_per_frame(10);
+        for (int i = 0; i < 13; i++) chip8->emulateCycle();
+        chip8->set_instructions_per_frame(7);
+        for (int i = 0; i < 5; i++) chip8->emulateCycle();
+    }
+
+    // Into a machine that ran something else, with the same speed.
+    auto snapshot = restored.snapshot();
+    restored.reset();
+    restored.load_from_buffer(source);
+    restored.set_instructions_per_frame(7);
+    restored.restore(snapshot);
+
+    for (int i = 0; i < 400; i++) {
+        ASSERT_EQ(reference.delay_timer(), restored.delay_timer()) << "instruction " << i;
+        ASSERT_EQ(reference.sound_timer(), restored.sound_timer()) << "instruction " << i;
+        ASSERT_EQ(reference.sound_active(), restored.sound_active()) << "instruction " << i;
+        reference.emulateCycle();
+        restored.emulateCycle();
+    }
+    ASSERT_EQ(0, reference.delay_timer());
+}
+
 TEST(opcode, keyboard_notpressed_op_EXA1_keypressed) {
     // will skip next instrution if key stored in VX is pressed.
     Chip8FreeAccess chip8;
@@ -423,3 +524,199 @@ TEST(opcode, op_FX33) {
     ASSERT_EQ(0x05, chip8.memory()[0x201]);
     ASSERT_EQ(0x05, chip8.memory()[0x202]);
 }
+
+// A call deeper than the 16 entries of the stack stops the machine instead of writing past the stack.
+TEST(opcode, op_2NNN_stack_overflow) {
+    Chip8FreeAccess chip8;
+
+    std::vector<uint8_t> source{0x22, 0x00}; // call itself
+    chip8.load_from_buffer(source);
+
+    for (int i = 0; i < 16; i++) chip8.emulateCycle();
+    ASSERT_TRUE(chip8.should_continue());
+    ASSERT_EQ(16, chip8.sp());
+
+    chip8.emulateCycle();
+    ASSERT_FALSE(chip8.should_continue());
+    ASSERT_EQ(16, chip8.sp());
+    ASSERT_EQ(0x200, chip8.pc());
+    for (auto address: chip8.stacks()) ASSERT_EQ(0x200, address);
+}
+
+TEST(opcode, op_00EE_stack_underflow) {
+    Chip8FreeAccess chip8;
+
+    std::vector<uint8_t> source{0x00, 0xEE};
+    chip8.load_from_buffer(source);
+
+    chip8.emulateCycle();
+    ASSERT_FALSE(chip8.should_continue());
+    ASSERT_EQ(0, chip8.sp());
+    ASSERT_EQ(0x200, chip8.pc());
+}
+
+// Addresses from I wrap at 0xFFF to the start of memory.
+TEST(opcode, memory_wraps_at_fff) {
+    Chip8FreeAccess chip8;
+
+    std::vector<uint8_t> source{
+            0x60, 0x11, // V0 = 0x11
+            0x61, 0x22, // V1 = 0x22
+            0x62, 0x33, // V2 = 0x33
+            0xAF, 0xFE, // I = FFE
+            0xF2, 0x55, // store V0 to V2 at FFE, FFF, 000
+            0x60, 0x00, // V0 = 0
+            0x61, 0x00, // V1 = 0
+            0x62, 0x00, // V2 = 0
+            0xF2, 0x65, // load V0 to V2 from FFE, FFF, 000
+            0x63, 0x00, // V3 = 0
+            0xD3, 0x33, // draw 3 rows from FFE at (0, 0)
+            0x64, 0xFF, // V4 = 255
+            0xF4, 0x33, // BCD at FFE, FFF, 000
+    };
+    chip8.load_from_buffer(source);
+    // Font data, after the last byte written.
+    auto font = chip8.memory()[0x001];
+
+    for (int i = 0; i < 5; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x11, chip8.memory()[0xFFE]);
+    ASSERT_EQ(0x22, chip8.memory()[0xFFF]);
+    ASSERT_EQ(0x33, chip8.memory()[0x000]);
+    ASSERT_EQ(font, chip8.memory()[0x001]);
+
+    for (int i = 0; i < 4; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x11, chip8.V()[0]);
+    ASSERT_EQ(0x22, chip8.V()[1]);
+    ASSERT_EQ(0x33, chip8.V()[2]);
+
+    for (int i = 0; i < 2; i++) chip8.emulateCycle();
+    auto& gfx = chip8.gfx();
+    std::array<uint8_t, 3> rows{0x11, 0x22, 0x33};
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 8; x++) ASSERT_EQ((rows[y] >> (7 - x)) & 1, gfx[y * 64 + x]);
+    }
+    ASSERT_EQ(0, gfx[3 * 64 + 2]);
+
+    for (int i = 0; i < 2; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x02, chip8.memory()[0xFFE]);
+    ASSERT_EQ(0x05, chip8.memory()[0xFFF]);
+    ASSERT_EQ(0x05, chip8.memory()[0x000]);
+    ASSERT_EQ(font, chip8.memory()[0x001]);
+    ASSERT_TRUE(chip8.should_continue());
+}
+
+// Only the low nibble of VX is a key.
+TEST(opcode, key_index_wraps) {
+    Chip8FreeAccess chip8;
+
+    std::vector<uint8_t> source{
+            0x61, 0x13, // V1 = 0x13: key 3
+            0xE1, 0x9E, // skip if key 3 is pressed
+            0x62, 0x01, // V2 = 1, skipped
+            0x61, 0xFF, // V1 = 0xFF: key F
+            0xE1, 0xA1, // skip if key F is not pressed
+            0x62, 0x02, // V2 = 2, skipped
+            0x63, 0x01, // V3 = 1
+    };
+    chip8.load_from_buffer(source);
+    chip8.set_key_pressed(3);
+
+    for (int i = 0; i < 5; i++) chip8.emulateCycle();
+    ASSERT_EQ(0x00, chip8.V()[0x2]);
+    ASSERT_EQ(0x01, chip8.V()[0x3]);
+    ASSERT_EQ(0x20E, chip8.pc());
+}
+
+TEST(opcode, quirk_shift_uses_vy) {
+    // V1 = 0x84, V2 = 3, V1 >>= 1 / V1 = V2 >> 1, then V3 = 0x84, V3 <<= 1 / V3 = V2 << 1.
+    std::vector<uint8_t> source{0x61, 0x84, 0x62, 0x03, 0x81, 0x26, 0x63, 0x84, 0x83, 0x2E};
+    for (auto on: {false, true}) {
+        Chip8FreeAccess chip8;
+        snooz::Quirks quirks;
+        quirks.shift_uses_vy = on;
+        run_with_quirks(chip8, source, quirks, 3);
+        ASSERT_EQ(on ? 0x01 : 0x42, chip8.V()[1]) << on;
+        ASSERT_EQ(on ? 1 : 0, chip8.V()[0xF]) << on;
+        ASSERT_EQ(3, chip8.V()[2]) << on;
+
+        chip8.emulateCycle();
+        chip8.emulateCycle();
+        ASSERT_EQ(on ? 0x06 : 0x08, chip8.V()[3]) << on;
+        ASSERT_EQ(on ? 0 : 1, chip8.V()[0xF]) << on;
+    }
+}
+
+TEST(opcode, quirk_load_store_increments_i) {
+    // I = 0x300, V0 = 1, V1 = 2, store V0..V1, then load V0..V1 from I.
+    std::vector<uint8_t> source{0xA3, 0x00, 0x60, 0x01, 0x61, 0x02, 0xF1, 0x55, 0xF1, 0x65};
+    for (auto on: {false, true}) {
+        Chip8FreeAccess chip8;
+        snooz::Quirks quirks;
+        quirks.load_store_increments_i = on;
+        run_with_quirks(chip8, source, quirks, 4);
+        ASSERT_EQ(1, chip8.memory()[0x300]) << on;
+        ASSERT_EQ(2, chip8.memory()[0x301]) << on;
+        ASSERT_EQ(on ? 0x302 : 0x300, chip8.I()) << on;
+
+        chip8.emulateCycle();
+        ASSERT_EQ(on ? 0x304 : 0x300, chip8.I()) << on;
+        // Read back from 0x302 with the quirk: nothing stored there.
+        ASSERT_EQ(on ? 0 : 1, chip8.V()[0]) << on;
+    }
+}
+
+TEST(opcode, quirk_jump_uses_vx) {
+    // V0 = 2, V3 = 4, B306.
+    std::vector<uint8_t> source{0x60, 0x02, 0x63, 0x04, 0xB3, 0x06};
+    for (auto on: {false, true}) {
+        Chip8FreeAccess chip8;
+        snooz::Quirks quirks;
+        quirks.jump_uses_vx = on;
+        run_with_quirks(chip8, source, quirks, 3);
+        ASSERT_EQ(on ? 0x30A : 0x308, chip8.pc()) << on;
+    }
+}
+
+TEST(opcode, quirk_clip_sprites) {
+    std::vector<uint8_t> source{
+            0x61, 0x3C, // V1 = 60
+            0x62, 0x1E, // V2 = 30
+            0xA2, 0x0A, // I = 20A
+            0xD1, 0x24, // draw 4 rows at (60, 30)
+            0x12, 0x08, // loop
+            0xFF, 0xFF, 0xFF, 0xFF};
+    for (auto on: {false, true}) {
+        Chip8FreeAccess chip8;
+        snooz::Quirks quirks;
+        quirks.clip_sprites = on;
+        run_with_quirks(chip8, source, quirks, 4);
+        int lit = 0;
+        for (auto pixel: chip8.gfx()) lit += pixel;
+        // 2 rows of 4 pixels on the screen, or the whole 8x4 sprite wrapped around.
+        ASSERT_EQ(on ? 8 : 32, lit) << on;
+        ASSERT_EQ(1, chip8.gfx()[30 * 64 + 63]) << on;
+        ASSERT_EQ(on ? 0 : 1, chip8.gfx()[30 * 64 + 0]) << on;
+        ASSERT_EQ(on ? 0 : 1, chip8.gfx()[0 * 64 + 60]) << on;
+    }
+}
+
+TEST(opcode, quirk_logic_resets_vf) {
+    // VF = 5, V1 = 3, V2 = 5, then OR, AND and XOR, VF set back to 5 before each.
+    std::vector<uint8_t> source{0x61, 0x03, 0x62, 0x05,
+                                0x6F, 0x05, 0x81, 0x21,
+                                0x6F, 0x05, 0x81, 0x22,
+                                0x6F, 0x05, 0x81, 0x23};
+    for (auto on: {false, true}) {
+        Chip8FreeAccess chip8;
+        snooz::Quirks quirks;
+        quirks.logic_resets_vf = on;
+        run_with_quirks(chip8, source, quirks, 2);
+        std::array<uint8_t, 3> results{0x07, 0x05, 0x00};
+        for (auto result: results) {
+            chip8.emulateCycle();
+            chip8.emulateCycle();
+            ASSERT_EQ(result, chip8.V()[1]) << on;
+            ASSERT_EQ(on ? 0 : 5, chip8.V()[0xF]) << on;
+        }
+    }
+}
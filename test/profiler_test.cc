@@ -0,0 +1,131 @@
+// Profiler counters, the report built from them, and reset().
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "decoder.h"
+#include "profiler.h"
+
+using namespace snooz;
+
+namespace {
+
+// Executions of the profiler: 200: V0 = 5 (100 times), 202: jump 200 (28 times).
+void run_loop(Profiler& profiler) {
+    for (int i = 0; i < 128; i++) {
+        auto pc = static_cast<std::uint16_t>(i < 100 ? 0x200 : 0x202);
+        auto opcode = static_cast<std::uint16_t>(i < 100 ? 0x6005 : 0x1200);
+        profiler.leave(profiler.enter(pc, opcode), opcode);
+    }
+}
+
+std::array<std::uint8_t, 4096> loop_memory() {
+    std::array<std::uint8_t, 4096> memory{};
+    memory[0x200] = 0x60;
+    memory[0x201] = 0x05;
+    memory[0x202] = 0x12;
+    memory[0x203] = 0x00;
+    return memory;
+}
+
+}
+
+TEST(profiler, opcode_classes) {
+    const std::vector<std::pair<std::uint16_t, std::string>> opcodes = {
+            {0x00E0, "00E0"}, {0x00EE, "00EE"}, {0x0123, "unknown"}, {0x1234, "1NNN"}, {0x2345, "2NNN"},
+            {0x3A12, "3XNN"}, {0x4A12, "4XNN"}, {0x5AB0, "5XY0"}, {0x6A12, "6XNN"}, {0x7A12, "7XNN"},
+            {0x8AB0, "8XY0"}, {0x8AB4, "8XY4"}, {0x8AB7, "8XY7"}, {0x8ABE, "8XYE"}, {0x8AB8, "unknown"},
+            {0x9AB0, "9XY0"}, {0xA123, "ANNN"}, {0xB123, "BNNN"}, {0xCA12, "CXNN"}, {0xDAB5, "DXYN"},
+            {0xEA9E, "EX9E"}, {0xEAA1, "EXA1"}, {0xEA00, "unknown"}, {0xFA07, "FX07"}, {0xFA0A, "FX0A"},
+            {0xFA15, "FX15"}, {0xFA18, "FX18"}, {0xFA1E, "FX1E"}, {0xFA29, "FX29"}, {0xFA33, "FX33"},
+            {0xFA55, "FX55"}, {0xFA65, "FX65"}, {0xFAFF, "unknown"},
+    };
+    for (auto& opcode: opcodes) {
+        auto op_class = Profiler::opcode_class(opcode.first);
+        ASSERT_LT(op_class, Profiler::class_count);
+        ASSERT_EQ(opcode.second, Profiler::class_name(op_class)) << std::hex << opcode.first;
+    }
+    ASSERT_EQ(std::string("invalid"), Profiler::class_name(Profiler::class_count));
+}
+
+TEST(profiler, counters) {
+    Profiler profiler;
+    // One instruction out of sample_period is timed.
+    std::size_t sampled = 0;
+    for (std::uint64_t i = 0; i < 3 * Profiler::sample_period; i++) {
+        auto start = profiler.enter(0x300, 0x00E0);
+        if (start != 0) sampled++;
+        profiler.leave(start, 0x00E0);
+    }
+    ASSERT_EQ(3u, sampled);
+    profiler.reset();
+
+    run_loop(profiler);
+    ASSERT_EQ(100u, profiler.class_executions(Profiler::opcode_class(0x6005)));
+    ASSERT_EQ(28u, profiler.class_executions(Profiler::opcode_class(0x1200)));
+    ASSERT_EQ(0u, profiler.class_executions(Profiler::opcode_class(0x00E0)));
+    ASSERT_EQ(100u, profiler.pc_executions(0x200));
+    ASSERT_EQ(28u, profiler.pc_executions(0x202));
+    ASSERT_EQ(0u, profiler.pc_executions(0x300));
+    // Addresses wrap like the core's.
+    ASSERT_EQ(100u, profiler.pc_executions(0x1200));
+}
+
+TEST(profiler, report) {
+    Profiler profiler;
+    run_loop(profiler);
+    Decoder decoder;
+    auto memory = loop_memory();
+    std::ostringstream out;
+    profiler.report(out, decoder, memory, 1);
+    auto report = out.str();
+
+    ASSERT_EQ(0u, report.find("Opcode classes (128 instructions)\n"));
+    // Most executed first.
+    auto load = report.find("6XNN");
+    auto jump = report.find("1NNN");
+    ASSERT_NE(std::string::npos, load);
+    ASSERT_LT(load, jump);
+    ASSERT_NE(std::string::npos, report.find("      100  78.12% "));
+    ASSERT_NE(std::string::npos, report.find("       28  21.88% "));
+    // Only the hottest address, disassembled.
+    ASSERT_NE(std::string::npos, report.find(decoder.interpret(0x6005, 0x200)));
+    ASSERT_EQ(std::string::npos, report.find(decoder.interpret(0x1200, 0x202)));
+}
+
+TEST(profiler, reset_clears_everything) {
+    Profiler profiler;
+    run_loop(profiler);
+    profiler.reset();
+    for (std::size_t op_class = 0; op_class < Profiler::class_count; op_class++) {
+        ASSERT_EQ(0u, profiler.class_executions(op_class));
+    }
+    for (std::uint16_t pc = 0; pc < 4096; pc++) ASSERT_EQ(0u, profiler.pc_executions(pc));
+
+    Decoder decoder;
+    std::ostringstream out;
+    profiler.report(out, decoder, loop_memory());
+    ASSERT_EQ("No instruction executed\n", out.str());
+
+    // The sampling starts over too.
+    std::size_t sampled = 0;
+    for (std::uint64_t i = 0; i < Profiler::sample_period; i++) {
+        if (profiler.enter(0x200, 0x6005) != 0) sampled++;
+    }
+    ASSERT_EQ(1u, sampled);
+}
+
+#ifdef CHIP8_PROFILE
+TEST(profiler, core_counts) {
+    Chip8 chip8;
+    chip8.load_from_buffer({0x60, 0x05, 0x12, 0x00});
+    for (int i = 0; i < 10; i++) chip8.emulateCycle();
+    ASSERT_EQ(5u, chip8.profiler().pc_executions(0x200));
+    ASSERT_EQ(5u, chip8.profiler().pc_executions(0x202));
+    ASSERT_EQ(5u, chip8.profiler().class_executions(Profiler::opcode_class(0x1200)));
+}
+#endif
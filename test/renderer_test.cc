@@ -0,0 +1,163 @@
+// The renderer against a plain per-pixel reference, and partial redraws against full ones.
+
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "renderer.h"
+
+using namespace snooz;
+
+namespace {
+
+// Scale2x straight from its description, on pixel values, the pixel itself standing for its neighbours out of the
+// screen.
+std::vector<std::uint8_t> reference_scale2x(const FramebufferView& view) {
+    auto width = view.width * 2;
+    std::vector<std::uint8_t> doubled(width * view.height * 2);
+    for (std::size_t y = 0; y < view.height; y++) {
+        for (std::size_t x = 0; x < view.width; x++) {
+            auto at = [&](long dx, long dy) {
+                long nx = x + dx, ny = y + dy;
+                if (nx < 0 || ny < 0 || nx >= static_cast<long>(view.width) || ny >= static_cast<long>(view.height)) {
+                    return view.pixels[y * view.stride + x];
+                }
+                return view.pixels[ny * view.stride + nx];
+            };
+            auto p = at(0, 0), a = at(0, -1), b = at(1, 0), c = at(-1, 0), d = at(0, 1);
+            doubled[(2 * y) * width + 2 * x] = c == a && c != d && a != b ? a : p;
+            doubled[(2 * y) * width + 2 * x + 1] = a == b && a != c && b != d ? b : p;
+            doubled[(2 * y + 1) * width + 2 * x] = d == c && d != b && c != a ? c : p;
+            doubled[(2 * y + 1) * width + 2 * x + 1] = b == d && b != a && d != c ? d : p;
+        }
+    }
+    return doubled;
+}
+
+// What a target of that size should hold: the image scaled and centered on the background.
+std::vector<std::uint32_t> reference(const FramebufferView& view, Filter filter, const Palette& palette,
+                                     std::size_t target_width, std::size_t target_height) {
+    auto scale = std::min(target_width / view.width, target_height / view.height);
+    auto pixels = view.pixels;
+    auto width = view.width, height = view.height, stride = view.stride;
+    std::vector<std::uint8_t> doubled;
+    if (filter == Filter::Scale2x && scale >= 2) {
+        doubled = reference_scale2x(view);
+        pixels = doubled.data();
+        width *= 2, height *= 2, stride = width;
+        scale /= 2;
+    }
+    auto x0 = (target_width - width * scale) / 2;
+    auto y0 = (target_height - height * scale) / 2;
+
+    std::vector<std::uint32_t> result(target_width * target_height, palette.colors[0]);
+    for (std::size_t y = 0; y < height * scale; y++) {
+        for (std::size_t x = 0; x < width * scale; x++) {
+            result[(y0 + y) * target_width + x0 + x] = palette.colors[pixels[(y / scale) * stride + x / scale] & 3];
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint8_t> random_frame(std::minstd_rand& random, std::size_t size, unsigned values) {
+    std::vector<std::uint8_t> frame(size);
+    for (auto& pixel: frame) pixel = random() % 5 == 0 ? random() % values : 0;
+    return frame;
+}
+
+}
+
+TEST(renderer, nearest) {
+    std::array<std::uint8_t, 64 * 32> gfx{};
+    gfx[0] = 1;
+    gfx[31 * 64 + 63] = 1;
+    gfx[10 * 64 + 20] = 2;
+    gfx[10 * 64 + 21] = 3;
+
+    // Scale 3 in a target 2 pixels wider and 1 higher than the image: offsets of 1 and 0.
+    std::vector<std::uint32_t> pixels(194 * 97, 0x12345678);
+    Renderer renderer;
+    ASSERT_EQ(3u, renderer.render(FramebufferView::of(gfx), RgbaTarget{pixels.data(), 194, 97, 194}));
+    auto palette = default_palette();
+    ASSERT_EQ(reference(FramebufferView::of(gfx), Filter::Nearest, palette, 194, 97), pixels);
+
+    auto at = [&](std::size_t x, std::size_t y) { return pixels[y * 194 + x]; };
+    ASSERT_EQ(palette.colors[0], at(0, 0));
+    ASSERT_EQ(palette.colors[1], at(1, 0));
+    ASSERT_EQ(palette.colors[1], at(3, 2));
+    ASSERT_EQ(palette.colors[0], at(4, 0));
+    ASSERT_EQ(palette.colors[1], at(192, 95));
+    ASSERT_EQ(palette.colors[0], at(192, 96));
+    ASSERT_EQ(palette.colors[2], at(1 + 60, 30));
+    ASSERT_EQ(palette.colors[3], at(1 + 63, 32));
+}
+
+TEST(renderer, scale2x) {
+    // A diagonal: Scale2x fills the inner corners of the steps, nearest leaves them.
+    std::array<std::uint8_t, 64 * 32> gfx{};
+    gfx[1 * 64 + 1] = 1;
+    gfx[2 * 64 + 2] = 1;
+    gfx[3 * 64 + 3] = 1;
+
+    std::vector<std::uint32_t> pixels(128 * 64);
+    Renderer renderer(default_palette(), Filter::Scale2x);
+    ASSERT_EQ(2u, renderer.render(FramebufferView::of(gfx), RgbaTarget{pixels.data(), 128, 64, 128}));
+    auto palette = default_palette();
+    ASSERT_EQ(reference(FramebufferView::of(gfx), Filter::Scale2x, palette, 128, 64), pixels);
+    ASSERT_EQ(palette.colors[1], pixels[3 * 128 + 4]);
+    ASSERT_EQ(palette.colors[1], pixels[4 * 128 + 3]);
+    ASSERT_EQ(palette.colors[0], pixels[3 * 128 + 5]);
+
+    Renderer nearest;
+    nearest.render(FramebufferView::of(gfx), RgbaTarget{pixels.data(), 128, 64, 128});
+    ASSERT_EQ(palette.colors[0], pixels[3 * 128 + 4]);
+
+    // Scale 5: doubled, then 2 nearest, and centered.
+    std::vector<std::uint32_t> large(330 * 165);
+    ASSERT_EQ(5u, renderer.render(FramebufferView::of(gfx), RgbaTarget{large.data(), 330, 165, 330}));
+    ASSERT_EQ(reference(FramebufferView::of(gfx), Filter::Scale2x, palette, 330, 165), large);
+}
+
+TEST(renderer, too_small) {
+    std::array<std::uint8_t, 64 * 32> gfx{};
+    std::vector<std::uint32_t> pixels(63 * 32, 7);
+    Renderer renderer;
+    ASSERT_EQ(0u, renderer.render(FramebufferView::of(gfx), RgbaTarget{pixels.data(), 63, 32, 63}));
+    ASSERT_EQ(7u, pixels[0]);
+}
+
+// Frame after frame, drawing only the rows that changed gives the same image as drawing everything. Includes a
+// SCHIP size and a framebuffer with a stride larger than its width.
+TEST(renderer, partial_equals_full) {
+    std::minstd_rand random(11);
+    for (auto filter: {Filter::Nearest, Filter::Scale2x}) {
+        for (std::size_t width: {64, 128}) {
+            auto height = width / 2;
+            auto stride = width + 3;
+            const std::size_t target_width = 1000, target_height = 550;
+            std::vector<std::uint32_t> partial(target_width * target_height);
+            std::vector<std::uint32_t> full(target_width * target_height);
+            Renderer incremental(default_palette(), filter);
+            Renderer from_scratch(default_palette(), filter);
+
+            auto frame = random_frame(random, stride * height, 4);
+            for (int step = 0; step < 40; step++) {
+                // A few rows change, or none.
+                auto changes = random() % 4;
+                for (unsigned i = 0; i < changes; i++) frame[random() % (stride * height)] ^= 1 + random() % 3;
+                FramebufferView view{frame.data(), width, height, stride};
+
+                incremental.render(view, RgbaTarget{partial.data(), target_width, target_height, target_width});
+                from_scratch.invalidate();
+                from_scratch.render(view, RgbaTarget{full.data(), target_width, target_height, target_width});
+                ASSERT_EQ(full, partial) << static_cast<int>(filter) << ' ' << width << ' ' << step;
+            }
+            std::vector<std::uint8_t> compact(width * height);
+            for (std::size_t row = 0; row < height; row++) {
+                std::copy(frame.begin() + row * stride, frame.begin() + row * stride + width,
+                          compact.begin() + row * width);
+            }
+            ASSERT_EQ(reference(FramebufferView{compact.data(), width, height, width}, filter, default_palette(),
+                                target_width, target_height), full);
+        }
+    }
+}
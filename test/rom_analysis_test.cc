@@ -0,0 +1,101 @@
+// Loops and writes found by the static analysis, on hand-built ROMs.
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "rom_analysis.h"
+
+using namespace snooz;
+
+namespace {
+
+// Two nested counting loops, then a loop forever.
+const std::vector<std::uint8_t> nested_loops = {
+        0x60, 0x00,     // 200: V0 = 0
+        0x61, 0x00,     // 202: V1 = 0                  <- outer loop
+        0x71, 0x01,     // 204: V1 += 1                 <- inner loop
+        0x31, 0x05,     // 206: skip if V1 == 5
+        0x12, 0x04,     // 208: jump 204
+        0x70, 0x01,     // 20A: V0 += 1
+        0x30, 0x0A,     // 20C: skip if V0 == 10
+        0x12, 0x02,     // 20E: jump 202
+        0x12, 0x10,     // 210: jump 210
+};
+
+}
+
+TEST(rom_analysis, nested_loops) {
+    auto analysis = analyze_rom("nested", nested_loops);
+    auto& blocks = analysis.cfg.blocks;
+    ASSERT_EQ(7u, blocks.size());
+    // Blocks 200, 202, 204, 208, 20A, 20E and 210.
+    ASSERT_EQ((std::vector<int>{0, 1, 2, 2, 1, 1, 1}), analysis.loop_depth);
+
+    ASSERT_EQ(3u, analysis.loops.size());
+    auto& outer = analysis.loops[0];
+    ASSERT_EQ(0x202, blocks[outer.header].start);
+    ASSERT_EQ(1, outer.depth);
+    ASSERT_EQ((std::vector<int>{1, 2, 3, 4, 5}), outer.blocks);
+    auto& inner = analysis.loops[1];
+    ASSERT_EQ(0x204, blocks[inner.header].start);
+    ASSERT_EQ(2, inner.depth);
+    ASSERT_EQ((std::vector<int>{2, 3}), inner.blocks);
+    auto& forever = analysis.loops[2];
+    ASSERT_EQ(0x210, blocks[forever.header].start);
+    ASSERT_EQ(1, forever.depth);
+
+    // Nothing written at all.
+    ASSERT_TRUE(analysis.writable.none());
+    ASSERT_TRUE(analysis.safe_to_compile());
+}
+
+TEST(rom_analysis, store_into_code) {
+    // I = 206, V0 and V1 stored at 206 and 207, then run 206.
+    auto analysis = analyze_rom("store", {0xA2, 0x06, 0xF1, 0x55, 0x12, 0x06, 0x12, 0x06});
+    ASSERT_TRUE(analysis.writable[0x206]);
+    ASSERT_TRUE(analysis.writable[0x207]);
+    ASSERT_EQ(2u, analysis.writable.count());
+    ASSERT_FALSE(analysis.writes_unknown_address);
+    ASSERT_TRUE(analysis.self_modifying);
+    ASSERT_FALSE(analysis.safe_to_compile());
+}
+
+TEST(rom_analysis, bcd_into_code) {
+    // FX33 writes 3 bytes: the last two are the next instruction.
+    auto analysis = analyze_rom("bcd", {0xA2, 0x04, 0xF0, 0x33, 0x12, 0x04});
+    ASSERT_EQ(3u, analysis.writable.count());
+    ASSERT_TRUE(analysis.self_modifying);
+    ASSERT_FALSE(analysis.safe_to_compile());
+}
+
+TEST(rom_analysis, store_into_data) {
+    // Same store, away from the code.
+    auto analysis = analyze_rom("data", {0xA3, 0x00, 0xF1, 0x55, 0x12, 0x04});
+    ASSERT_TRUE(analysis.writable[0x300]);
+    ASSERT_TRUE(analysis.writable[0x301]);
+    ASSERT_FALSE(analysis.self_modifying);
+    ASSERT_TRUE(analysis.safe_to_compile());
+}
+
+TEST(rom_analysis, store_at_unknown_address) {
+    // I += V0 before the store: the address depends on a register.
+    auto analysis = analyze_rom("unknown", {0xA3, 0x00, 0xF0, 0x1E, 0xF1, 0x55, 0x12, 0x06});
+    ASSERT_TRUE(analysis.writes_unknown_address);
+    ASSERT_FALSE(analysis.safe_to_compile());
+}
+
+TEST(rom_analysis, corpus_keeps_order) {
+    std::vector<std::pair<std::string, std::vector<std::uint8_t>>> roms = {
+            {"nested", nested_loops},
+            {"store", {0xA2, 0x06, 0xF1, 0x55, 0x12, 0x06, 0x12, 0x06}},
+            {"data", {0xA3, 0x00, 0xF1, 0x55, 0x12, 0x04}},
+    };
+    auto analyses = analyze_corpus(roms, 2);
+    ASSERT_EQ(3u, analyses.size());
+    ASSERT_EQ("nested", analyses[0].name);
+    ASSERT_EQ(3u, analyses[0].loops.size());
+    ASSERT_EQ("store", analyses[1].name);
+    ASSERT_FALSE(analyses[1].safe_to_compile());
+    ASSERT_EQ("data", analyses[2].name);
+    ASSERT_TRUE(analyses[2].safe_to_compile());
+}
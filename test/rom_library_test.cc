@@ -0,0 +1,156 @@
+// ROMs from the bundled archive and from a directory, looked up by name and by hash, and damaged archives.
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "hash.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+std::vector<std::uint8_t> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// A file removed when the test ends.
+class TemporaryFile {
+public:
+    TemporaryFile() {
+        char name[] = "/tmp/rom_library_testXXXXXX";
+        auto fd = mkstemp(name);
+        if (fd < 0) throw std::runtime_error("mkstemp");
+        close(fd);
+        path_ = name;
+    }
+    ~TemporaryFile() { std::remove(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+
+    void write(const std::vector<std::uint8_t>& bytes, std::size_t size) {
+        std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), size);
+    }
+
+private:
+    std::string path_;
+};
+
+// Each damaged copy is written to the disk: test every cut or damaged byte in the last bytes, where the central
+// directory and the end of central directory record are, and a sample of the entries before.
+constexpr std::size_t directory_bytes = 1536;
+constexpr std::size_t sample_stride = 61;
+
+std::vector<std::size_t> positions(std::size_t size) {
+    std::vector<std::size_t> result;
+    auto directory = size - directory_bytes;
+    for (std::size_t i = 0; i < directory; i += sample_stride) result.push_back(i);
+    for (auto i = directory; i < size; i += 2) result.push_back(i);
+    return result;
+}
+
+const std::string archive = CHIP8_ARCHIVE;
+const std::string games = CHIP8_GAMES_DIR;
+
+}
+
+TEST(rom_library, bundled_archive) {
+    auto library = RomLibrary::open(archive);
+    // Deflated entries and one stored entry, MAZE.
+    ASSERT_EQ(23u, library.entries().size());
+    ASSERT_EQ("15PUZZLE", library.entries().front().name);
+    ASSERT_EQ("WIPEOFF", library.entries().back().name);
+
+    for (auto& entry: library.entries()) {
+        auto expected = read_file(games + "/" + entry.name);
+        ASSERT_EQ(expected, std::vector<std::uint8_t>(entry.rom.begin(), entry.rom.end())) << entry.name;
+        ASSERT_EQ(fnv1a(expected.data(), expected.size()), entry.hash) << entry.name;
+    }
+}
+
+TEST(rom_library, find_by_name_and_hash) {
+    auto library = RomLibrary::open(archive);
+    auto pong = library.find("PONG");
+    ASSERT_NE(nullptr, pong);
+    ASSERT_EQ(246u, pong->rom.size);
+    ASSERT_EQ(pong, &library.at("PONG"));
+
+    auto bytes = read_file(games + "/PONG");
+    ASSERT_EQ(pong, library.find(fnv1a(bytes.data(), bytes.size())));
+
+    ASSERT_EQ(nullptr, library.find("pong"));
+    ASSERT_EQ(nullptr, library.find(fnv1a(bytes.data(), bytes.size() - 1)));
+    ASSERT_THROW(library.at("PONG3"), RomError);
+}
+
+TEST(rom_library, directory_matches_archive) {
+    auto zipped = RomLibrary::open(archive);
+    auto directory = RomLibrary::open(games);
+    ASSERT_EQ(zipped.entries().size(), directory.entries().size());
+    for (std::size_t i = 0; i < zipped.entries().size(); i++) {
+        ASSERT_EQ(zipped.entries()[i].name, directory.entries()[i].name);
+        ASSERT_EQ(zipped.entries()[i].hash, directory.entries()[i].hash);
+    }
+}
+
+TEST(rom_library, resolve) {
+    RomLibrary library;
+    auto tank = resolve_rom(archive + ":TANK", library);
+    ASSERT_EQ(library.at("TANK").rom.data, tank.data);
+    ASSERT_EQ(560u, tank.size);
+
+    auto from_directory = resolve_rom(games + ":TANK", library);
+    ASSERT_EQ(560u, from_directory.size);
+
+    // A plain file is a single ROM.
+    auto file = resolve_rom(games + "/TANK", library);
+    ASSERT_EQ(560u, file.size);
+    ASSERT_EQ("TANK", library.entries().front().name);
+
+    ASSERT_THROW(resolve_rom(archive + ":NOPE", library), RomError);
+    ASSERT_THROW(resolve_rom(archive, library), RomError);
+    ASSERT_THROW(resolve_rom(games + "/NOPE", library), RomError);
+}
+
+TEST(rom_library, truncated_archive) {
+    auto bytes = read_file(archive);
+    TemporaryFile file;
+    // Too short to hold the signature: not a zip, a ROM of its own.
+    for (std::size_t size = 0; size < 4; size++) {
+        file.write(bytes, size);
+        ASSERT_EQ(size, RomLibrary::open(file.path()).entries().front().rom.size);
+    }
+    // Any other cut loses at least the end of central directory.
+    for (auto size: positions(bytes.size())) {
+        if (size < 4) continue;
+        file.write(bytes, size);
+        ASSERT_THROW(RomLibrary::open(file.path()), RomError) << size;
+    }
+}
+
+TEST(rom_library, corrupted_archive) {
+    auto bytes = read_file(archive);
+    TemporaryFile file;
+    // Whatever byte is damaged, the archive opens or is refused with a RomError. Never a crash or a huge allocation.
+    std::size_t refused = 0;
+    auto damaged_bytes = positions(bytes.size());
+    for (auto i: damaged_bytes) {
+        auto damaged = bytes;
+        damaged[i] ^= 0xFF;
+        file.write(damaged, damaged.size());
+        try {
+            auto library = RomLibrary::open(file.path());
+            ASSERT_FALSE(library.entries().empty());
+        } catch (const RomError&) {
+            refused++;
+        }
+    }
+    // Every byte of the entries is covered by a CRC, most of the directory is checked.
+    ASSERT_GT(refused, damaged_bytes.size() / 2);
+}
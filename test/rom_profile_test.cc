@@ -0,0 +1,54 @@
+// The profile database: the bundled games are found by the hash of their content, anything else gets the default.
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "hash.h"
+#include "rom_library.h"
+#include "rom_profile.h"
+
+using namespace snooz;
+
+TEST(rom_profile, known_game) {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    auto& blitz = library.at("BLITZ");
+    auto profile = find_profile(fnv1a(blitz.rom.data, blitz.rom.size));
+    ASSERT_NE(nullptr, profile);
+    ASSERT_EQ(std::string("BLITZ"), profile->name);
+    ASSERT_TRUE(profile->quirks.clip_sprites);
+
+    // Loading applies it.
+    Chip8 chip8;
+    chip8.load_rom(blitz.rom);
+    ASSERT_EQ(std::string("BLITZ"), chip8.profile().name);
+    ASSERT_TRUE(chip8.profile().quirks.clip_sprites);
+    ASSERT_EQ(Engine::FlatTable, chip8.profile().engine);
+
+    // Every bundled game has its own.
+    for (auto& entry: library.entries()) {
+        auto found = find_profile(fnv1a(entry.rom.data, entry.rom.size));
+        ASSERT_NE(nullptr, found) << entry.name;
+        ASSERT_EQ(entry.name, found->name);
+    }
+}
+
+TEST(rom_profile, unknown_rom) {
+    // BLITZ with one byte changed is not BLITZ anymore.
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    auto& blitz = library.at("BLITZ");
+    std::vector<std::uint8_t> rom(blitz.rom.begin(), blitz.rom.end());
+    rom.back() ^= 1;
+    ASSERT_EQ(nullptr, find_profile(fnv1a(rom.data(), rom.size())));
+
+    Chip8 chip8;
+    chip8.load_from_buffer(rom);
+    ASSERT_EQ(std::string(default_profile().name), chip8.profile().name);
+    ASSERT_FALSE(chip8.profile().quirks.clip_sprites);
+    ASSERT_EQ(default_profile().instructions_per_frame, chip8.instructions_per_frame());
+    ASSERT_EQ(Engine::Reference, chip8.profile().engine);
+
+    // And a known game loaded afterwards gets its profile back.
+    chip8.load_rom(blitz.rom);
+    ASSERT_TRUE(chip8.profile().quirks.clip_sprites);
+}
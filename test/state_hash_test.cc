@@ -0,0 +1,89 @@
+// The incremental state hash must always be the hash of the whole state.
+
+#include <cstdio>
+#include <random>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "lockstep.h"
+#include "rom_library.h"
+
+using namespace snooz;
+
+namespace {
+
+// Run with random keys, checking the hash after every instruction. Return false on the first
+// mismatch, with the instruction in message.
+bool hash_follows_state(Chip8& chip8, std::uint32_t seed, std::uint64_t instructions, std::string& message) {
+    std::minstd_rand input(seed);
+    for (std::uint64_t i = 0; i < instructions && chip8.should_continue(); i++) {
+        // An extra tick now and then, on top of the ones of emulated time.
+        if (i % 97 == 0) chip8.decrease_timers();
+        if (i % 10 == 0) {
+            if (input() % 2 == 0) {
+                chip8.set_key_pressed(input() % 16);
+            } else {
+                chip8.set_key_released(input() % 16);
+            }
+        }
+        chip8.emulateCycle();
+        if (chip8.state_hash() != chip8.state_hash_from_scratch()) {
+            char text[64];
+            std::snprintf(text, sizeof(text), "after opcode %04x at instruction %llu", chip8.opcode(),
+                          static_cast<unsigned long long>(i));
+            message = text;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST(state_hash, games) {
+    auto library = RomLibrary::open(CHIP8_GAMES_DIR);
+    ASSERT_FALSE(library.entries().empty());
+
+    for (auto& entry: library.entries()) {
+        Chip8 chip8;
+        chip8.seed(0);
+        chip8.load_rom(entry.rom);
+        ASSERT_EQ(chip8.state_hash(), chip8.state_hash_from_scratch()) << entry.name;
+
+        std::string message;
+        EXPECT_TRUE(hash_follows_state(chip8, 1, 2000, message)) << entry.name << ": " << message;
+    }
+}
+
+TEST(state_hash, random_programs_and_quirks) {
+    for (std::uint32_t seed = 0; seed < 40; seed++) {
+        auto program = random_program(seed, 256);
+        Chip8 chip8;
+        chip8.seed(seed);
+        chip8.load_rom(RomSpan{program.data(), program.size()});
+        // Every quirk on for half of the programs, to go through the other writes.
+        if (seed % 2 == 1) chip8.set_quirks(Quirks{true, true, true, true, true});
+
+        std::string message;
+        EXPECT_TRUE(hash_follows_state(chip8, seed, 1000, message)) << "random program " << seed << ": " << message;
+    }
+}
+
+TEST(state_hash, restore_and_reset) {
+    auto program = random_program(7, 256);
+    Chip8 chip8;
+    chip8.seed(7);
+    chip8.load_rom(RomSpan{program.data(), program.size()});
+    auto start = chip8.state_hash();
+    auto snapshot = chip8.snapshot();
+
+    std::string message;
+    ASSERT_TRUE(hash_follows_state(chip8, 7, 1000, message)) << message;
+    EXPECT_NE(start, chip8.state_hash());
+
+    chip8.restore(snapshot);
+    EXPECT_EQ(start, chip8.state_hash());
+    EXPECT_EQ(chip8.state_hash(), chip8.state_hash_from_scratch());
+
+    chip8.reset();
+    EXPECT_EQ(Chip8().state_hash(), chip8.state_hash());
+}
@@ -0,0 +1,191 @@
+// The terminal frontend through a minimal terminal that only knows cursor moves: what it shows after each frame, and
+// how little was sent to get there.
+
+#include <array>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "terminal.h"
+
+using namespace snooz;
+
+namespace {
+
+using Frame = std::array<std::uint8_t, 64 * 32>;
+using Screen = std::map<std::pair<std::size_t, std::size_t>, std::string>;
+
+// Apply `\x1b[<row>;<column>H` and UTF-8 characters to the screen. Anything else fails the test.
+void play(const std::string& out, Screen& screen) {
+    std::size_t row = 0, column = 0;
+    for (std::size_t i = 0; i < out.size();) {
+        if (out[i] == '\x1b') {
+            ASSERT_EQ('[', out.at(i + 1)) << i;
+            auto end = out.find('H', i);
+            ASSERT_NE(std::string::npos, end) << i;
+            ASSERT_EQ(2, std::sscanf(out.c_str() + i + 2, "%zu;%zu", &row, &column)) << i;
+            i = end + 1;
+            continue;
+        }
+        ASSERT_NE(0u, row) << "character before any cursor move";
+        auto lead = static_cast<std::uint8_t>(out[i]);
+        std::size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+        screen[{row, column++}] = out.substr(i, length);
+        i += length;
+    }
+}
+
+// What each cell should show, from the definition of the characters.
+Screen expected_screen(const Frame& frame, CellMode mode, std::size_t row, std::size_t column) {
+    auto on = [&](std::size_t x, std::size_t y) { return frame[y * 64 + x] != 0; };
+    Screen screen;
+    if (mode == CellMode::HalfBlock) {
+        const char* const blocks[] = {" ", "▀", "▄", "█"};
+        for (std::size_t y = 0; y < 16; y++) {
+            for (std::size_t x = 0; x < 64; x++) {
+                screen[{row + y, column + x}] = blocks[on(x, 2 * y) | on(x, 2 * y + 1) << 1];
+            }
+        }
+        return screen;
+    }
+    // Braille dots 1-2-3-7 down the left column, 4-5-6-8 down the right one.
+    const int dots[2][4] = {{0, 1, 2, 6}, {3, 4, 5, 7}};
+    for (std::size_t y = 0; y < 8; y++) {
+        for (std::size_t x = 0; x < 32; x++) {
+            unsigned pattern = 0;
+            for (int dx = 0; dx < 2; dx++) {
+                for (int dy = 0; dy < 4; dy++) pattern |= on(2 * x + dx, 4 * y + dy) << dots[dx][dy];
+            }
+            auto code = 0x2800 + pattern;
+            std::string character = {static_cast<char>(0xE0 | code >> 12), static_cast<char>(0x80 | (code >> 6 & 0x3F)),
+                                     static_cast<char>(0x80 | (code & 0x3F))};
+            screen[{row + y, column + x}] = pattern == 0 ? " " : character;
+        }
+    }
+    return screen;
+}
+
+std::size_t moves(const std::string& out) {
+    std::size_t count = 0;
+    for (auto c: out) count += c == '\x1b';
+    return count;
+}
+
+}
+
+TEST(terminal, unchanged_and_single_pixel) {
+    Frame frame{};
+    frame[3 * 64 + 7] = 1;
+    TerminalRenderer renderer(CellMode::HalfBlock, 2, 5);
+    std::string out;
+    renderer.render(FramebufferView::of(frame), out);
+    Screen screen;
+    play(out, screen);
+    ASSERT_EQ(expected_screen(frame, CellMode::HalfBlock, 2, 5), screen);
+    ASSERT_EQ(64u, renderer.columns());
+    ASSERT_EQ(16u, renderer.rows());
+
+    // Nothing changed: nothing sent.
+    out.clear();
+    renderer.render(FramebufferView::of(frame), out);
+    ASSERT_EQ("", out);
+
+    // The bottom half of the cell at column 10, row 2: one move, one character.
+    frame[5 * 64 + 10] = 1;
+    renderer.render(FramebufferView::of(frame), out);
+    ASSERT_EQ("\x1b[4;15H▄", out);
+
+    // The other half of an existing cell.
+    out.clear();
+    frame[2 * 64 + 7] = 1;
+    renderer.render(FramebufferView::of(frame), out);
+    ASSERT_EQ("\x1b[3;12H█", out);
+
+    // Braille: the pixel at 10,5 is the dot 5 of the cell at 5,1.
+    Frame single{};
+    TerminalRenderer braille(CellMode::Braille);
+    out.clear();
+    braille.render(FramebufferView::of(single), out);
+    out.clear();
+    single[5 * 64 + 11] = 1;
+    braille.render(FramebufferView::of(single), out);
+    ASSERT_EQ("\x1b[2;6H⠐", out);
+}
+
+TEST(terminal, gaps_and_invalidate) {
+    Frame frame{};
+    TerminalRenderer renderer;
+    std::string out;
+    renderer.render(FramebufferView::of(frame), out);
+    Screen screen;
+    play(out, screen);
+
+    // Two unchanged cells between two changes are sent again rather than skipped with a move, three are not.
+    out.clear();
+    frame[0 * 64 + 10] = 1;
+    frame[0 * 64 + 13] = 1;
+    frame[0 * 64 + 30] = 1;
+    frame[0 * 64 + 34] = 1;
+    renderer.render(FramebufferView::of(frame), out);
+    ASSERT_EQ("\x1b[1;11H▀  ▀\x1b[1;31H▀\x1b[1;35H▀", out);
+    play(out, screen);
+    ASSERT_EQ(expected_screen(frame, CellMode::HalfBlock, 1, 1), screen);
+
+    // After an invalidate, every cell again.
+    out.clear();
+    renderer.invalidate();
+    renderer.render(FramebufferView::of(frame), out);
+    Screen redrawn;
+    play(out, redrawn);
+    ASSERT_EQ(expected_screen(frame, CellMode::HalfBlock, 1, 1), redrawn);
+    ASSERT_EQ(16u, moves(out));
+}
+
+// Random changes from frame to frame: the terminal always shows the frame, and the diffs stay well under a full
+// redraw.
+TEST(terminal, diffs_equal_full_redraw) {
+    std::minstd_rand random(13);
+    for (auto mode: {CellMode::HalfBlock, CellMode::Braille}) {
+        Frame frame{};
+        TerminalRenderer renderer(mode, 3, 2);
+        Screen screen;
+        std::size_t diff_bytes = 0, full_bytes = 0;
+        for (int step = 0; step < 200; step++) {
+            auto changes = random() % 6;
+            for (unsigned i = 0; i < changes; i++) frame[random() % frame.size()] ^= 1;
+
+            std::string out;
+            renderer.render(FramebufferView::of(frame), out);
+            play(out, screen);
+            ASSERT_EQ(expected_screen(frame, mode, 3, 2), screen) << static_cast<int>(mode) << ' ' << step;
+            ASSERT_EQ(changes == 0 && step > 0, out.empty()) << step;
+
+            TerminalRenderer from_scratch(mode, 3, 2);
+            std::string full;
+            from_scratch.render(FramebufferView::of(frame), full);
+            if (step > 0) diff_bytes += out.size();
+            full_bytes += full.size();
+        }
+        ASSERT_LT(diff_bytes * 10, full_bytes) << static_cast<int>(mode);
+    }
+}
+
+TEST(terminal, intensity) {
+    // Faded pixels stay lit down to half the intensity.
+    Frame frame{};
+    frame[0] = 128;
+    frame[1] = 127;
+    FramebufferView view = FramebufferView::of(frame);
+    view.format = PixelFormat::Intensity;
+    TerminalRenderer renderer;
+    std::string out;
+    renderer.render(view, out);
+    Screen screen;
+    play(out, screen);
+    auto at = [&](std::size_t column) { return screen.at({1, column}); };
+    ASSERT_EQ("▀", at(1));
+    ASSERT_EQ(" ", at(2));
+}
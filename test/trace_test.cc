@@ -0,0 +1,95 @@
+// Trace records: the ring keeping the last ones, the file format, their text, and what the core records.
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "chip_8.h"
+#include "decoder.h"
+#include "trace.h"
+
+using namespace snooz;
+
+TEST(trace, ring_keeps_the_last_records) {
+    TraceRing<4> ring;
+    ASSERT_TRUE(ring.records().empty());
+    for (std::uint64_t cycle = 0; cycle < 6; cycle++) {
+        ring.record(cycle, static_cast<std::uint16_t>(0x200 + 2 * cycle), 0x7001, TraceEvent::Instruction, 0);
+    }
+    auto records = ring.records();
+    ASSERT_EQ(4u, records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+        ASSERT_EQ(i + 2, records[i].cycle);
+        ASSERT_EQ(0x204 + 2 * i, records[i].pc);
+    }
+    ring.clear();
+    ASSERT_TRUE(ring.records().empty());
+}
+
+TEST(trace, file_round_trip) {
+    std::vector<TraceRecord> records = {
+            {1, 0x200, 0x6005, TraceEvent::Instruction, 0, {0, 0}},
+            {2, 0x202, 0xE09E, TraceEvent::KeyCheck, 5, {0, 0}},
+            {3, 0x204, 0x0000, TraceEvent::KeyPressed, 15, {0, 0}},
+    };
+    std::stringstream file;
+    write_trace(file, records);
+    ASSERT_EQ(3 * sizeof(TraceRecord), file.str().size());
+
+    auto read = read_trace(file);
+    ASSERT_EQ(records.size(), read.size());
+    for (std::size_t i = 0; i < read.size(); i++) {
+        ASSERT_EQ(records[i].cycle, read[i].cycle);
+        ASSERT_EQ(records[i].pc, read[i].pc);
+        ASSERT_EQ(records[i].opcode, read[i].opcode);
+        ASSERT_EQ(records[i].event, read[i].event);
+        ASSERT_EQ(records[i].arg, read[i].arg);
+    }
+}
+
+TEST(trace, text) {
+    std::vector<TraceRecord> records = {
+            {1, 0x200, 0x6005, TraceEvent::Instruction, 0, {0, 0}},
+            {2, 0x202, 0x0123, TraceEvent::UnknownOpcode, 0, {0, 0}},
+            {3, 0x204, 0x0000, TraceEvent::KeyPressed, 10, {0, 0}},
+            {4, 0x204, 0x0000, TraceEvent::KeyReleased, 10, {0, 0}},
+            {5, 0x206, 0xE19E, TraceEvent::KeyCheck, 10, {0, 0}},
+            {16, 0x208, 0x2208, TraceEvent::StackOverflow, 0, {0, 0}},
+            {17, 0x20A, 0x00EE, TraceEvent::StackUnderflow, 0, {0, 0}},
+    };
+    Decoder decoder;
+    std::ostringstream text;
+    print_trace(text, records, decoder);
+    // Cycles in decimal, the rest in hex: addresses, opcodes, and keys as on the keypad.
+    ASSERT_EQ("         1 " + decoder.interpret(0x6005, 0x200) + "\n"
+              "         2 202\tUnknown opcode 123\n"
+              "         3 204\tKey pressed a\n"
+              "         4 204\tKey released a\n"
+              "         5 206\tCheck key a (" + decoder.interpret(0xE19E, 0x206) + ")\n"
+              "        16 208\tStack overflow, halted\n"
+              "        17 20a\tStack underflow, halted\n",
+              text.str());
+}
+
+#if CHIP8_TRACE_LEVEL >= CHIP8_TRACE_ALL
+TEST(trace, core_records) {
+    // V0 = 5, skip if key V0 pressed, then an unknown opcode.
+    Chip8 chip8;
+    chip8.load_from_buffer({0x60, 0x05, 0xE0, 0x9E, 0x01, 0x23, 0x12, 0x06});
+    chip8.set_key_pressed(5);
+    for (int i = 0; i < 3; i++) chip8.emulateCycle();
+
+    std::vector<TraceEvent> events;
+    for (auto& record: chip8.trace().records()) events.push_back(record.event);
+    ASSERT_EQ((std::vector<TraceEvent>{TraceEvent::KeyPressed, TraceEvent::Instruction, TraceEvent::Instruction,
+                                       TraceEvent::KeyCheck, TraceEvent::Instruction}),
+              events);
+    auto records = chip8.trace().records();
+    ASSERT_EQ(5, records[0].arg);
+    ASSERT_EQ(0x200, records[1].pc);
+    ASSERT_EQ(0x6005, records[1].opcode);
+    ASSERT_EQ(5, records[3].arg);
+    // The key was pressed: the unknown opcode was skipped.
+    ASSERT_EQ(0x206, records[4].pc);
+}
+#endif
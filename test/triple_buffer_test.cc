@@ -0,0 +1,170 @@
+// The lock-free handoffs between threads: the triple buffer of frames and the SPSC queue of keys and samples,
+// alone and then hammered from two threads.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+using namespace snooz;
+
+namespace {
+
+// Every word holds a value derived from the sequence: a frame mixing two writes cannot pass check().
+struct Payload {
+    std::uint64_t sequence;
+    std::array<std::uint64_t, 255> words;
+
+    void fill(std::uint64_t value) {
+        sequence = value;
+        for (std::size_t i = 0; i < words.size(); i++) words[i] = value * 31 + i;
+    }
+
+    bool check() const {
+        for (std::size_t i = 0; i < words.size(); i++) {
+            if (words[i] != sequence * 31 + i) return false;
+        }
+        return true;
+    }
+};
+
+}
+
+TEST(triple_buffer, latest_wins) {
+    TripleBuffer<int> buffer;
+    ASSERT_FALSE(buffer.update());
+    ASSERT_EQ(0, buffer.read_buffer());
+
+    buffer.write_buffer() = 1;
+    buffer.publish();
+    ASSERT_TRUE(buffer.update());
+    ASSERT_EQ(1, buffer.read_buffer());
+    // Nothing new: the last frame stays.
+    ASSERT_FALSE(buffer.update());
+    ASSERT_EQ(1, buffer.read_buffer());
+
+    // Published twice before a read: only the second one is seen.
+    buffer.write_buffer() = 2;
+    buffer.publish();
+    buffer.write_buffer() = 3;
+    buffer.publish();
+    ASSERT_TRUE(buffer.update());
+    ASSERT_EQ(3, buffer.read_buffer());
+    ASSERT_FALSE(buffer.update());
+
+    // The producer never gets the buffer the consumer reads.
+    buffer.write_buffer() = 4;
+    ASSERT_EQ(3, buffer.read_buffer());
+}
+
+// The producer publishes as fast as it can while the consumer reads: every frame read is whole, and the sequence
+// only goes up.
+TEST(triple_buffer, two_threads) {
+    constexpr std::uint64_t frames = 200000;
+    TripleBuffer<Payload> buffer;
+    buffer.write_buffer().fill(0);
+    buffer.publish();
+
+    std::thread producer([&] {
+        for (std::uint64_t sequence = 1; sequence <= frames; sequence++) {
+            buffer.write_buffer().fill(sequence);
+            buffer.publish();
+        }
+    });
+
+    std::uint64_t last = 0, updates = 0, torn = 0, backwards = 0;
+    while (last < frames) {
+        if (!buffer.update()) {
+            // Still the same frame.
+            if (buffer.read_buffer().sequence != last) backwards++;
+            std::this_thread::yield();
+            continue;
+        }
+        auto& frame = buffer.read_buffer();
+        if (!frame.check()) torn++;
+        if (frame.sequence <= last && updates > 0) backwards++;
+        last = frame.sequence;
+        updates++;
+    }
+    producer.join();
+
+    ASSERT_EQ(0u, torn);
+    ASSERT_EQ(0u, backwards);
+    ASSERT_EQ(frames, last);
+    ASSERT_GT(updates, 1u);
+}
+
+TEST(spsc_queue, full_and_empty) {
+    SpscQueue<int, 4> queue;
+    int value;
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.pop(value));
+    for (int i = 0; i < 4; i++) ASSERT_TRUE(queue.push(i));
+    ASSERT_FALSE(queue.push(4));
+    ASSERT_EQ(4u, queue.size());
+
+    ASSERT_TRUE(queue.pop(value));
+    ASSERT_EQ(0, value);
+    // Only as much as there is room for.
+    const int more[] = {10, 11, 12};
+    ASSERT_EQ(1u, queue.push(more, 3));
+
+    int out[8];
+    ASSERT_EQ(4u, queue.pop(out, 8));
+    ASSERT_EQ(1, out[0]);
+    ASSERT_EQ(3, out[2]);
+    ASSERT_EQ(10, out[3]);
+    ASSERT_TRUE(queue.empty());
+}
+
+// Single and batched pushes and pops from two threads, through a small queue that is often full: everything
+// arrives once, in order.
+TEST(spsc_queue, two_threads) {
+    constexpr std::uint32_t count = 1000000;
+    SpscQueue<std::uint32_t, 64> queue;
+
+    std::thread producer([&] {
+        std::uint32_t next = 0;
+        std::uint32_t batch[13];
+        while (next < count) {
+            std::size_t pushed;
+            if (next % 3 == 0) {
+                pushed = queue.push(next) ? 1 : 0;
+            } else {
+                std::size_t size = 0;
+                for (; size < 13 && next + size < count; size++) batch[size] = next + static_cast<std::uint32_t>(size);
+                pushed = queue.push(batch, size);
+            }
+            next += static_cast<std::uint32_t>(pushed);
+            // Full: let the consumer run, on a single core too.
+            if (pushed == 0) std::this_thread::yield();
+        }
+    });
+
+    std::uint32_t expected = 0, out_of_order = 0;
+    std::uint32_t batch[7];
+    while (expected < count) {
+        std::uint32_t value;
+        std::size_t popped;
+        if (expected % 2 == 0) {
+            popped = queue.pop(value) ? 1 : 0;
+            if (popped == 1 && value != expected) out_of_order++;
+            expected += static_cast<std::uint32_t>(popped);
+        } else {
+            popped = queue.pop(batch, 7);
+            for (std::size_t i = 0; i < popped; i++) {
+                if (batch[i] != expected) out_of_order++;
+                expected++;
+            }
+        }
+        if (popped == 0) std::this_thread::yield();
+    }
+    producer.join();
+
+    ASSERT_EQ(0u, out_of_order);
+    ASSERT_TRUE(queue.empty());
+}
@@ -0,0 +1,315 @@
+// Exported videos read back: the container headers, one picture per frame, and the GIF LZW streams decoded.
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "video_export.h"
+
+using namespace snooz;
+
+namespace {
+
+using Bytes = std::vector<std::uint8_t>;
+using Frame = std::array<std::uint8_t, 64 * 32>;
+
+Bytes read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// A file removed when the test ends.
+class TemporaryFile {
+public:
+    explicit TemporaryFile(const std::string& extension) {
+        char name[] = "/tmp/video_export_testXXXXXX";
+        auto fd = mkstemp(name);
+        if (fd < 0) throw std::runtime_error("mkstemp");
+        close(fd);
+        std::remove(name);
+        path_ = name + extension;
+    }
+    ~TemporaryFile() { std::remove(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Blank, one pixel, then noise over the whole screen so that the LZW table fills up and is cleared.
+std::vector<Frame> test_frames() {
+    Frame blank{};
+    Frame pixel{};
+    pixel[5 * 64 + 10] = 1;
+    Frame flicker = pixel;
+    flicker[20 * 64 + 40] = 1;
+    Frame noise;
+    std::minstd_rand random(7);
+    for (auto& value: noise) value = random() % 2;
+
+    // The flicker frame only lasts one tick: it is not written on its own.
+    return {blank, blank, blank, pixel, pixel, pixel, flicker, noise, noise, noise, noise};
+}
+
+void export_frames(const std::string& path, const std::vector<Frame>& frames, const VideoOptions& options) {
+    VideoExporter video(path, 64, 32, options);
+    for (auto& frame: frames) video.push(FramebufferView::of(frame));
+    EXPECT_EQ(frames.size(), video.frames());
+    video.finish();
+}
+
+std::size_t read_le16(const Bytes& data, std::size_t& pos) {
+    auto value = data.at(pos) | (data.at(pos + 1) << 8);
+    pos += 2;
+    return value;
+}
+
+// Sub-blocks up to the empty one.
+Bytes read_blocks(const Bytes& data, std::size_t& pos) {
+    Bytes result;
+    while (auto size = data.at(pos++)) {
+        result.insert(result.end(), data.begin() + pos, data.begin() + pos + size);
+        pos += size;
+    }
+    return result;
+}
+
+// Straight from the GIF89a specification, appendix F. Throw on an invalid code.
+Bytes lzw_decode(const Bytes& stream, int min_code_size) {
+    const int clear_code = 1 << min_code_size;
+    const int end_code = clear_code + 1;
+    std::vector<int> prefix(4096, -1);
+    std::vector<std::uint8_t> suffix(4096);
+    for (int i = 0; i < clear_code; i++) suffix[i] = static_cast<std::uint8_t>(i);
+
+    auto string_of = [&](int code) {
+        Bytes result;
+        for (; code >= 0; code = prefix[code]) result.push_back(suffix[code]);
+        return Bytes(result.rbegin(), result.rend());
+    };
+
+    Bytes out;
+    int code_size = min_code_size + 1;
+    int next = end_code + 1;
+    int previous = -1;
+    std::size_t bit = 0;
+    while (bit + code_size <= stream.size() * 8) {
+        int code = 0;
+        for (int i = 0; i < code_size; i++, bit++) code |= ((stream[bit / 8] >> (bit % 8)) & 1) << i;
+
+        if (code == clear_code) {
+            code_size = min_code_size + 1;
+            next = end_code + 1;
+            previous = -1;
+            continue;
+        }
+        if (code == end_code) return out;
+
+        Bytes string;
+        if (previous < 0) {
+            if (code >= clear_code) throw std::runtime_error("first code not a byte");
+            string = string_of(code);
+        } else {
+            if (code < next) {
+                string = string_of(code);
+            } else if (code == next) {
+                string = string_of(previous);
+                string.push_back(string.front());
+            } else {
+                throw std::runtime_error("code not in the table yet");
+            }
+            if (next < 4096) {
+                prefix[next] = previous;
+                suffix[next] = string.front();
+                next++;
+                if (next == (1 << code_size) && code_size < 12) code_size++;
+            }
+        }
+        out.insert(out.end(), string.begin(), string.end());
+        previous = code;
+    }
+    throw std::runtime_error("no end code");
+}
+
+struct GifImage {
+    std::size_t delay;
+    std::size_t left;
+    std::size_t top;
+    std::size_t width;
+    std::size_t height;
+    Bytes indices;
+};
+
+std::vector<GifImage> read_gif(const Bytes& data, std::size_t width, std::size_t height) {
+    EXPECT_EQ("GIF89a", std::string(data.begin(), data.begin() + 6));
+    std::size_t pos = 6;
+    EXPECT_EQ(width, read_le16(data, pos));
+    EXPECT_EQ(height, read_le16(data, pos));
+    // Global table of 256 colors.
+    EXPECT_EQ(0xF7, data.at(pos));
+    pos += 3 + 256 * 3;
+
+    std::vector<GifImage> images;
+    std::size_t delay = 0;
+    while (true) {
+        auto introducer = data.at(pos++);
+        if (introducer == 0x3B) {
+            EXPECT_EQ(data.size(), pos);
+            return images;
+        }
+        if (introducer == 0x21) {
+            auto label = data.at(pos++);
+            if (label == 0xF9) {
+                EXPECT_EQ(4, data.at(pos));
+                pos += 2;
+                delay = read_le16(data, pos);
+                pos++;
+                EXPECT_EQ(0, data.at(pos++));
+            } else {
+                read_blocks(data, pos);
+            }
+            continue;
+        }
+        if (introducer != 0x2C) throw std::runtime_error("unexpected block");
+
+        GifImage image;
+        image.delay = delay;
+        image.left = read_le16(data, pos);
+        image.top = read_le16(data, pos);
+        image.width = read_le16(data, pos);
+        image.height = read_le16(data, pos);
+        // No local color table, not interlaced.
+        EXPECT_EQ(0, data.at(pos++));
+        auto min_code_size = data.at(pos++);
+        image.indices = lzw_decode(read_blocks(data, pos), min_code_size);
+        EXPECT_EQ(image.width * image.height, image.indices.size());
+        images.push_back(image);
+    }
+}
+
+// Color indices of a frame, as in PixelFormat::Planes, scaled up.
+Bytes scaled(const Frame& frame, std::size_t scale) {
+    Bytes result(64 * scale * 32 * scale);
+    for (std::size_t y = 0; y < 32 * scale; y++) {
+        for (std::size_t x = 0; x < 64 * scale; x++) result[y * 64 * scale + x] = frame[(y / scale) * 64 + x / scale];
+    }
+    return result;
+}
+
+}
+
+TEST(video_export, gif) {
+    TemporaryFile file(".gif");
+    auto frames = test_frames();
+    VideoOptions options;
+    options.format = VideoFormat::Gif;
+    options.scale = 4;
+    export_frames(file.path(), frames, options);
+
+    auto images = read_gif(read_file(file.path()), 256, 128);
+    ASSERT_EQ(3u, images.size());
+
+    // Each image is the rectangle that changed: drawn over the previous ones, the screen shows the frame.
+    Bytes canvas(256 * 128);
+    std::vector<Frame> expected = {frames[0], frames[3], frames[7]};
+    for (std::size_t i = 0; i < images.size(); i++) {
+        auto& image = images[i];
+        ASSERT_LE(image.left + image.width, 256u);
+        ASSERT_LE(image.top + image.height, 128u);
+        for (std::size_t y = 0; y < image.height; y++) {
+            std::copy(image.indices.begin() + y * image.width, image.indices.begin() + (y + 1) * image.width,
+                      canvas.begin() + (image.top + y) * 256 + image.left);
+        }
+        ASSERT_EQ(scaled(expected[i], 4), canvas) << i;
+    }
+    // Only the pixel that appeared, scaled.
+    ASSERT_EQ(40u, images[1].left);
+    ASSERT_EQ(20u, images[1].top);
+    ASSERT_EQ(4u, images[1].width);
+    ASSERT_EQ(4u, images[1].height);
+
+    // 11 frames at 60Hz in hundredths, the flicker frame counted with the noise.
+    ASSERT_EQ(5u, images[0].delay);
+    ASSERT_EQ(5u, images[1].delay);
+    ASSERT_EQ(8u, images[2].delay);
+}
+
+TEST(video_export, y4m) {
+    TemporaryFile file(".y4m");
+    auto frames = test_frames();
+    VideoOptions options;
+    options.scale = 2;
+    export_frames(file.path(), frames, options);
+
+    auto data = read_file(file.path());
+    const std::string header = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 C420jpeg\n";
+    ASSERT_EQ(header, std::string(data.begin(), data.begin() + header.size()));
+
+    // One picture per frame, whether it changed or not.
+    const std::size_t picture = 128 * 64 * 3 / 2;
+    ASSERT_EQ(header.size() + frames.size() * (6 + picture), data.size());
+    std::vector<Bytes> pictures;
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        auto start = data.begin() + header.size() + i * (6 + picture);
+        ASSERT_EQ("FRAME\n", std::string(start, start + 6)) << i;
+        pictures.emplace_back(start + 6, start + 6 + picture);
+    }
+    ASSERT_EQ(pictures[0], pictures[2]);
+    ASSERT_NE(pictures[2], pictures[3]);
+
+    // The luma of the lit pixel, 2x2 after scaling, is the only one that changed.
+    auto& blank = pictures[0];
+    auto& pixel = pictures[3];
+    for (std::size_t y = 0; y < 64; y++) {
+        for (std::size_t x = 0; x < 128; x++) {
+            auto lit = x / 2 == 10 && y / 2 == 5;
+            ASSERT_EQ(lit, blank[y * 128 + x] != pixel[y * 128 + x]) << x << ',' << y;
+        }
+    }
+}
+
+TEST(video_export, raw) {
+    TemporaryFile file(".rgba");
+    auto frames = test_frames();
+    VideoOptions options;
+    options.format = VideoFormat::Raw;
+    options.scale = 1;
+    export_frames(file.path(), frames, options);
+    ASSERT_EQ(frames.size() * 64 * 32 * 4, read_file(file.path()).size());
+}
+
+TEST(video_export, frame_size_mismatch) {
+    TemporaryFile file(".rgba");
+    VideoOptions options;
+    options.format = VideoFormat::Raw;
+    options.scale = 1;
+    VideoExporter video(file.path(), 64, 32, options);
+    std::array<std::uint8_t, 128 * 64> large{};
+    ASSERT_THROW(video.push(FramebufferView{large.data(), 128, 64, 128}), std::invalid_argument);
+    Frame frame{};
+    video.push(FramebufferView::of(frame));
+    ASSERT_EQ(1u, video.frames());
+    video.finish();
+    ASSERT_EQ(64u * 32 * 4, read_file(file.path()).size());
+}
+
+TEST(video_export, write_error) {
+    VideoOptions options;
+    options.format = VideoFormat::Raw;
+    ASSERT_THROW(VideoExporter("/nonexistent/video.rgba", 64, 32, options), std::runtime_error);
+
+    // Opens fine, but nothing can be written.
+    VideoExporter video("/dev/full", 64, 32, options);
+    Frame frame{};
+    for (int i = 0; i < 20; i++) video.push(FramebufferView::of(frame));
+    ASSERT_THROW(video.finish(), std::runtime_error);
+    // Reported once.
+    video.finish();
+}